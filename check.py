@@ -0,0 +1,208 @@
+#!/usr/bin/python
+
+# Regression check: runs every program in inputs/ under several cache and
+# core configurations and compares the final architectural state (PC,
+# registers, HI/LO and a checksum of the data segment) with the reference
+# stored next to the program in <name>.ref. Timing differs between the
+# configurations, the architectural state must not.
+#
+#   check.py [--update] [inputs...]
+#
+# --update rewrites the references from the default configuration.
+#
+# Also checks that a configuration survives a round trip through an INI and
+# a JSON config file: the values "sim --help" reports after a set of
+# command-line options, written back as a config file, must load unchanged.
+# And that address traces survive their codecs: replaying a captured trace
+# through cachesim (streamed) must give the misses and writebacks the
+# simulator counted while capturing it, and through sweep (mapped) the same
+# last-level misses and writebacks.
+
+import sys, os, subprocess, re, glob, argparse, zlib, json, tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+sim = "./sim"
+
+bold="\033[1m"
+green="\033[0;32m"
+red="\033[0;31m"
+normal="\033[0m"
+
+# data segment compared through its checksum
+MEM_LOW = 0x10000000
+MEM_HIGH = 0x1000fffc
+
+# name, command-line options, shell commands before "go"
+CONFIGS = [
+    ("default", [], ""),
+    ("hierarchy", ["--l2.size=8K", "--l2.latency=4", "--l2.block_size=32",
+        "--l2.inclusion=exclusive", "--llc.size=64K"], ""),
+    ("write-through", ["--dcache.size=256", "--dcache.assoc=1", "--dcache.write_policy=through",
+        "--dcache.write_allocate=0", "--dcache.write_buffer=2", "--l2.write_policy=through",
+        "--l2.write_buffer=4"], ""),
+    ("mshr", ["--icache.mshrs=2", "--dcache.mshrs=4", "--dcache.size=1K"], ""),
+    ("prefetch-stride", ["--dcache.prefetcher=stride", "--dcache.prefetch_degree=2",
+        "--dcache.mshrs=4"], ""),
+    ("prefetch-stream", ["--dcache.prefetcher=stream", "--dcache.size=1K"], ""),
+    ("replacement", ["--icache.replacement=plru", "--dcache.size=1K",
+        "--dcache.replacement=drrip", "--l2.size=8K", "--l2.replacement=ship"], ""),
+    ("victim", ["--icache.victim=2", "--dcache.size=1K", "--dcache.assoc=1",
+        "--dcache.victim=4"], ""),
+    ("tag-only", ["--memory.tag_only=1"], ""),
+    ("geometry", ["--dcache.size=1536", "--dcache.assoc=3", "--dcache.block_size=16",
+        "--l2.block_size=128"], ""),
+    ("bpred", ["--bpred.type=tournament"], ""),
+    ("ff-warm", ["--bpred.type=gshare", "--dcache.size=1K"], "run 50\nff 1000\n"),
+    ("ff-cold", ["--core.ff_warm=0"], "ff 100000000\n"),
+]
+
+# options for the config file round trip, set away from their defaults
+ROUNDTRIP = ["--icache.size=4K", "--icache.victim=2", "--dcache.replacement=ship",
+    "--dcache.insertion=dip", "--dcache.indexing=hash", "--dcache.write_policy=through",
+    "--dcache.write_allocate=0", "--dcache.prefetcher=stream", "--l2.inclusion=exclusive",
+    "--l2.block_size=32", "--llc.size=1M", "--memory.tag_only=1", "--core.ff_warm=0",
+    "--bpred.type=tournament", "--bpred.history=12"]
+
+# programs and hierarchy for the address trace round trip: small caches with
+# LRU replacement, so that every level misses and the replay is deterministic
+TRACE_INPUTS = ["inputs/long/primes.x", "inputs/long/repmovs.x",
+    "inputs/memory_benchmarks/random_access.x", "inputs/inst/sb.x", "inputs/inst/sh.x"]
+TRACE_OPTIONS = ["--icache.replacement=lru", "--dcache.replacement=lru", "--l2.replacement=lru",
+    "--icache.size=1K", "--dcache.size=1K", "--l2.size=8K"]
+CODECS = ["none", "zstd", "lz4"]
+
+
+def main():
+    all_inputs = sorted(glob.glob("inputs/*/*.x"))
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--update", action="store_true")
+    parser.add_argument("inputs", nargs="*", default=all_inputs)
+    parser = parser.parse_args()
+
+    if parser.update:
+        with ThreadPoolExecutor() as pool:
+            states = pool.map(lambda i: state(i, CONFIGS[0]), parser.inputs)
+        for i, s in zip(parser.inputs, states):
+            open(ref_file(i), "w").write(s)
+        print("Wrote %d references" % len(parser.inputs))
+        return
+
+    jobs = [(i, c) for i in parser.inputs for c in CONFIGS]
+    with ThreadPoolExecutor() as pool:
+        states = list(pool.map(lambda j: state(*j), jobs))
+
+    failed = config_roundtrip()
+    with ThreadPoolExecutor() as pool:
+        failed += sum(pool.map(lambda j: trace_roundtrip(*j), [(i, c) for i in TRACE_INPUTS for c in CODECS]))
+    for (i, c), s in zip(jobs, states):
+        if not os.path.exists(ref_file(i)):
+            print(red + "ERROR -- no reference for " + i + normal)
+            failed += 1
+            continue
+        ref = open(ref_file(i)).read()
+        if s != ref:
+            print(bold + "FAILED: " + normal + i + " (" + c[0] + ")")
+            for r, o in zip(ref.split("\n"), s.split("\n")):
+                if r != o:
+                    print("  expected " + r.ljust(24) + "got " + o)
+            failed += 1
+
+    if failed:
+        print(red + "%d of %d runs FAILED" % (failed, len(jobs)) + normal)
+        sys.exit(1)
+    print(green + "ALL %d RUNS OK" % len(jobs) + normal + " (%d inputs, %d configurations)" %
+            (len(parser.inputs), len(CONFIGS)))
+
+
+def options(args):
+    """The option values "sim --help" reports after args, as (section, key, value)."""
+    out = subprocess.run([sim] + args + ["--help"], stdout=subprocess.PIPE).stdout.decode("utf-8")
+    return re.findall(r"^  --(\w+)\.(\w+)=\S+ \((\S+)\)$", out, re.M)
+
+
+def config_roundtrip():
+    expected = options(ROUNDTRIP)
+    sections = {}
+    for section, key, value in expected:
+        sections.setdefault(section, []).append((key, value))
+
+    ini = "".join("[%s]\n%s\n" % (s, "".join("%s = %s\n" % kv for kv in kvs)) for s, kvs in sections.items())
+    js = json.dumps({s: dict(kvs) for s, kvs in sections.items()}, indent=2)
+
+    failed = 0
+    for suffix, text in ((".ini", ini), (".json", js)):
+        with tempfile.NamedTemporaryFile("w", suffix=suffix) as f:
+            f.write(text)
+            f.flush()
+            got = options(["-c", f.name])
+        if not expected or got != expected:
+            print(bold + "FAILED: " + normal + "config round trip through " + suffix)
+            for e, g in zip(expected, got):
+                if e != g:
+                    print("  expected %s.%s=%s" % e + "  got %s.%s=%s" % g)
+            failed += 1
+    return failed
+
+
+def level_counts(out):
+    """(level, misses, writebacks) from the cache statistics in the output."""
+    return re.findall(r"^(\S.*) Statistics:\n(?:  .*\n)*?  Misses: (\d+)\n  Writebacks: (\d+)", out, re.M)
+
+
+def trace_roundtrip(i, codec):
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, "trace.atr")
+        env = dict(os.environ, SIM_ADDR_TRACE=path, SIM_ADDR_TRACE_CODEC=codec)
+        run = subprocess.run([sim] + TRACE_OPTIONS + [i], input=b"go\nrdump\nquit\n", env=env,
+                stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        if b"is not available" in run.stderr:
+            return 0
+        expected = level_counts(run.stdout.decode("utf-8"))
+
+        out = subprocess.run(["./cachesim"] + TRACE_OPTIONS + [path], stdout=subprocess.PIPE,
+                stderr=subprocess.DEVNULL).stdout.decode("utf-8")
+        replayed = level_counts(out)
+
+        with open(os.path.join(tmp, "points"), "w") as f:
+            f.write("-\n")
+        out = subprocess.run(["./sweep", "-j1"] + TRACE_OPTIONS + [path, f.name], stdout=subprocess.PIPE,
+                stderr=subprocess.DEVNULL).stdout.decode("utf-8").split("\n")
+        swept = tuple(out[1].split()[5:7]) if len(out) > 1 else None
+
+    # sweep reports the reads and writes that reach memory from the last level
+    if expected and replayed == expected and swept == expected[-1][1:]:
+        return 0
+    print(bold + "FAILED: " + normal + "address trace round trip of " + i + " through " + codec)
+    print("  simulator %s\n  cachesim  %s\n  sweep     %s" % (expected, replayed, swept))
+    return 1
+
+
+def ref_file(i):
+    return os.path.splitext(i)[0] + ".ref"
+
+
+def state(i, config):
+    name, options, pre = config
+
+    cmds = ""
+    cmdfile = os.path.splitext(i)[0] + ".cmd"
+    if os.path.exists(cmdfile):
+        cmds += open(cmdfile).read()
+
+    cmds += "\n" + pre + "go\nrdump\nmdump 0x%08x 0x%08x\nquit\n" % (MEM_LOW, MEM_HIGH)
+    try:
+        out = subprocess.run([sim] + options + [i], input=cmds.encode("utf-8"), stdout=subprocess.PIPE,
+                stderr=subprocess.DEVNULL, timeout=300).stdout.decode("utf-8")
+    except subprocess.TimeoutExpired:
+        return "timed out\n"
+
+    regs = re.compile(r"^(PC|R\d+|HI|LO):")
+    mem = re.compile(r"^  0x")
+    lines = out.split("\n")
+    memory = "\n".join(l for l in lines if mem.match(l))
+    return "\n".join(l for l in lines if regs.match(l)) + "\nMemory: %08x\n" % zlib.crc32(memory.encode())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,660 @@
+#include "addrtrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef SIM_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SIM_LZ4
+#include <lz4.h>
+#endif
+
+#define ADDR_TRACE_BUFFERS 4        /* chunk buffers the simulator fills in turn */
+#define ADDR_TRACE_ZSTD_LEVEL 3
+
+static const char *const addr_codec_names[] = { "none", "zstd", "lz4" };
+
+/*==============================================================================
+ * Chunk Encoding
+ *============================================================================*/
+
+static uint32_t addr_zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t addr_unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static uint8_t *addr_put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+/**
+ * @brief Reads a varint from [*p, end).
+ * @return 0 on success, -1 if it runs past the end or past 32 bits.
+ */
+static int addr_get_varint(const uint8_t **p, const uint8_t *end, uint32_t *v)
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*p == end)
+            return -1;
+        uint8_t b = *(*p)++;
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Encodes 'n' references into 'out' (room for n *
+ * ADDR_RECORD_MAX_BYTES bytes).
+ * @return bytes written.
+ */
+static uint32_t addr_encode(const Addr_Record *recs, uint32_t n, uint8_t *out)
+{
+    uint8_t *p = out;
+    uint32_t last_fetch = 0, last_data = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        const Addr_Record *r = &recs[i];
+        uint8_t tag = r->type | (r->size == 1 ? 0 : r->size == 2 ? 1 : 2) << 2;
+        if (r->type == ADDR_IFETCH) {
+            if (r->addr == last_fetch + 4) {
+                *p++ = tag | ADDR_TAG_SEQUENTIAL;
+            } else {
+                *p++ = tag;
+                p = addr_put_varint(p, addr_zigzag((int32_t)(r->addr - (last_fetch + 4))));
+            }
+            last_fetch = r->addr;
+        } else {
+            *p++ = tag;
+            p = addr_put_varint(p, addr_zigzag((int32_t)(r->addr - last_data)));
+            p = addr_put_varint(p, addr_zigzag((int32_t)(r->pc - last_fetch)));
+            last_data = r->addr;
+        }
+    }
+    return (uint32_t)(p - out);
+}
+
+/**
+ * @brief Decodes a chunk of 'n' references.
+ * @return 0 on success, -1 if the payload is malformed.
+ */
+static int addr_decode(const uint8_t *in, uint32_t size, uint32_t n, Addr_Record *recs)
+{
+    const uint8_t *p = in, *end = in + size;
+    uint32_t last_fetch = 0, last_data = 0, delta, pc_delta;
+
+    for (uint32_t i = 0; i < n; i++) {
+        Addr_Record *r = &recs[i];
+        if (p == end)
+            return -1;
+        uint8_t tag = *p++;
+        r->type = tag & 3;
+        r->size = 1 << ((tag >> 2) & 3);
+        r->pad = 0;
+        if (r->type == ADDR_IFETCH) {
+            r->addr = last_fetch + 4;
+            if (!(tag & ADDR_TAG_SEQUENTIAL)) {
+                if (addr_get_varint(&p, end, &delta))
+                    return -1;
+                r->addr += (uint32_t)addr_unzigzag(delta);
+            }
+            r->pc = last_fetch = r->addr;
+        } else if (r->type == ADDR_LOAD || r->type == ADDR_STORE) {
+            if (addr_get_varint(&p, end, &delta) || addr_get_varint(&p, end, &pc_delta))
+                return -1;
+            r->addr = last_data = last_data + (uint32_t)addr_unzigzag(delta);
+            r->pc = last_fetch + (uint32_t)addr_unzigzag(pc_delta);
+        } else {
+            return -1;
+        }
+    }
+    return p == end ? 0 : -1;
+}
+
+/*==============================================================================
+ * Address Trace Capture
+ *
+ * The simulator thread fills one chunk buffer at a time and hands each full
+ * one to the writer thread, then moves on to the next buffer in turn. It
+ * only blocks when that buffer has not been written out yet. The buffer
+ * counters are only touched under the lock, once per chunk.
+ *============================================================================*/
+
+int addr_trace_on = 0;
+
+static FILE *addr_trace_file;
+static AddrCodec addr_trace_codec;
+static Addr_Record *addr_trace_bufs[ADDR_TRACE_BUFFERS];
+static uint32_t addr_trace_records[ADDR_TRACE_BUFFERS]; /* references in each handed-over buffer */
+static Addr_Record *addr_trace_cur;     /* buffer being filled */
+static uint32_t addr_trace_fill;
+static uint64_t addr_trace_count;
+static uint64_t addr_trace_submitted, addr_trace_written; /* buffers */
+static int addr_trace_stop;
+static uint8_t *addr_trace_encoded, *addr_trace_packed; /* writer scratch */
+static size_t addr_trace_packed_size;
+
+static pthread_t addr_trace_thread;
+static pthread_mutex_t addr_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t addr_trace_data = PTHREAD_COND_INITIALIZER;  /* buffer handed over */
+static pthread_cond_t addr_trace_space = PTHREAD_COND_INITIALIZER; /* buffer written out */
+
+/**
+ * @brief Compresses 'size' encoded bytes into addr_trace_packed.
+ * @return the compressed size, or 0 if the chunk is to be stored as is.
+ */
+static size_t addr_trace_compress(const uint8_t *src, size_t size)
+{
+    size_t packed = 0;
+
+    switch (addr_trace_codec) {
+#ifdef SIM_ZSTD
+        case ADDR_CODEC_ZSTD:
+            packed = ZSTD_compress(addr_trace_packed, addr_trace_packed_size, src, size, ADDR_TRACE_ZSTD_LEVEL);
+            if (ZSTD_isError(packed))
+                packed = 0;
+            break;
+#endif
+#ifdef SIM_LZ4
+        case ADDR_CODEC_LZ4:
+            packed = LZ4_compress_default((const char *)src, (char *)addr_trace_packed,
+                    (int)size, (int)addr_trace_packed_size);
+            break;
+#endif
+        default:
+            (void)src;
+            break;
+    }
+    return packed < size ? packed : 0;
+}
+
+/**
+ * @brief Encodes, compresses and writes one chunk (writer thread).
+ */
+static void addr_trace_write_chunk(const Addr_Record *recs, uint32_t n)
+{
+    uint32_t raw_size = addr_encode(recs, n, addr_trace_encoded);
+    size_t packed = addr_trace_compress(addr_trace_encoded, raw_size);
+
+    Addr_Chunk_Header chunk = { n, raw_size, packed ? (uint32_t)packed : raw_size,
+        packed ? addr_trace_codec : ADDR_CODEC_NONE };
+    fwrite(&chunk, sizeof(chunk), 1, addr_trace_file);
+    fwrite(packed ? addr_trace_packed : addr_trace_encoded, 1, chunk.size, addr_trace_file);
+}
+
+/**
+ * @brief Writer thread: writes out handed-over buffers in order.
+ */
+static void *addr_trace_writer(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&addr_trace_lock);
+        while (addr_trace_written == addr_trace_submitted && !addr_trace_stop)
+            pthread_cond_wait(&addr_trace_data, &addr_trace_lock);
+        if (addr_trace_written == addr_trace_submitted) {
+            pthread_mutex_unlock(&addr_trace_lock);
+            break;
+        }
+        int buf = addr_trace_written % ADDR_TRACE_BUFFERS;
+        uint32_t n = addr_trace_records[buf];
+        pthread_mutex_unlock(&addr_trace_lock);
+
+        addr_trace_write_chunk(addr_trace_bufs[buf], n);
+
+        pthread_mutex_lock(&addr_trace_lock);
+        addr_trace_written++;
+        pthread_cond_signal(&addr_trace_space);
+        pthread_mutex_unlock(&addr_trace_lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hands the current buffer to the writer and waits, if need be, for
+ * the next one to be free.
+ */
+static void addr_trace_submit()
+{
+    pthread_mutex_lock(&addr_trace_lock);
+    addr_trace_records[addr_trace_submitted % ADDR_TRACE_BUFFERS] = addr_trace_fill;
+    addr_trace_submitted++;
+    pthread_cond_signal(&addr_trace_data);
+    while (addr_trace_submitted - addr_trace_written >= ADDR_TRACE_BUFFERS)
+        pthread_cond_wait(&addr_trace_space, &addr_trace_lock);
+    pthread_mutex_unlock(&addr_trace_lock);
+
+    addr_trace_cur = addr_trace_bufs[addr_trace_submitted % ADDR_TRACE_BUFFERS];
+    addr_trace_fill = 0;
+}
+
+/**
+ * @brief Picks the codec named by SIM_ADDR_TRACE_CODEC, or the default.
+ */
+static AddrCodec addr_trace_pick_codec()
+{
+    AddrCodec built_in = ADDR_CODEC_NONE;
+#if defined(SIM_ZSTD)
+    built_in = ADDR_CODEC_ZSTD;
+#elif defined(SIM_LZ4)
+    built_in = ADDR_CODEC_LZ4;
+#endif
+    const char *name = getenv("SIM_ADDR_TRACE_CODEC");
+    if (!name || !*name)
+        return built_in;
+
+    for (int c = 0; c < 3; c++) {
+        if (strcmp(name, addr_codec_names[c]) != 0)
+            continue;
+#ifndef SIM_ZSTD
+        if (c == ADDR_CODEC_ZSTD)
+            break;
+#endif
+#ifndef SIM_LZ4
+        if (c == ADDR_CODEC_LZ4)
+            break;
+#endif
+        return (AddrCodec)c;
+    }
+    fprintf(stderr, "Warning: address trace codec '%s' is not available, using %s\n",
+            name, addr_codec_names[built_in]);
+    return built_in;
+}
+
+/**
+ * @brief Opens the capture file named by SIM_ADDR_TRACE, if set, and starts
+ * the writer thread.
+ */
+void addr_trace_init()
+{
+    const char *path = getenv("SIM_ADDR_TRACE");
+    if (!path || !*path || addr_trace_file)
+        return;
+
+    addr_trace_file = fopen(path, "wb");
+    if (!addr_trace_file) {
+        fprintf(stderr, "Error: Can't open address trace file %s\n", path);
+        return;
+    }
+    addr_trace_codec = addr_trace_pick_codec();
+
+    size_t encoded = (size_t)ADDR_CHUNK_RECORDS * ADDR_RECORD_MAX_BYTES;
+    addr_trace_packed_size = encoded;
+#ifdef SIM_ZSTD
+    if (addr_trace_codec == ADDR_CODEC_ZSTD)
+        addr_trace_packed_size = ZSTD_compressBound(encoded);
+#endif
+#ifdef SIM_LZ4
+    if (addr_trace_codec == ADDR_CODEC_LZ4)
+        addr_trace_packed_size = LZ4_compressBound((int)encoded);
+#endif
+    addr_trace_encoded = malloc(encoded);
+    addr_trace_packed = malloc(addr_trace_packed_size);
+    for (int i = 0; i < ADDR_TRACE_BUFFERS; i++)
+        addr_trace_bufs[i] = malloc(ADDR_CHUNK_RECORDS * sizeof(Addr_Record));
+    for (int i = 0; i < ADDR_TRACE_BUFFERS; i++) {
+        if (!addr_trace_bufs[i] || !addr_trace_encoded || !addr_trace_packed) {
+            fprintf(stderr, "Error: Failed to allocate address trace buffers\n");
+            exit(1);
+        }
+    }
+    addr_trace_cur = addr_trace_bufs[0];
+
+    /* the count is filled in on close */
+    Addr_Trace_Header header = { ADDR_TRACE_MAGIC, ADDR_TRACE_VERSION, addr_trace_codec, 0 };
+    fwrite(&header, sizeof(header), 1, addr_trace_file);
+
+    if (pthread_create(&addr_trace_thread, NULL, addr_trace_writer, NULL) != 0) {
+        fprintf(stderr, "Error: Can't start address trace writer\n");
+        fclose(addr_trace_file);
+        addr_trace_file = NULL;
+        return;
+    }
+    addr_trace_on = 1;
+    atexit(addr_trace_close);
+}
+
+/**
+ * @brief Appends one reference (called through ADDR_TRACE()).
+ */
+void addr_trace_emit(AddrType type, uint32_t pc, uint32_t addr, int size)
+{
+    Addr_Record *rec = &addr_trace_cur[addr_trace_fill++];
+    rec->addr = addr;
+    rec->pc = pc;
+    rec->type = type;
+    rec->size = size;
+    rec->pad = 0;
+    addr_trace_count++;
+    if (addr_trace_fill == ADDR_CHUNK_RECORDS)
+        addr_trace_submit();
+}
+
+/**
+ * @brief Writes out the last chunk, stops the writer, records the count and
+ * closes the file.
+ */
+void addr_trace_close()
+{
+    if (!addr_trace_file)
+        return;
+
+    addr_trace_on = 0;
+    if (addr_trace_fill > 0)
+        addr_trace_submit();
+    pthread_mutex_lock(&addr_trace_lock);
+    addr_trace_stop = 1;
+    pthread_cond_signal(&addr_trace_data);
+    pthread_mutex_unlock(&addr_trace_lock);
+    pthread_join(addr_trace_thread, NULL);
+
+    Addr_Trace_Header header = { ADDR_TRACE_MAGIC, ADDR_TRACE_VERSION, addr_trace_codec, addr_trace_count };
+    fseek(addr_trace_file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, addr_trace_file);
+    fclose(addr_trace_file);
+    addr_trace_file = NULL;
+
+    for (int i = 0; i < ADDR_TRACE_BUFFERS; i++)
+        free(addr_trace_bufs[i]);
+    free(addr_trace_encoded);
+    free(addr_trace_packed);
+}
+
+/*==============================================================================
+ * Reading Traces
+ *============================================================================*/
+
+/* version 1 record */
+typedef struct Addr_Record_V1 {
+    uint32_t addr, pc, type;
+} Addr_Record_V1;
+
+static void *addr_trace_alloc(size_t size)
+{
+    void *p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate address trace buffers\n");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * @brief Checks a trace header ('header' is NULL if the file is too short).
+ * Exits if the file is not a trace this reader understands.
+ */
+static void addr_trace_check_header(const char *path, const Addr_Trace_Header *header)
+{
+    if (!header || header->magic != ADDR_TRACE_MAGIC) {
+        fprintf(stderr, "Error: %s is not an address trace\n", path);
+        exit(1);
+    }
+    if (header->version != ADDR_TRACE_VERSION &&
+            (header->version != 1 || header->codec != sizeof(Addr_Record_V1))) {
+        fprintf(stderr, "Error: %s: unsupported address trace version %u\n", path, header->version);
+        exit(1);
+    }
+}
+
+/**
+ * @brief Checks a version 2 chunk header. Exits if it is corrupt.
+ */
+static void addr_trace_check_chunk(const char *path, const Addr_Chunk_Header *chunk)
+{
+    if (chunk->records > ADDR_CHUNK_RECORDS || chunk->raw_size > chunk->records * ADDR_RECORD_MAX_BYTES ||
+            chunk->codec > ADDR_CODEC_LZ4 || (chunk->codec == ADDR_CODEC_NONE && chunk->size != chunk->raw_size)) {
+        fprintf(stderr, "Error: %s: corrupt chunk header\n", path);
+        exit(1);
+    }
+}
+
+/**
+ * @brief Opens a captured trace and checks its header. Exits if the file is
+ * not a trace this reader understands.
+ */
+Addr_Trace_Reader *addr_trace_open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open trace file %s\n", path);
+        exit(1);
+    }
+    Addr_Trace_Header header;
+    int got = fread(&header, sizeof(header), 1, f) == 1;
+    addr_trace_check_header(path, got ? &header : NULL);
+
+    Addr_Trace_Reader *r = addr_trace_alloc(sizeof(Addr_Trace_Reader));
+    memset(r, 0, sizeof(*r));
+    r->file = f;
+    r->path = path;
+    r->version = header.version;
+    r->raw = addr_trace_alloc(ADDR_CHUNK_RECORDS *
+            (r->version == 1 ? sizeof(Addr_Record_V1) : (size_t)ADDR_RECORD_MAX_BYTES));
+    return r;
+}
+
+/**
+ * @brief Decompresses a chunk payload into 'raw'.
+ * @return 0 on success, -1 if it does not decompress to 'raw_size' bytes.
+ */
+static int addr_trace_decompress(const char *path, const Addr_Chunk_Header *chunk, const uint8_t *payload,
+        uint8_t *raw)
+{
+    switch (chunk->codec) {
+#ifdef SIM_ZSTD
+        case ADDR_CODEC_ZSTD:
+            return ZSTD_decompress(raw, chunk->raw_size, payload, chunk->size) == chunk->raw_size ? 0 : -1;
+#endif
+#ifdef SIM_LZ4
+        case ADDR_CODEC_LZ4:
+            return LZ4_decompress_safe((const char *)payload, (char *)raw,
+                    (int)chunk->size, (int)chunk->raw_size) == (int)chunk->raw_size ? 0 : -1;
+#endif
+        default:
+            (void)payload;
+            (void)raw;
+            fprintf(stderr, "Error: %s: %s compression is not built in (make %s=1)\n", path,
+                    chunk->codec == ADDR_CODEC_ZSTD ? "zstd" : "lz4", chunk->codec == ADDR_CODEC_ZSTD ? "ZSTD" : "LZ4");
+            exit(1);
+    }
+}
+
+/**
+ * @brief Decodes a version 2 chunk whose header has been checked, given its
+ * stored payload, into 'buf'. 'raw' takes the decompressed payload. Exits
+ * if the chunk is corrupt.
+ */
+static void addr_trace_decode_chunk(const char *path, const Addr_Chunk_Header *chunk, const uint8_t *payload,
+        uint8_t *raw, Addr_Record *buf)
+{
+    if (chunk->codec != ADDR_CODEC_NONE) {
+        if (addr_trace_decompress(path, chunk, payload, raw)) {
+            fprintf(stderr, "Error: %s: corrupt compressed chunk\n", path);
+            exit(1);
+        }
+        payload = raw;
+    }
+    if (addr_decode(payload, chunk->raw_size, chunk->records, buf)) {
+        fprintf(stderr, "Error: %s: corrupt chunk\n", path);
+        exit(1);
+    }
+}
+
+/* converts version 1 records */
+static void addr_trace_convert_v1(const Addr_Record_V1 *old, int n, Addr_Record *buf)
+{
+    for (int i = 0; i < n; i++) {
+        buf[i].addr = old[i].addr;
+        buf[i].pc = old[i].pc;
+        buf[i].type = old[i].type;
+        buf[i].size = 4;
+        buf[i].pad = 0;
+    }
+}
+
+/**
+ * @brief Reads the next chunk into 'buf' (room for ADDR_CHUNK_RECORDS).
+ * A chunk cut short by a writer that did not finish ends the trace. Exits if
+ * the trace is corrupt.
+ * @return the number of references read, 0 at the end of the trace.
+ */
+int addr_trace_read(Addr_Trace_Reader *r, Addr_Record *buf)
+{
+    if (r->version == 1) {
+        Addr_Record_V1 *old = (Addr_Record_V1 *)r->raw;
+        int n = (int)fread(old, sizeof(Addr_Record_V1), ADDR_CHUNK_RECORDS, r->file);
+        addr_trace_convert_v1(old, n, buf);
+        return n;
+    }
+
+    Addr_Chunk_Header chunk;
+    if (fread(&chunk, sizeof(chunk), 1, r->file) != 1)
+        return 0;
+    addr_trace_check_chunk(r->path, &chunk);
+    if (chunk.size > r->payload_size) {
+        free(r->payload);
+        r->payload = addr_trace_alloc(chunk.size);
+        r->payload_size = chunk.size;
+    }
+    if (fread(r->payload, 1, chunk.size, r->file) != chunk.size) {
+        fprintf(stderr, "Warning: %s: trace ends in a partial chunk, which is ignored\n", r->path);
+        return 0;
+    }
+
+    addr_trace_decode_chunk(r->path, &chunk, r->payload, r->raw, buf);
+    return (int)chunk.records;
+}
+
+/**
+ * @brief Closes a reader opened with addr_trace_open().
+ */
+void addr_trace_close_reader(Addr_Trace_Reader *r)
+{
+    fclose(r->file);
+    free(r->payload);
+    free(r->raw);
+    free(r);
+}
+
+/*==============================================================================
+ * Mapped Traces
+ *
+ * The file is mapped read-only once and its chunk headers indexed; any
+ * number of threads then decode chunks from the shared mapping into buffers
+ * of their own, so the trace is held in memory in its stored (encoded or
+ * compressed) form only.
+ *============================================================================*/
+
+/**
+ * @brief Maps a captured trace and indexes its chunks. A chunk cut short by
+ * a writer that did not finish ends the trace. Exits if the file is not a
+ * trace this reader understands or is corrupt.
+ */
+Addr_Trace_Map *addr_trace_map(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Can't open trace file %s\n", path);
+        exit(1);
+    }
+    size_t length = (size_t)st.st_size;
+    const uint8_t *base = NULL;
+    if (length >= sizeof(Addr_Trace_Header)) {
+        base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "Error: Can't map trace file %s\n", path);
+            exit(1);
+        }
+    }
+    close(fd);
+    const Addr_Trace_Header *header = (const Addr_Trace_Header *)base;
+    addr_trace_check_header(path, header);
+
+    Addr_Trace_Map *m = addr_trace_alloc(sizeof(Addr_Trace_Map));
+    memset(m, 0, sizeof(*m));
+    m->base = base;
+    m->length = length;
+    m->path = path;
+    m->version = header->version;
+
+    size_t pos = sizeof(Addr_Trace_Header);
+    if (m->version == 1) {
+        uint64_t records = (length - pos) / sizeof(Addr_Record_V1);
+        m->num_chunks = (uint32_t)((records + ADDR_CHUNK_RECORDS - 1) / ADDR_CHUNK_RECORDS);
+        m->count = records;
+        return m;
+    }
+
+    uint32_t capacity = 0;
+    while (length - pos >= sizeof(Addr_Chunk_Header)) {
+        const Addr_Chunk_Header *chunk = (const Addr_Chunk_Header *)(base + pos);
+        addr_trace_check_chunk(path, chunk);
+        if (length - pos - sizeof(Addr_Chunk_Header) < chunk->size) {
+            fprintf(stderr, "Warning: %s: trace ends in a partial chunk, which is ignored\n", path);
+            break;
+        }
+        if (m->num_chunks == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            m->chunk_offset = realloc(m->chunk_offset, capacity * sizeof(size_t));
+            if (!m->chunk_offset) {
+                fprintf(stderr, "Error: Failed to allocate address trace buffers\n");
+                exit(1);
+            }
+        }
+        m->chunk_offset[m->num_chunks++] = pos;
+        m->count += chunk->records;
+        pos += sizeof(Addr_Chunk_Header) + chunk->size;
+    }
+    return m;
+}
+
+/**
+ * @brief Decodes chunk 'i' of a mapped trace into 'buf' (room for
+ * ADDR_CHUNK_RECORDS). 'scratch' (ADDR_CHUNK_SCRATCH bytes) takes the
+ * decompressed payload; each thread passes its own buffers. Exits if the
+ * chunk is corrupt.
+ * @return the number of references decoded.
+ */
+int addr_trace_map_read(const Addr_Trace_Map *m, uint32_t i, uint8_t *scratch, Addr_Record *buf)
+{
+    if (m->version == 1) {
+        uint64_t first = (uint64_t)i * ADDR_CHUNK_RECORDS;
+        int n = m->count - first < ADDR_CHUNK_RECORDS ? (int)(m->count - first) : ADDR_CHUNK_RECORDS;
+        addr_trace_convert_v1((const Addr_Record_V1 *)(m->base + sizeof(Addr_Trace_Header)) + first, n, buf);
+        return n;
+    }
+    const Addr_Chunk_Header *chunk = (const Addr_Chunk_Header *)(m->base + m->chunk_offset[i]);
+    addr_trace_decode_chunk(m->path, chunk, (const uint8_t *)(chunk + 1), scratch, buf);
+    return (int)chunk->records;
+}
+
+/**
+ * @brief Unmaps a trace mapped with addr_trace_map().
+ */
+void addr_trace_unmap(Addr_Trace_Map *m)
+{
+    munmap((void *)m->base, m->length);
+    free(m->chunk_offset);
+    free(m);
+}
@@ -0,0 +1,122 @@
+#ifndef _ADDRTRACE_H_
+#define _ADDRTRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Address trace capture
+ *
+ * Records the reference stream the pipeline presents to its L1 caches, one
+ * record per instruction fetch and one per load or store, so that cache
+ * configurations can later be evaluated against it without rerunning the
+ * pipeline (tools/sweep.c, tools/mrc.c). Capture is on when SIM_ADDR_TRACE
+ * names the output file at pipe_init() time; SIM_ADDR_TRACE_CODEC picks the
+ * compression (none, or zstd / lz4 in builds made with ZSTD=1 / LZ4=1;
+ * default: the first of those built in).
+ *
+ * The simulator only copies each reference into a chunk buffer. Full buffers
+ * go to a background writer thread, which encodes, compresses and writes
+ * them, so the simulation waits on the disk only when every buffer is in
+ * use.
+ *
+ * On-disk format (version 2, little-endian): one Addr_Trace_Header, then
+ * chunks until the end of the file, each an Addr_Chunk_Header followed by
+ * 'size' bytes of payload in the chunk's codec. Decompressed, the payload is
+ * 'records' references, each a tag byte
+ *
+ *   bits 0-1  AddrType
+ *   bits 2-3  log2 of the access size
+ *   bit 4     fetch only: the PC follows the previous fetch (no operands)
+ *
+ * then, as zigzag LEB128 varints: for a fetch that is not sequential, its PC
+ * relative to the previous fetch + 4; for a load or store, its address
+ * relative to the previous load or store, then its PC relative to the
+ * previous fetch. The deltas restart from 0 in every chunk, so chunks decode
+ * independently. Version 1 traces (fixed 12-byte records) are still read. */
+
+#define ADDR_TRACE_MAGIC   0x52444441u /* "ADDR" */
+#define ADDR_TRACE_VERSION 2
+
+#define ADDR_CHUNK_RECORDS (1 << 16) /* references per chunk */
+#define ADDR_RECORD_MAX_BYTES 11     /* tag + two 5-byte varints */
+#define ADDR_CHUNK_SCRATCH (ADDR_CHUNK_RECORDS * ADDR_RECORD_MAX_BYTES) /* largest decompressed payload */
+
+typedef enum {
+    ADDR_IFETCH,
+    ADDR_LOAD,
+    ADDR_STORE      /* includes sub-word stores (read-modify-write) */
+} AddrType;
+
+typedef enum {
+    ADDR_CODEC_NONE,
+    ADDR_CODEC_ZSTD,
+    ADDR_CODEC_LZ4
+} AddrCodec;
+
+#define ADDR_TAG_SEQUENTIAL 0x10
+
+typedef struct Addr_Trace_Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t codec;         /* AddrCodec the writer asked for (record size in version 1) */
+    uint64_t count;         /* references in the file (0 = writer did not finish) */
+} Addr_Trace_Header;
+
+typedef struct Addr_Chunk_Header {
+    uint32_t records;       /* references in the chunk */
+    uint32_t raw_size;      /* encoded payload bytes */
+    uint32_t size;          /* stored payload bytes that follow */
+    uint32_t codec;         /* AddrCodec of the stored payload (NONE if it did not shrink) */
+} Addr_Chunk_Header;
+
+/* one decoded reference */
+typedef struct Addr_Record {
+    uint32_t addr;          /* referenced address (the PC for fetches) */
+    uint32_t pc;            /* instruction making the reference */
+    uint8_t type;           /* AddrType */
+    uint8_t size;           /* bytes accessed: 1, 2 or 4 */
+    uint16_t pad;
+} Addr_Record;
+
+/* sequential reader, one chunk at a time */
+typedef struct Addr_Trace_Reader {
+    FILE *file;
+    const char *path;
+    int version;
+    uint8_t *payload;       /* stored chunk payload */
+    uint8_t *raw;           /* ... decompressed */
+    uint32_t payload_size, raw_size;
+} Addr_Trace_Reader;
+
+/* a trace mapped read-only, whose chunks threads decode independently */
+typedef struct Addr_Trace_Map {
+    const uint8_t *base;
+    size_t length;
+    const char *path;
+    int version;
+    uint32_t num_chunks;
+    size_t *chunk_offset;   /* [num_chunks] chunk headers in the file (version 2) */
+    uint64_t count;         /* references in the complete chunks */
+} Addr_Trace_Map;
+
+extern int addr_trace_on;
+
+void addr_trace_init();
+void addr_trace_close();
+void addr_trace_emit(AddrType type, uint32_t pc, uint32_t addr, int size);
+
+Addr_Trace_Reader *addr_trace_open(const char *path);
+int addr_trace_read(Addr_Trace_Reader *r, Addr_Record *buf);
+void addr_trace_close_reader(Addr_Trace_Reader *r);
+Addr_Trace_Map *addr_trace_map(const char *path);
+int addr_trace_map_read(const Addr_Trace_Map *m, uint32_t i, uint8_t *scratch, Addr_Record *buf);
+void addr_trace_unmap(Addr_Trace_Map *m);
+
+/* records one reference if capture is on */
+#define ADDR_TRACE(type, pc, addr, size)                                       \
+    do {                                                                       \
+        if (addr_trace_on)                                                     \
+            addr_trace_emit((type), (pc), (addr), (size));                     \
+    } while (0)
+
+#endif
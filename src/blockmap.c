@@ -0,0 +1,71 @@
+#include "blockmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint32_t *blockmap_alloc(uint32_t size)
+{
+    uint32_t *p = calloc(size, sizeof(uint32_t));
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate block map\n");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * @brief Initializes an empty map with room for at least 'min_size' / 2
+ * blocks before it first grows.
+ */
+void blockmap_init(Block_Map *map, uint32_t min_size)
+{
+    map->size = BLOCKMAP_MIN_SIZE;
+    while (map->size < min_size)
+        map->size *= 2;
+    map->key = blockmap_alloc(map->size);
+    map->value = blockmap_alloc(map->size);
+    map->count = 0;
+}
+
+void blockmap_free(Block_Map *map)
+{
+    free(map->key);
+    free(map->value);
+    map->key = map->value = NULL;
+    map->size = map->count = 0;
+}
+
+/**
+ * @brief Doubles the map, keeping it at most half full.
+ */
+static void blockmap_grow(Block_Map *map)
+{
+    uint32_t *keys = map->key, *values = map->value;
+    uint32_t old_size = map->size;
+
+    map->size *= 2;
+    map->key = blockmap_alloc(map->size);
+    map->value = blockmap_alloc(map->size);
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (!keys[i])
+            continue;
+        uint32_t j = blockmap_find(map, keys[i] - 1);
+        map->key[j] = keys[i];
+        map->value[j] = values[i];
+    }
+    free(keys);
+    free(values);
+}
+
+/**
+ * @brief Adds 'block', which must not be in the map yet, growing the map
+ * first if needed.
+ * @return the block's entry, its value still to be set.
+ */
+uint32_t blockmap_insert(Block_Map *map, uint32_t block)
+{
+    if (++map->count * 2 > map->size)
+        blockmap_grow(map);
+    uint32_t i = blockmap_find(map, block);
+    map->key[i] = block + 1;
+    return i;
+}
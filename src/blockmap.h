@@ -0,0 +1,41 @@
+#ifndef _BLOCKMAP_H_
+#define _BLOCKMAP_H_
+
+#include <stdint.h>
+
+/* Block map
+ *
+ * An open-addressing hash map from block number to a 32-bit value, shared by
+ * the profilers that keep state per block (stackdist.c, missclass.c). Keys
+ * are stored as block + 1, so that 0 marks an empty entry, and are never
+ * removed. Collisions are resolved by linear probing in a power-of-two table
+ * that doubles whenever it would become more than half full.
+ *
+ * Callers work with entry indexes: blockmap_find() returns the entry of a
+ * block, or the empty entry where it belongs, and blockmap_insert() adds a
+ * block that is not in the map yet. An index stays valid until the next
+ * insertion. */
+
+#define BLOCKMAP_MIN_SIZE 1024
+
+typedef struct Block_Map {
+    uint32_t *key;          /* block + 1, or 0 for an empty entry */
+    uint32_t *value;
+    uint32_t size;          /* power of two */
+    uint32_t count;         /* blocks in the map */
+} Block_Map;
+
+void blockmap_init(Block_Map *map, uint32_t min_size);
+void blockmap_free(Block_Map *map);
+uint32_t blockmap_insert(Block_Map *map, uint32_t block);
+
+/* Returns the entry for 'block', or the empty entry where it belongs. */
+static inline uint32_t blockmap_find(const Block_Map *map, uint32_t block)
+{
+    uint32_t i = (block * 0x9E3779B1u) & (map->size - 1);
+    while (map->key[i] && map->key[i] != block + 1)
+        i = (i + 1) & (map->size - 1);
+    return i;
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include "bpred.h"
+#include "shell.h"
+#include "mips.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *bpred_names[] = { "none", "btfn", "bimodal", "gshare", "tournament" };
+
+static void *bpred_alloc(size_t count, size_t size)
+{
+    void *p = calloc(count, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate branch predictor\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* 2-bit counters, starting weakly on the not-taken (or bimodal) side */
+static uint8_t *bpred_counters(uint32_t entries)
+{
+    uint8_t *c = bpred_alloc(entries, 1);
+    memset(c, 1, entries);
+    return c;
+}
+
+static int bpred_power_of_two(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * @brief Creates a predictor of the given type, with a BTB of 'btb_entries'
+ * entries, direction tables of 'entries' counters and a return address stack
+ * of 'ras_entries' entries.
+ */
+Branch_Predictor *bpred_create(BpredType type, int btb_entries, int entries, int history_bits,
+        int ras_entries)
+{
+    if (!bpred_power_of_two(btb_entries) || !bpred_power_of_two(entries) ||
+            history_bits < 0 || history_bits > 30 || ras_entries < 0) {
+        fprintf(stderr, "Error: Invalid branch predictor configuration\n");
+        exit(1);
+    }
+    Branch_Predictor *bp = bpred_alloc(1, sizeof(Branch_Predictor));
+    bp->type = type;
+    if (type == BPRED_NONE)
+        return bp;
+
+    bp->btb_mask = btb_entries - 1;
+    bp->mask = entries - 1;
+    bp->history_bits = history_bits;
+    bp->btb = bpred_alloc(btb_entries, sizeof(Btb_Entry));
+    if (type == BPRED_BIMODAL || type == BPRED_TOURNAMENT)
+        bp->bimodal = bpred_counters(entries);
+    if (type == BPRED_GSHARE || type == BPRED_TOURNAMENT)
+        bp->gshare = bpred_counters(entries);
+    if (type == BPRED_TOURNAMENT)
+        bp->chooser = bpred_counters(entries);
+    if (ras_entries > 0) {
+        bp->ras_entries = ras_entries;
+        bp->ras = bpred_alloc(ras_entries, sizeof(uint32_t));
+    }
+    return bp;
+}
+
+/**
+ * @brief Destroys a predictor.
+ */
+void bpred_destroy(Branch_Predictor *bp)
+{
+    if (!bp)
+        return;
+    free(bp->btb);
+    free(bp->bimodal);
+    free(bp->gshare);
+    free(bp->chooser);
+    free(bp->ras);
+    free(bp);
+}
+
+/*==============================================================================
+ * Return Address Stack
+ *============================================================================*/
+
+static void bpred_ras_push(Branch_Predictor *bp, uint32_t addr)
+{
+    Ras_Checkpoint *r = &bp->ras_state;
+
+    bp->ras_pushes++;
+    r->top = (r->top + 1) % bp->ras_entries;
+    bp->ras[r->top] = addr;
+    if (r->depth < bp->ras_entries)
+        r->depth++;
+    else
+        bp->ras_overflows++;
+}
+
+/* pops the top entry into *addr; 0 if the stack is empty */
+static int bpred_ras_pop(Branch_Predictor *bp, uint32_t *addr)
+{
+    Ras_Checkpoint *r = &bp->ras_state;
+
+    if (r->depth == 0) {
+        bp->ras_empty++;
+        return 0;
+    }
+    *addr = bp->ras[r->top];
+    r->top = (r->top + bp->ras_entries - 1) % bp->ras_entries;
+    r->depth--;
+    return 1;
+}
+
+/**
+ * @brief Puts the stack back in the state saved with an instruction, on a
+ * recovery after it.
+ */
+void bpred_ras_restore(Branch_Predictor *bp, const Ras_Checkpoint *cp)
+{
+    if (!bp->ras)
+        return;
+    bp->ras_state = *cp;
+    bp->ras[cp->top] = cp->top_addr;
+}
+
+/* pushes or pops for the instruction word fetched at 'pc'; returns 1 with
+ * the return address in *target for a return the stack predicts */
+static int bpred_ras_fetch(Branch_Predictor *bp, uint32_t pc, uint32_t instruction, uint32_t *target)
+{
+    uint32_t opcode = instruction >> 26, rs = (instruction >> 21) & 0x1F;
+    uint32_t rt = (instruction >> 16) & 0x1F, funct = instruction & 0x3F;
+
+    if (opcode == OP_JAL || (opcode == OP_SPECIAL && funct == SUBOP_JALR) ||
+            (opcode == OP_BRSPEC && (rt == BROP_BLTZAL || rt == BROP_BGEZAL))) {
+        bpred_ras_push(bp, pc + 4);
+        return 0;
+    }
+    if (opcode == OP_SPECIAL && funct == SUBOP_JR && rs == 31)
+        return bpred_ras_pop(bp, target);
+    return 0;
+}
+
+/*==============================================================================
+ * Prediction and Training
+ *============================================================================*/
+
+static uint32_t bpred_index(const Branch_Predictor *bp, uint32_t pc)
+{
+    return (pc >> 2) & bp->mask;
+}
+
+static uint32_t bpred_gshare_index(const Branch_Predictor *bp, uint32_t pc)
+{
+    uint32_t history = bp->history & ((1u << bp->history_bits) - 1);
+    return ((pc >> 2) ^ history) & bp->mask;
+}
+
+static void bpred_train(uint8_t *counter, int taken)
+{
+    if (taken && *counter < 3)
+        (*counter)++;
+    else if (!taken && *counter > 0)
+        (*counter)--;
+}
+
+/* direction prediction for a conditional branch to 'target' */
+static int bpred_direction(const Branch_Predictor *bp, uint32_t pc, uint32_t target)
+{
+    switch (bp->type) {
+        case BPRED_BTFN:
+            return target <= pc;
+        case BPRED_BIMODAL:
+            return bp->bimodal[bpred_index(bp, pc)] >= 2;
+        case BPRED_GSHARE:
+            return bp->gshare[bpred_gshare_index(bp, pc)] >= 2;
+        case BPRED_TOURNAMENT:
+            if (bp->chooser[bpred_index(bp, pc)] >= 2)
+                return bp->gshare[bpred_gshare_index(bp, pc)] >= 2;
+            return bp->bimodal[bpred_index(bp, pc)] >= 2;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Predicts the instruction word 'instruction' fetched at 'pc': sets
+ * pred->taken, with the target in pred->target, if fetch should go on at a
+ * branch target rather than at pc + 4.
+ */
+void bpred_predict(Branch_Predictor *bp, uint32_t pc, uint32_t instruction, Bpred_Info *pred)
+{
+    pred->taken = 0;
+    pred->from_ras = 0;
+    if (bp->type == BPRED_NONE)
+        return;
+
+    if (bp->ras) {
+        pred->from_ras = bpred_ras_fetch(bp, pc, instruction, &pred->target);
+        pred->ras = bp->ras_state;
+        pred->ras.top_addr = bp->ras[bp->ras_state.top];
+        if (pred->from_ras) {
+            pred->taken = 1;
+            return;
+        }
+    }
+
+    const Btb_Entry *e = &bp->btb[(pc >> 2) & bp->btb_mask];
+    if (e->pc != pc)
+        return;
+    if (e->cond && !bpred_direction(bp, pc, e->target))
+        return;
+    pred->target = e->target;
+    pred->taken = 1;
+}
+
+/* trains the direction tables with the outcome of a conditional branch */
+static void bpred_train_direction(Branch_Predictor *bp, uint32_t pc, int taken)
+{
+    uint32_t i = bpred_index(bp, pc), g = bpred_gshare_index(bp, pc);
+
+    if (bp->chooser) {
+        int bimodal_right = (bp->bimodal[i] >= 2) == taken;
+        int gshare_right = (bp->gshare[g] >= 2) == taken;
+        if (bimodal_right != gshare_right)
+            bpred_train(&bp->chooser[i], gshare_right);
+    }
+    if (bp->bimodal)
+        bpred_train(&bp->bimodal[i], taken);
+    if (bp->gshare)
+        bpred_train(&bp->gshare[g], taken);
+    bp->history = (bp->history << 1) | (taken != 0);
+}
+
+/**
+ * @brief Resolves a branch at 'pc' that went to 'target' if 'taken', given
+ * the prediction made when it was fetched, and trains the predictor. The
+ * caller restores the return address stack on a misprediction.
+ * @return 1 if the prediction was wrong and fetch must be redirected.
+ */
+int bpred_resolve(Branch_Predictor *bp, uint32_t pc, int cond, int taken, uint32_t target,
+        const Bpred_Info *pred)
+{
+    int wrong_direction = taken != pred->taken;
+    int wrong_target = taken && pred->taken && target != pred->target;
+
+    bp->branches++;
+    bp->conditional += cond != 0;
+    bp->taken += taken != 0;
+    bp->direction_mispredicts += wrong_direction;
+    bp->target_mispredicts += wrong_target;
+    bp->mispredicts += wrong_direction || wrong_target;
+    if (pred->from_ras) {
+        bp->ras_hits += !wrong_target;
+        bp->ras_mispredicts += wrong_target;
+    }
+
+    if (bp->type != BPRED_NONE) {
+        if (cond && bp->type != BPRED_BTFN)
+            bpred_train_direction(bp, pc, taken);
+        if (taken) {
+            Btb_Entry *e = &bp->btb[(pc >> 2) & bp->btb_mask];
+            e->pc = pc;
+            e->target = target;
+            e->cond = cond;
+        }
+    }
+    return wrong_direction || wrong_target;
+}
+
+/*==============================================================================
+ * Statistics
+ *============================================================================*/
+
+/**
+ * @brief Prints the branch statistics, as part of rdump.
+ */
+void bpred_print_stats(const Branch_Predictor *bp)
+{
+    printf("BranchPredictor: %s\n", bpred_names[bp->type]);
+    printf("Branches: %" PRIu64 " (%" PRIu64 " conditional, %" PRIu64 " taken)\n",
+            bp->branches, bp->conditional, bp->taken);
+    printf("Mispredicts: %" PRIu64 " (%" PRIu64 " direction, %" PRIu64 " target)\n",
+            bp->mispredicts, bp->direction_mispredicts, bp->target_mispredicts);
+    if (bp->branches > 0)
+        printf("BranchAccuracy: %.2f%%\n", 100.0 - (double)bp->mispredicts / bp->branches * 100.0);
+    if (stat_inst_retire > 0)
+        printf("BranchMPKI: %.3f\n", (double)bp->mispredicts * 1000.0 / stat_inst_retire);
+    if (bp->ras)
+        printf("ReturnStack: %d entries, %" PRIu64 " hits, %" PRIu64 " mispredicts, %" PRIu64
+                " overflows, %" PRIu64 " empty\n", bp->ras_entries, bp->ras_hits, bp->ras_mispredicts,
+                bp->ras_overflows, bp->ras_empty);
+}
+
+/**
+ * @brief Registers the branch statistics in the statistics registry under
+ * 'prefix'.
+ */
+void bpred_register_stats(Branch_Predictor *bp, const char *prefix)
+{
+    stats_counter(prefix, "branches", &bp->branches, "resolved branches");
+    stats_counter(prefix, "conditional", &bp->conditional, "resolved conditional branches");
+    stats_counter(prefix, "taken", &bp->taken, "taken branches");
+    stats_counter(prefix, "mispredicts", &bp->mispredicts, "branches that redirected fetch");
+    stats_counter(prefix, "mispredicts.direction", &bp->direction_mispredicts, "branches predicted the wrong way");
+    stats_counter(prefix, "mispredicts.target", &bp->target_mispredicts, "taken branches predicted to the wrong target");
+    if (bp->ras) {
+        stats_counter(prefix, "ras.pushes", &bp->ras_pushes, "return addresses pushed at fetch");
+        stats_counter(prefix, "ras.overflows", &bp->ras_overflows, "pushes onto a full stack");
+        stats_counter(prefix, "ras.empty", &bp->ras_empty, "returns fetched with the stack empty");
+        stats_counter(prefix, "ras.hits", &bp->ras_hits, "returns predicted right by the stack");
+        stats_counter(prefix, "ras.mispredicts", &bp->ras_mispredicts, "returns predicted wrong by the stack");
+    }
+    stats_ratio(prefix, "mpki", &bp->mispredicts, &stat_inst_retire, 1000.0,
+            "mispredicts per thousand retired instructions");
+}
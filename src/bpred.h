@@ -0,0 +1,108 @@
+#ifndef _BPRED_H_
+#define _BPRED_H_
+
+#include <stdint.h>
+
+/* Branch prediction
+ *
+ * The fetch stage asks the Branch_Predictor for the next fetch address of
+ * every instruction it fetches (bpred_predict). A branch is only known, with
+ * its last target, once it is in the branch target buffer: a direct-mapped
+ * table of 'btb_entries' entries tagged with the full PC, filled by taken
+ * branches. On a BTB hit, unconditional branches are predicted taken and
+ * conditional ones by the direction predictor:
+ *
+ *   none        never taken, and no BTB: every taken branch is mispredicted
+ *               (the pipeline without a predictor)
+ *   btfn        static: backward taken, forward not taken
+ *   bimodal     'entries' 2-bit counters indexed by PC
+ *   gshare      'entries' 2-bit counters indexed by PC xor the last
+ *               'history' conditional outcomes
+ *   tournament  bimodal and gshare, with 'entries' 2-bit counters indexed by
+ *               PC choosing between them
+ *
+ * Returns are predicted by a return address stack of 'ras_entries' entries
+ * (0 = none), driven by the instruction word at fetch: JAL, JALR, BLTZAL and
+ * BGEZAL push their return address (they link whether or not they branch),
+ * and "jr $31" pops its predicted target, ahead of the BTB. The stack is
+ * circular: a push onto a full stack overwrites the oldest entry, and a
+ * return that finds it empty falls back to the BTB.
+ *
+ * Branches are resolved in the execute stage (bpred_resolve): the predictor
+ * is trained with the outcome, including the global history, so younger
+ * branches already in flight predict with slightly stale history, and a
+ * wrong direction or target redirects fetch through pipe_recover(). Every
+ * fetched instruction carries a checkpoint of the stack (its top index, depth
+ * and top entry, after its own push or pop); the recovery restores it
+ * (bpred_ras_restore), undoing the wrong path. Only branches enter the BTB,
+ * so other instructions are never predicted taken. */
+
+typedef enum {
+    BPRED_NONE,
+    BPRED_BTFN,
+    BPRED_BIMODAL,
+    BPRED_GSHARE,
+    BPRED_TOURNAMENT
+} BpredType;
+
+typedef struct Btb_Entry {
+    uint32_t pc;            /* tag (0 = invalid) */
+    uint32_t target;
+    int cond;               /* conditional branch (else always taken) */
+} Btb_Entry;
+
+/* return address stack state, saved with every fetched instruction */
+typedef struct Ras_Checkpoint {
+    int top;                /* index of the top entry */
+    int depth;              /* valid entries */
+    uint32_t top_addr;      /* the top entry */
+} Ras_Checkpoint;
+
+/* the prediction made for one fetched instruction */
+typedef struct Bpred_Info {
+    int taken;              /* predicted a taken branch... */
+    uint32_t target;        /* ... to here */
+    int from_ras;           /* target popped off the return address stack */
+    Ras_Checkpoint ras;
+} Bpred_Info;
+
+typedef struct Branch_Predictor {
+    BpredType type;
+    uint32_t btb_mask;      /* entries - 1 (power of two) */
+    uint32_t mask;          /* counter tables: entries - 1 (power of two) */
+    int history_bits;
+    uint32_t history;       /* global history, latest outcome in bit 0 */
+    Btb_Entry *btb;
+    uint8_t *bimodal;       /* [entries] 2-bit counters, taken if >= 2 */
+    uint8_t *gshare;        /* [entries] */
+    uint8_t *chooser;       /* [entries] tournament: gshare if >= 2 */
+    uint32_t *ras;          /* [ras_entries] return address stack */
+    int ras_entries;
+    Ras_Checkpoint ras_state; /* current top and depth */
+
+    /* Statistics */
+    uint64_t branches;      /* resolved branches */
+    uint64_t conditional;   /* ... conditional */
+    uint64_t taken;         /* ... taken */
+    uint64_t mispredicts;   /* ... that redirected fetch */
+    uint64_t direction_mispredicts; /* ... predicted the wrong way */
+    uint64_t target_mispredicts;    /* ... predicted taken to the wrong target */
+    uint64_t ras_pushes;    /* return addresses pushed (at fetch, so also
+                               on wrong paths) */
+    uint64_t ras_overflows; /* ... onto a full stack, losing the oldest */
+    uint64_t ras_empty;     /* returns fetched with the stack empty */
+    uint64_t ras_hits;      /* returns resolved, predicted right by the stack */
+    uint64_t ras_mispredicts; /* ... predicted wrong */
+} Branch_Predictor;
+
+Branch_Predictor *bpred_create(BpredType type, int btb_entries, int entries, int history_bits,
+        int ras_entries);
+void bpred_destroy(Branch_Predictor *bp);
+void bpred_predict(Branch_Predictor *bp, uint32_t pc, uint32_t instruction, Bpred_Info *pred);
+int bpred_resolve(Branch_Predictor *bp, uint32_t pc, int cond, int taken, uint32_t target,
+        const Bpred_Info *pred);
+void bpred_ras_restore(Branch_Predictor *bp, const Ras_Checkpoint *cp);
+void bpred_print_stats(const Branch_Predictor *bp);
+void bpred_register_stats(Branch_Predictor *bp, const char *prefix);
+
+#endif
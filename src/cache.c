@@ -0,0 +1,1809 @@
+#include "cache.h"
+#include "prefetch.h"
+#include "stackdist.h"
+#include "missclass.h"
+#include "setprof.h"
+#include "shell.h"
+#include "trace.h"
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*==============================================================================
+ * Cache Implementation
+ *============================================================================*/
+
+/* latency of main memory, below the last level of every hierarchy */
+int cache_mem_latency = 50;
+
+/* caches hold metadata only, backing memory holds the data */
+int cache_tag_only = 0;
+
+/* next id handed out by cache_create (identifies the cache in trace records) */
+static int cache_next_id = 0;
+
+/* set while a prefetch fill walks down the hierarchy, so that the levels it
+ * passes through do not count it as a demand access */
+static int cache_prefetching = 0;
+
+/* set to the cache a secondary miss is accessing: the block its primary miss
+ * filled is found there, but the access is only counted as an MSHR merge */
+static Cache *cache_merging = NULL;
+
+/* round 'n' up to a multiple of 'align' (power of two) */
+static size_t cache_round_up(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+/**
+ * @brief Checks a cache geometry: power-of-two blocks of CACHE_MIN_BLOCK to
+ * CACHE_MAX_BLOCK bytes and a whole, non-zero number of sets.
+ */
+int cache_valid_geometry(int size, int block_size, int associativity) {
+    return block_size >= CACHE_MIN_BLOCK && block_size <= CACHE_MAX_BLOCK &&
+        (block_size & (block_size - 1)) == 0 && associativity > 0 && size > 0 &&
+        size % ((long)block_size * associativity) == 0;
+}
+
+/**
+ * @brief Creates and initializes a cache.
+ */
+Cache* cache_create(int size, int block_size, int associativity, int replacement_policy,int insertion_policy) {
+    Cache *cache = malloc(sizeof(Cache));
+    if (!cache) {
+        fprintf(stderr, "Error: Failed to allocate cache\n");
+        exit(1);
+    }
+    cache->size = size;
+    cache->block_size = block_size;
+    cache->associativity = associativity;
+    cache->replacement_policy = replacement_policy;
+    cache->insertion_policy = insertion_policy;
+    cache->id = cache_next_id++;
+    /* each cache draws from its own generator, seeded from the global one */
+    cache->rand_state = (uint32_t)rand() | 1;
+    cache->latency = 1;
+    cache->inclusion = INCLUSION_NON_INCLUSIVE;
+    cache->next = NULL;
+    cache->num_upper = 0;
+    cache->service_latency = 0;
+    cache->write_policy = WRITE_BACK;
+    cache->write_allocate = 1;
+    cache->wbuf_depth = 0;
+    cache->wbuf_count = 0;
+    cache->wbuf_head = 0;
+    cache->wbuf_addr = NULL;
+    cache->wbuf_done = NULL;
+    cache->num_mshrs = 0;
+    cache->mshr_count = 0;
+    cache->mshr_addr = NULL;
+    cache->mshr_ready = NULL;
+    cache->mshr_busy_until = 0;
+    cache->vc_entries = 0;
+    cache->vc_latency = 0;
+    cache->vc_addr = NULL;
+    cache->vc_dirty = NULL;
+    cache->vc_stamp = NULL;
+    cache->vc_clock = 0;
+    cache->vc_data = NULL;
+    cache->prefetcher = NULL;
+    cache->stack_profile = NULL;
+    cache->miss_class = NULL;
+    cache->set_profile = NULL;
+    cache->indexing = INDEX_MODULO;
+
+    // Validate cache parameters: any whole number of sets, power-of-two blocks
+    if (!cache_valid_geometry(size, block_size, associativity)) {
+        fprintf(stderr, "Error: Invalid cache configuration (%d bytes, %d-byte blocks, %d ways)\n",
+                size, block_size, associativity);
+        exit(1);
+    }
+    cache->num_sets = size / (block_size * associativity);
+    cache->set_mask = (cache->num_sets & (cache->num_sets - 1)) == 0 ? cache->num_sets - 1 : 0;
+
+    /* Calculate bit fields */
+    cache->offset_bits = (int)log2(block_size);
+    cache->index_bits = (int)ceil(log2(cache->num_sets));
+    cache->tag_bits = 32 - cache->index_bits - cache->offset_bits;
+
+    if (replacement_policy == REPLACEMENT_PLRU &&
+            ((associativity & (associativity - 1)) != 0 || associativity > 64)) {
+        fprintf(stderr, "Error: PLRU needs a power-of-two associativity up to 64\n");
+        exit(1);
+    }
+
+    /* Allocate the metadata arena: tags, dirty and prefetch bits, then the
+     * replacement state the policy needs, each region starting on its own
+     * host cache line */
+    cache->tag_stride = (int)cache_round_up(associativity, CACHE_TAG_LANES);
+    size_t rows = (size_t)cache->num_sets * cache->tag_stride;
+    int lru = replacement_policy == REPLACEMENT_LRU || replacement_policy == REPLACEMENT_FIFO;
+    int rrip = replacement_policy >= REPLACEMENT_SRRIP;
+    int ship = replacement_policy == REPLACEMENT_SHIP;
+    size_t tags_bytes = cache_round_up(rows * sizeof(uint32_t), CACHE_ARENA_ALIGN);
+    size_t dirty_bytes = cache_round_up(rows * sizeof(uint8_t), CACHE_ARENA_ALIGN);
+    size_t pf_bytes = cache_round_up(rows * sizeof(uint8_t), CACHE_ARENA_ALIGN);
+    size_t stamp_bytes = lru ? cache_round_up(rows * sizeof(uint32_t), CACHE_ARENA_ALIGN) : 0;
+    size_t plru_bytes = replacement_policy == REPLACEMENT_PLRU ?
+        cache_round_up(cache->num_sets * sizeof(uint64_t), CACHE_ARENA_ALIGN) : 0;
+    size_t rrpv_bytes = rrip ? cache_round_up(rows * sizeof(uint8_t), CACHE_ARENA_ALIGN) : 0;
+    size_t sig_bytes = ship ? cache_round_up(rows * sizeof(uint16_t), CACHE_ARENA_ALIGN) : 0;
+    size_t reuse_bytes = ship ? cache_round_up(rows * sizeof(uint8_t), CACHE_ARENA_ALIGN) : 0;
+    size_t shct_bytes = ship ? cache_round_up(CACHE_SHCT_SIZE, CACHE_ARENA_ALIGN) : 0;
+    size_t arena_bytes = tags_bytes + dirty_bytes + pf_bytes + stamp_bytes + plru_bytes +
+        rrpv_bytes + sig_bytes + reuse_bytes + shct_bytes;
+
+    cache->arena = aligned_alloc(CACHE_ARENA_ALIGN, arena_bytes);
+    if (!cache->arena) {
+        fprintf(stderr, "Error: Failed to allocate cache tag store\n");
+        exit(1);
+    }
+    memset(cache->arena, 0, arena_bytes);
+    char *region = cache->arena;
+    cache->tags = (uint32_t *)region;
+    region += tags_bytes;
+    cache->dirty = (uint8_t *)region;
+    region += dirty_bytes;
+    cache->pf = (uint8_t *)region;
+    region += pf_bytes;
+    cache->stamp = stamp_bytes ? (uint32_t *)region : NULL;
+    region += stamp_bytes;
+    cache->plru = plru_bytes ? (uint64_t *)region : NULL;
+    region += plru_bytes;
+    cache->rrpv = rrpv_bytes ? (uint8_t *)region : NULL;
+    region += rrpv_bytes;
+    cache->sig = sig_bytes ? (uint16_t *)region : NULL;
+    region += sig_bytes;
+    cache->reuse = reuse_bytes ? (uint8_t *)region : NULL;
+    region += reuse_bytes;
+    cache->shct = shct_bytes ? (uint8_t *)region : NULL;
+
+    /* SHiP counters start weakly reused */
+    if (cache->shct)
+        memset(cache->shct, 1, CACHE_SHCT_SIZE);
+
+    /* Allocate the data payload (none in tag-only mode) */
+    cache->data = NULL;
+    if (!cache_tag_only)
+        cache->data = calloc((size_t)cache->num_sets * associativity, block_size);
+    if (!cache->data && !cache_tag_only) {
+        fprintf(stderr, "Error: Failed to allocate cache blocks\n");
+        exit(1);
+    }
+
+    cache->global_lru_counter = 0;
+    cache->psel = 1 << (CACHE_PSEL_BITS - 1);
+    cache->bip_counter = 0;
+    cache->access_pc = 0;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+
+    return cache;
+}
+
+/**
+ * @brief Destroys a cache and frees its memory.
+ */
+void cache_destroy(Cache *cache) {
+    if (!cache) return;
+
+    free(cache->arena);
+    free(cache->data);
+    free(cache->wbuf_addr);
+    free(cache->wbuf_done);
+    free(cache->mshr_addr);
+    free(cache->mshr_ready);
+    free(cache->vc_addr);
+    free(cache->vc_dirty);
+    free(cache->vc_stamp);
+    free(cache->vc_data);
+    prefetch_destroy(cache->prefetcher);
+    stackdist_destroy(cache->stack_profile);
+    missclass_destroy(cache->miss_class);
+    setprof_destroy(cache->set_profile);
+    free(cache);
+}
+
+/**
+ * @brief Finds 'key' in the first 'ways' entries of a tag row.
+ *
+ * Rows are CACHE_TAG_LANES-padded and 32-byte aligned, so the vector paths can
+ * always load whole vectors; lanes at or beyond 'ways' are masked off.
+ * @return the lowest matching way, or -1 if there is none.
+ */
+int cache_match_way(const uint32_t *row, int ways, uint32_t key) {
+#if defined(__AVX2__)
+    __m256i k = _mm256_set1_epi32((int)key);
+    for (int base = 0; base < ways; base += 8) {
+        __m256i t = _mm256_load_si256((const __m256i *)(row + base));
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(t, k)));
+        if (ways - base < 8)
+            mask &= (1u << (ways - base)) - 1;
+        if (mask)
+            return base + __builtin_ctz(mask);
+    }
+    return -1;
+#elif defined(__SSE2__)
+    __m128i k = _mm_set1_epi32((int)key);
+    for (int base = 0; base < ways; base += 4) {
+        __m128i t = _mm_load_si128((const __m128i *)(row + base));
+        unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, k)));
+        if (ways - base < 4)
+            mask &= (1u << (ways - base)) - 1;
+        if (mask)
+            return base + __builtin_ctz(mask);
+    }
+    return -1;
+#else
+    for (int way = 0; way < ways; way++) {
+        if (row[way] == key)
+            return way;
+    }
+    return -1;
+#endif
+}
+
+/**
+ * @brief Set rotation applied to a tag under INDEX_HASH, in [0, num_sets).
+ */
+static inline uint32_t cache_index_skew(Cache *cache, uint32_t tag) {
+    if (cache->indexing != INDEX_HASH || cache->num_sets == 1)
+        return 0;
+    uint32_t h = tag * 0x9E3779B1u;
+    return cache->set_mask ? h >> (32 - cache->index_bits) : h % cache->num_sets;
+}
+
+/**
+ * @brief Returns the tag of an address in this cache.
+ */
+static inline uint32_t cache_addr_tag(Cache *cache, uint32_t addr) {
+    uint32_t block = addr >> cache->offset_bits;
+    return cache->set_mask || cache->num_sets == 1 ? block >> cache->index_bits : block / cache->num_sets;
+}
+
+/**
+ * @brief Splits an address into set index and tag for this cache.
+ */
+static inline void cache_decode(Cache *cache, uint32_t addr, uint32_t *index, uint32_t *tag) {
+    uint32_t block = addr >> cache->offset_bits;
+    *tag = cache_addr_tag(cache, addr);
+    *index = cache->set_mask || cache->num_sets == 1 ? block & cache->set_mask : block - *tag * cache->num_sets;
+    uint32_t skew = cache_index_skew(cache, *tag);
+    if (skew) {
+        *index += skew;
+        if (*index >= (uint32_t)cache->num_sets)
+            *index -= cache->num_sets;
+    }
+}
+
+/**
+ * @brief Counts a dirty block written to the next level, in the set profile
+ * under the set its address maps to.
+ */
+static void cache_count_writeback(Cache *cache, uint32_t addr) {
+    cache->stats.writebacks++;
+    if (cache->set_profile) {
+        uint32_t index, tag;
+        cache_decode(cache, addr, &index, &tag);
+        cache->set_profile->writebacks[index]++;
+    }
+}
+
+/**
+ * @brief Rebuilds the block address held in a given set/way.
+ */
+static inline uint32_t cache_block_addr(Cache *cache, uint32_t index, int way) {
+    uint32_t tag = cache_set_tags(cache, index)[way] & ~CACHE_TAG_VALID;
+    uint32_t skew = cache_index_skew(cache, tag);
+    if (index < skew)
+        index += cache->num_sets;
+    return (tag * cache->num_sets + index - skew) << cache->offset_bits;
+}
+
+/**
+ * @brief Feeds a demand access to every stack distance profile of the cache.
+ * A profile with the cache's set count uses the set the access maps to,
+ * 'index', so that it follows the index function.
+ */
+static void cache_profile_access(Cache *cache, uint32_t addr, uint32_t index) {
+    for (Stack_Profiler *sd = cache->stack_profile; sd; sd = sd->next) {
+        if (sd->num_sets == cache->num_sets)
+            stackdist_access_set(sd, addr, index);
+        else
+            stackdist_access(sd, addr);
+    }
+}
+
+/**
+ * @brief Notes a demand access to the block in a given set/way.
+ *
+ * The first demand access to a prefetched block makes the prefetch useful.
+ * @return cycles the access must still wait for a prefetch in flight.
+ */
+static inline int cache_demand_use(Cache *cache, uint32_t index, int way) {
+    uint8_t *pf = cache_set_pf(cache, index);
+    if (!pf[way] || cache_prefetching || !cache->prefetcher)
+        return 0;
+    pf[way] = 0;
+    return prefetch_demand_use(cache->prefetcher, cache_block_addr(cache, index, way), stat_cycles);
+}
+
+/**
+ * @brief Clears the prefetch bit of a block leaving the cache.
+ */
+static inline void cache_drop_pf(Cache *cache, uint32_t index, int way) {
+    uint8_t *pf = cache_set_pf(cache, index);
+    if (pf[way] && cache->prefetcher)
+        cache->prefetcher->stats.unused++;
+    pf[way] = 0;
+}
+
+static inline void cache_update_eviction(Cache *cache, uint32_t index, int way);
+
+/**
+ * @brief Connects an upper-level cache to the level below it.
+ *
+ * Several upper caches may share one lower level (e.g. split L1s in front of
+ * a unified L2). The lower level keeps back-pointers so that an inclusive
+ * level can invalidate the upper copies of the blocks it evicts.
+ */
+void cache_attach(Cache *upper, Cache *lower) {
+    if (lower->block_size < upper->block_size ||
+            (lower->inclusion == INCLUSION_EXCLUSIVE && lower->block_size != upper->block_size)) {
+        fprintf(stderr, "Error: Invalid cache hierarchy (block size %d below %d)\n",
+                lower->block_size, upper->block_size);
+        exit(1);
+    }
+    if (lower->num_upper >= CACHE_MAX_UPPER) {
+        fprintf(stderr, "Error: Too many caches attached to one level\n");
+        exit(1);
+    }
+    upper->next = lower;
+    lower->upper[lower->num_upper++] = upper;
+}
+
+/*==============================================================================
+ * Victim Cache
+ *============================================================================*/
+
+/**
+ * @brief Gives a cache a victim cache of 'entries' lines (0 = none) that
+ * services a miss in 'latency' cycles.
+ */
+void cache_set_victim_cache(Cache *cache, int entries, int latency) {
+    free(cache->vc_addr);
+    free(cache->vc_dirty);
+    free(cache->vc_stamp);
+    free(cache->vc_data);
+    cache->vc_entries = entries > 0 ? entries : 0;
+    cache->vc_latency = latency;
+    cache->vc_addr = NULL;
+    cache->vc_dirty = NULL;
+    cache->vc_stamp = NULL;
+    cache->vc_data = NULL;
+    if (entries <= 0)
+        return;
+
+    size_t lanes = cache_round_up(entries, CACHE_TAG_LANES);
+    cache->vc_addr = aligned_alloc(CACHE_ARENA_ALIGN, cache_round_up(lanes * sizeof(uint32_t), CACHE_ARENA_ALIGN));
+    cache->vc_dirty = calloc(entries, sizeof(uint8_t));
+    cache->vc_stamp = calloc(entries, sizeof(uint64_t));
+    if (!cache_tag_only)
+        cache->vc_data = calloc(entries + 1, cache->block_size);
+    if (!cache->vc_addr || !cache->vc_dirty || !cache->vc_stamp || (!cache->vc_data && !cache_tag_only)) {
+        fprintf(stderr, "Error: Failed to allocate victim cache\n");
+        exit(1);
+    }
+    memset(cache->vc_addr, 0, lanes * sizeof(uint32_t));
+}
+
+static inline uint32_t *cache_vc_block(Cache *cache, int slot) {
+    if (!cache->vc_data)
+        return NULL;
+    return cache->vc_data + (size_t)slot * (cache->block_size / 4);
+}
+
+/* copies block data, unless either side has none (tag-only mode) */
+static inline void cache_copy(uint32_t *dst, const uint32_t *src, int bytes) {
+    if (dst && src)
+        memcpy(dst, src, bytes);
+}
+
+/**
+ * @brief Looks up the block at 'block_addr' in the victim cache.
+ * @return its entry, or -1.
+ */
+static inline int cache_vc_find(Cache *cache, uint32_t block_addr) {
+    if (cache->vc_entries == 0)
+        return -1;
+    return cache_match_way(cache->vc_addr, cache->vc_entries, block_addr | CACHE_VC_VALID);
+}
+
+/**
+ * @brief Drops the victim cache copy of the block holding 'addr', merging
+ * dirty data into 'data' like cache_invalidate_range().
+ * @return 1 if there was a copy.
+ */
+static int cache_vc_invalidate(Cache *cache, uint32_t addr, uint32_t *data, int *dirty_out) {
+    int slot = cache_vc_find(cache, addr & ~((1 << cache->offset_bits) - 1));
+    if (slot < 0)
+        return 0;
+    if (cache->vc_dirty[slot]) {
+        cache_copy(data, cache_vc_block(cache, slot), cache->block_size);
+        cache_count_writeback(cache, cache->vc_addr[slot] & ~CACHE_VC_VALID);
+        cache->stats.vc_writebacks++;
+        *dirty_out = 1;
+    }
+    cache->vc_addr[slot] = 0;
+    cache->vc_dirty[slot] = 0;
+    return 1;
+}
+
+/**
+ * @brief Drops every block of 'cache' inside [addr, addr + size).
+ *
+ * Used for back-invalidation by an inclusive lower level. Dirty data is merged
+ * into 'data' (the lower level's copy of the range) and flagged in '*dirty'
+ * so it is not lost.
+ * @return number of blocks invalidated.
+ */
+static int cache_invalidate_range(Cache *cache, uint32_t addr, int size, uint32_t *data, int *dirty_out) {
+    int count = 0;
+
+    for (int off = 0; off < size; off += cache->block_size) {
+        uint32_t index, tag;
+        cache_decode(cache, addr + off, &index, &tag);
+        uint32_t *tags = cache_set_tags(cache, index);
+        int way = cache_match_way(tags, cache->associativity, tag | CACHE_TAG_VALID);
+        uint32_t *block = data ? data + off / 4 : NULL;
+        if (way == -1) {
+            count += cache_vc_invalidate(cache, addr + off, block, dirty_out);
+            continue;
+        }
+
+        /* a block may in turn be cached above this level */
+        uint8_t *dirty = cache_set_dirty(cache, index);
+        int upper_dirty = 0;
+        for (int i = 0; i < cache->num_upper; i++)
+            cache_invalidate_range(cache->upper[i], addr + off, cache->block_size,
+                    cache_block_data(cache, index, way), &upper_dirty);
+
+        if (dirty[way] || upper_dirty) {
+            cache_copy(block, cache_block_data(cache, index, way), cache->block_size);
+            cache_count_writeback(cache, addr + off);
+            *dirty_out = 1;
+        }
+        cache_drop_pf(cache, index, way);
+        cache_update_eviction(cache, index, way);
+        tags[way] = 0;
+        dirty[way] = 0;
+        count++;
+    }
+    return count;
+}
+
+static int cache_evict(Cache *cache, uint32_t index, int way);
+static void cache_insert(Cache *cache, uint32_t index, int way, int demand);
+static int cache_fill(Cache *cache, uint32_t index, int way, uint32_t tag, uint32_t block_addr, int *stall);
+
+/**
+ * @brief Gives a cache a write buffer of the given depth (0 = none).
+ *
+ * Without a buffer, writes sent to the next level are free, as before. With
+ * one, each write occupies an entry until it has drained to the next level,
+ * and a write that finds the buffer full stalls until the oldest entry
+ * drains. Writes to a block that is already queued are merged.
+ */
+void cache_set_write_buffer(Cache *cache, int depth) {
+    free(cache->wbuf_addr);
+    free(cache->wbuf_done);
+    cache->wbuf_depth = depth;
+    cache->wbuf_count = 0;
+    cache->wbuf_head = 0;
+    cache->wbuf_addr = NULL;
+    cache->wbuf_done = NULL;
+    if (depth <= 0)
+        return;
+
+    cache->wbuf_addr = malloc(depth * sizeof(uint32_t));
+    cache->wbuf_done = malloc(depth * sizeof(uint64_t));
+    if (!cache->wbuf_addr || !cache->wbuf_done) {
+        fprintf(stderr, "Error: Failed to allocate write buffer\n");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Queues a write of the block at 'block_addr' to the next level.
+ * @return cycles the writer must stall because the buffer was full.
+ */
+static int cache_wbuf_push(Cache *cache, uint32_t block_addr) {
+    if (cache->wbuf_depth <= 0)
+        return 0;
+
+    uint64_t now = stat_cycles;
+    int drain_latency = cache->next ? cache->next->latency : cache_mem_latency;
+    int stall = 0;
+    cache->stats.wbuf_writes++;
+
+    /* retire entries that have finished draining */
+    while (cache->wbuf_count > 0 && cache->wbuf_done[cache->wbuf_head] <= now) {
+        cache->wbuf_head = (cache->wbuf_head + 1) % cache->wbuf_depth;
+        cache->wbuf_count--;
+    }
+
+    /* coalesce with a pending write to the same block */
+    for (int i = 0; i < cache->wbuf_count; i++) {
+        if (cache->wbuf_addr[(cache->wbuf_head + i) % cache->wbuf_depth] == block_addr) {
+            cache->stats.wbuf_merges++;
+            return 0;
+        }
+    }
+
+    /* full: wait for the oldest entry */
+    if (cache->wbuf_count == cache->wbuf_depth) {
+        stall = (int)(cache->wbuf_done[cache->wbuf_head] - now);
+        now += stall;
+        cache->wbuf_head = (cache->wbuf_head + 1) % cache->wbuf_depth;
+        cache->wbuf_count--;
+        cache->stats.wbuf_stall_cycles += stall;
+    }
+
+    /* entries drain one at a time, in order */
+    uint64_t start = now;
+    if (cache->wbuf_count > 0) {
+        uint64_t last = cache->wbuf_done[(cache->wbuf_head + cache->wbuf_count - 1) % cache->wbuf_depth];
+        if (last > start)
+            start = last;
+    }
+    int slot = (cache->wbuf_head + cache->wbuf_count) % cache->wbuf_depth;
+    cache->wbuf_addr[slot] = block_addr;
+    cache->wbuf_done[slot] = start + drain_latency;
+    cache->wbuf_count++;
+    cache->stats.wbuf_drains++;
+    return stall;
+}
+
+/**
+ * @brief Writes 'words' words at 'addr' into 'cache' on behalf of the level above.
+ *
+ * Handles both whole-block writebacks and write-through words. A NULL cache
+ * is main memory. Follows this level's write policy: a write-back level keeps
+ * the data dirty, a write-through level passes it on, and a miss either
+ * allocates (fetching the rest of the block) or writes around. Exclusive
+ * levels only ever receive blocks through victim insertion, so they never
+ * allocate here.
+ * @return write buffer stall cycles at this level and the ones below it.
+ */
+static int cache_write_range(Cache *cache, uint32_t addr, const uint32_t *data, int words) {
+    if (!cache) {
+        /* in tag-only mode memory already has the data */
+        for (int i = 0; i < words && data && !cache_tag_only; i++)
+            mem_write_32(addr + i * 4, data[i]);
+        return 0;
+    }
+    cache->stats.write_requests++;
+
+    uint32_t index, tag;
+    cache_decode(cache, addr, &index, &tag);
+    uint32_t *tags = cache_set_tags(cache, index);
+    int way = cache_match_way(tags, cache->associativity, tag | CACHE_TAG_VALID);
+    int stall = 0;
+
+    if (way == -1) {
+        cache->stats.write_misses++;
+        uint32_t block_addr = addr & ~((1 << cache->offset_bits) - 1);
+        int slot = cache_vc_find(cache, block_addr);
+        if (slot >= 0) {
+            /* update the victim cache copy in place */
+            if (cache->vc_data)
+                cache_copy(cache_vc_block(cache, slot) + (addr - block_addr) / 4, data, words * sizeof(uint32_t));
+            if (cache->write_policy == WRITE_BACK) {
+                cache->vc_dirty[slot] = 1;
+                return 0;
+            }
+            return cache_write_range(cache->next, addr, data, words);
+        }
+        if (!cache->write_allocate || cache->inclusion == INCLUSION_EXCLUSIVE)
+            return cache_write_range(cache->next, addr, data, words);
+        way = cache_find_replacement_way(cache, index);
+        cache_fill(cache, index, way, tag, block_addr, &stall);
+        cache_update_insertion(cache, index, way);
+    }
+
+    uint32_t word = (addr & ((1 << cache->offset_bits) - 1)) / 4;
+    if (cache->data)
+        cache_copy(cache_block_data(cache, index, way) + word, data, words * sizeof(uint32_t));
+    if (cache->write_policy == WRITE_BACK) {
+        cache_set_dirty(cache, index)[way] = 1;
+    } else {
+        stall += cache_write_range(cache->next, addr, data, words);
+        stall += cache_wbuf_push(cache, addr & ~((1 << cache->offset_bits) - 1));
+    }
+    return stall;
+}
+
+/**
+ * @brief Sends one word written in this cache through to the next level.
+ * @return write buffer stall cycles.
+ */
+static int cache_write_through(Cache *cache, uint32_t addr, uint32_t value) {
+    int stall = cache_write_range(cache->next, addr, &value, 1);
+    return stall + cache_wbuf_push(cache, addr & ~((1 << cache->offset_bits) - 1));
+}
+
+/**
+ * @brief Writes every dirty block back to the next level and clears it.
+ *
+ * Flush upper levels before the levels below them so that dirty data reaches
+ * memory.
+ */
+void cache_flush(Cache *cache) {
+    if (!cache) return;
+
+    for (uint32_t index = 0; index < (uint32_t)cache->num_sets; index++) {
+        uint32_t *tags = cache_set_tags(cache, index);
+        uint8_t *dirty = cache_set_dirty(cache, index);
+        for (int way = 0; way < cache->associativity; way++) {
+            if (!(tags[way] & CACHE_TAG_VALID) || !dirty[way])
+                continue;
+            TRACE(CACHE_WRITEBACK, cache->id, index, way, tags[way] & ~CACHE_TAG_VALID);
+            uint32_t addr = cache_block_addr(cache, index, way);
+            cache_write_range(cache->next, addr, cache_block_data(cache, index, way), cache->block_size / 4);
+            cache_count_writeback(cache, addr);
+            dirty[way] = 0;
+        }
+    }
+    for (int slot = 0; slot < cache->vc_entries; slot++) {
+        if (!cache->vc_addr[slot] || !cache->vc_dirty[slot])
+            continue;
+        uint32_t addr = cache->vc_addr[slot] & ~CACHE_VC_VALID;
+        cache_write_range(cache->next, addr, cache_vc_block(cache, slot), cache->block_size / 4);
+        cache_count_writeback(cache, addr);
+        cache->stats.vc_writebacks++;
+        cache->vc_dirty[slot] = 0;
+    }
+    /* anything still queued is drained as part of the flush */
+    cache->wbuf_count = 0;
+    cache->wbuf_head = 0;
+}
+
+/* forgets the writes and misses in flight, timed against a clock that a
+ * functional fast-forward has since left behind */
+static void cache_drop_in_flight(Cache *cache) {
+    cache->wbuf_count = 0;
+    cache->wbuf_head = 0;
+    cache->mshr_count = 0;
+    cache->mshr_busy_until = 0;
+}
+
+/**
+ * @brief Drops every block, leaving the cache cold.
+ *
+ * Dirty data is lost: flush the hierarchy first.
+ */
+void cache_invalidate(Cache *cache) {
+    if (!cache) return;
+
+    size_t blocks = (size_t)cache->num_sets * cache->tag_stride;
+    memset(cache->tags, 0, blocks * sizeof(uint32_t));
+    memset(cache->dirty, 0, blocks);
+    memset(cache->pf, 0, blocks);
+    if (cache->vc_entries > 0) {
+        memset(cache->vc_addr, 0, cache->vc_entries * sizeof(uint32_t));
+        memset(cache->vc_dirty, 0, cache->vc_entries);
+    }
+    cache_drop_in_flight(cache);
+}
+
+/* what a functional warm-up sets aside until it ends */
+struct Cache_Warmup {
+    Cache_Stats stats;
+    Prefetch_Stats prefetch_stats;
+    Stack_Profiler *stack_profile;
+    Miss_Classifier *miss_class;
+    Set_Profile *set_profile;
+};
+
+/**
+ * @brief Starts a functional warm-up of 'cache': saves its statistics
+ * counters and those of its prefetcher, and suspends its profilers, so that
+ * warming is not measured.
+ * @return the saved state, for cache_end_warmup() (NULL for a NULL cache).
+ */
+Cache_Warmup *cache_begin_warmup(Cache *cache) {
+    if (!cache) return NULL;
+
+    Cache_Warmup *w = malloc(sizeof(Cache_Warmup));
+    if (!w) {
+        fprintf(stderr, "Error: Failed to allocate cache state\n");
+        exit(1);
+    }
+    w->stats = cache->stats;
+    if (cache->prefetcher)
+        w->prefetch_stats = cache->prefetcher->stats;
+    w->stack_profile = cache->stack_profile;
+    w->miss_class = cache->miss_class;
+    w->set_profile = cache->set_profile;
+    cache->stack_profile = NULL;
+    cache->miss_class = NULL;
+    cache->set_profile = NULL;
+    return w;
+}
+
+/**
+ * @brief Ends a functional warm-up: puts back the counters and profilers
+ * that cache_begin_warmup() saved, and forgets the writes and misses still
+ * in flight.
+ */
+void cache_end_warmup(Cache *cache, Cache_Warmup *w) {
+    if (!cache) return;
+
+    cache->stats = w->stats;
+    if (cache->prefetcher)
+        cache->prefetcher->stats = w->prefetch_stats;
+    cache->stack_profile = w->stack_profile;
+    cache->miss_class = w->miss_class;
+    cache->set_profile = w->set_profile;
+    free(w);
+    cache_drop_in_flight(cache);
+}
+
+static int cache_insert_victim(Cache *cache, uint32_t addr, const uint32_t *data, int dirty);
+
+/**
+ * @brief Whether a victim leaving this cache is written back, as opposed to
+ * dropped (clean) or handed to an exclusive level below.
+ */
+static inline int cache_victim_writeback(Cache *cache, int dirty) {
+    return dirty && !(cache->next && cache->next->inclusion == INCLUSION_EXCLUSIVE);
+}
+
+/**
+ * @brief Passes a block leaving this cache on to the level below: an
+ * exclusive level takes it clean or dirty, otherwise only dirty data is
+ * written back. The caller traces the writeback, it knows where the block was.
+ * @return write buffer stall cycles caused by the writeback.
+ */
+static int cache_send_victim(Cache *cache, uint32_t addr, const uint32_t *block, int dirty) {
+    if (cache->next && cache->next->inclusion == INCLUSION_EXCLUSIVE) {
+        /* exclusive level below holds our victims, clean or dirty */
+        return cache_insert_victim(cache->next, addr, block, dirty);
+    }
+    if (!dirty)
+        return 0;
+    /* Write back dirty block */
+    int stall = cache_write_range(cache->next, addr, block, cache->block_size / 4);
+    cache_count_writeback(cache, addr);
+    return stall + cache_wbuf_push(cache, addr);
+}
+
+/**
+ * @brief Places a block evicted from the main array in the victim cache,
+ * displacing its least recently used entry to the level below.
+ * @return write buffer stall cycles caused by that.
+ */
+static int cache_vc_insert(Cache *cache, uint32_t addr, const uint32_t *block, int dirty) {
+    int slot = cache_match_way(cache->vc_addr, cache->vc_entries, 0);
+    int stall = 0;
+
+    if (slot < 0) {
+        slot = 0;
+        for (int i = 1; i < cache->vc_entries; i++) {
+            if (cache->vc_stamp[i] < cache->vc_stamp[slot])
+                slot = i;
+        }
+        uint32_t victim_addr = cache->vc_addr[slot] & ~CACHE_VC_VALID;
+        if (cache_victim_writeback(cache, cache->vc_dirty[slot])) {
+            TRACE(CACHE_WRITEBACK, cache->id, 0, cache->associativity + slot, cache_addr_tag(cache, victim_addr));
+            cache->stats.vc_writebacks++;
+        }
+        stall = cache_send_victim(cache, victim_addr, cache_vc_block(cache, slot), cache->vc_dirty[slot]);
+    }
+    cache->vc_addr[slot] = addr | CACHE_VC_VALID;
+    cache->vc_dirty[slot] = (uint8_t)dirty;
+    cache->vc_stamp[slot] = ++cache->vc_clock;
+    cache_copy(cache_vc_block(cache, slot), block, cache->block_size);
+    return stall;
+}
+
+/**
+ * @brief Evicts the block in the given set/way, if any.
+ *
+ * Enforces inclusion (back-invalidating upper copies when this level is
+ * inclusive), then moves the victim into the victim cache if there is one,
+ * or else passes it on to the level below.
+ * @return write buffer stall cycles caused by the writeback.
+ */
+static int cache_evict(Cache *cache, uint32_t index, int way) {
+    uint32_t *tags = cache_set_tags(cache, index);
+    uint8_t *dirty = cache_set_dirty(cache, index);
+    int stall;
+    if (!(tags[way] & CACHE_TAG_VALID))
+        return 0;
+
+    TRACE(CACHE_EVICT, cache->id, index, way, cache->replacement_policy);
+    uint32_t victim_addr = cache_block_addr(cache, index, way);
+    uint32_t *block = cache_block_data(cache, index, way);
+
+    if (cache->inclusion == INCLUSION_INCLUSIVE) {
+        int upper_dirty = 0;
+        for (int i = 0; i < cache->num_upper; i++)
+            cache->stats.back_invalidations += cache_invalidate_range(cache->upper[i], victim_addr,
+                    cache->block_size, block, &upper_dirty);
+        if (upper_dirty)
+            dirty[way] = 1;
+    }
+
+    if (cache->set_profile)
+        cache->set_profile->evictions[index]++;
+
+    if (cache->vc_entries > 0)
+        stall = cache_vc_insert(cache, victim_addr, block, dirty[way]);
+    else {
+        if (cache_victim_writeback(cache, dirty[way]))
+            TRACE(CACHE_WRITEBACK, cache->id, index, way, tags[way] & ~CACHE_TAG_VALID);
+        stall = cache_send_victim(cache, victim_addr, block, dirty[way]);
+    }
+
+    cache_drop_pf(cache, index, way);
+    cache_update_eviction(cache, index, way);
+    tags[way] = 0;
+    dirty[way] = 0;
+    return stall;
+}
+
+/**
+ * @brief Replaces the block in the given set/way with the block at 'block_addr'.
+ *
+ * The block comes from the victim cache when it holds it (swapping places
+ * with the block it replaces), and otherwise from the next level.
+ * @return latency of whatever supplied the block; write buffer stall cycles
+ * caused by the eviction are returned in '*stall'.
+ */
+static int cache_fill(Cache *cache, uint32_t index, int way, uint32_t tag, uint32_t block_addr, int *stall) {
+    uint32_t *tags = cache_set_tags(cache, index);
+    uint8_t *dirty = cache_set_dirty(cache, index);
+    int slot = cache_vc_find(cache, block_addr);
+
+    if (slot >= 0) {
+        /* take the block out first, so that the victim lands in its entry */
+        uint32_t *swap = cache_vc_block(cache, cache->vc_entries);
+        int vc_dirty = cache->vc_dirty[slot];
+        cache_copy(swap, cache_vc_block(cache, slot), cache->block_size);
+        cache->vc_addr[slot] = 0;
+        if (!cache_prefetching) {
+            cache->stats.vc_hits++;
+            if (tags[way] & CACHE_TAG_VALID)
+                cache->stats.vc_swaps++;
+        }
+
+        *stall = cache_evict(cache, index, way);
+        tags[way] = tag | CACHE_TAG_VALID;
+        dirty[way] = (uint8_t)vc_dirty;
+        cache_copy(cache_block_data(cache, index, way), swap, cache->block_size);
+        return cache->vc_latency;
+    }
+
+    *stall = cache_evict(cache, index, way);
+    tags[way] = tag | CACHE_TAG_VALID;
+    dirty[way] = 0;
+    return cache_load_block(cache, way, index, block_addr);
+}
+
+/**
+ * @brief Installs a block evicted from the level above into an exclusive cache.
+ * @return write buffer stall cycles caused by the block it displaces.
+ */
+static int cache_insert_victim(Cache *cache, uint32_t addr, const uint32_t *data, int dirty) {
+    uint32_t index, tag;
+    cache_decode(cache, addr, &index, &tag);
+    uint32_t *tags = cache_set_tags(cache, index);
+    int stall = 0;
+
+    int way = cache_match_way(tags, cache->associativity, tag | CACHE_TAG_VALID);
+    if (way == -1) {
+        way = cache_find_replacement_way(cache, index);
+        stall = cache_evict(cache, index, way);
+        tags[way] = tag | CACHE_TAG_VALID;
+        cache_insert(cache, index, way, 0);
+    }
+    cache_copy(cache_block_data(cache, index, way), data, cache->block_size);
+    cache_set_dirty(cache, index)[way] |= dirty;
+    return stall;
+}
+
+/**
+ * @brief Reads part of a block from 'cache' on behalf of the level above it.
+ *
+ * Copies 'words' words starting at 'addr' into 'out', filling this level on a
+ * miss according to its inclusion policy. A NULL cache is main memory. An
+ * exclusive level gives up its copy, reporting through 'dirty_out' whether
+ * the block it handed over was dirty.
+ * @return latency of the level that serviced the request, plus the write
+ * buffer stall of any writeback the fill caused on the way.
+ */
+static int cache_read_block(Cache *cache, uint32_t addr, uint32_t *out, int words, int *dirty_out) {
+    if (!cache) {
+        for (int i = 0; i < words && out; i++)
+            out[i] = mem_read_32(addr + i * 4);
+        return cache_mem_latency;
+    }
+    if (cache_prefetching)
+        cache->stats.prefetch_requests++;
+    else
+        cache->stats.accesses++;
+
+    uint32_t index, tag;
+    cache_decode(cache, addr, &index, &tag);
+    if (cache->stack_profile && !cache_prefetching)
+        cache_profile_access(cache, addr, index);
+    uint32_t *tags = cache_set_tags(cache, index);
+    int way = cache_match_way(tags, cache->associativity, tag | CACHE_TAG_VALID);
+    int latency;
+    if (cache->miss_class && !cache_prefetching)
+        missclass_access(cache->miss_class, addr, way == -1);
+    if (cache->set_profile && !cache_prefetching)
+        setprof_access(cache->set_profile, index, way == -1);
+
+    if (way != -1) {
+        if (!cache_prefetching)
+            cache->stats.hits++;
+        cache_update_hit(cache, index, way);
+        latency = cache->latency + cache_demand_use(cache, index, way);
+    } else {
+        if (!cache_prefetching)
+            cache->stats.misses++;
+
+        /* an exclusive level does not allocate on demand misses */
+        if (cache->inclusion == INCLUSION_EXCLUSIVE) {
+            uint32_t block_addr = addr & ~((1 << cache->offset_bits) - 1);
+            int slot = cache_vc_find(cache, block_addr);
+            if (slot < 0)
+                return cache_read_block(cache->next, addr, out, words, dirty_out);
+            /* hand the victim cache copy over instead */
+            if (cache->vc_data)
+                cache_copy(out, cache_vc_block(cache, slot) + (addr - block_addr) / 4, words * sizeof(uint32_t));
+            *dirty_out |= cache->vc_dirty[slot];
+            cache->vc_addr[slot] = 0;
+            cache->vc_dirty[slot] = 0;
+            if (!cache_prefetching)
+                cache->stats.vc_hits++;
+            return cache->vc_latency;
+        }
+
+        int stall;
+        way = cache_find_replacement_way(cache, index);
+        TRACE(CACHE_MISS, cache->id, addr, index, way);
+        latency = cache_fill(cache, index, way, tag, addr & ~((1 << cache->offset_bits) - 1), &stall);
+        latency += stall;
+        cache_insert(cache, index, way, !cache_prefetching);
+    }
+
+    uint32_t word = (addr & ((1 << cache->offset_bits) - 1)) / 4;
+    if (cache->data)
+        cache_copy(out, cache_block_data(cache, index, way) + word, words * sizeof(uint32_t));
+
+    if (cache->inclusion == INCLUSION_EXCLUSIVE) {
+        /* the block moves up: it now lives only in the level above */
+        *dirty_out |= cache_set_dirty(cache, index)[way];
+        cache_drop_pf(cache, index, way);
+        cache_update_eviction(cache, index, way);
+        tags[way] = 0;
+        cache_set_dirty(cache, index)[way] = 0;
+    }
+    return latency;
+}
+
+/**
+ * @brief Helper function to load a block from the next level into the cache.
+ * @return latency of the level that supplied the block.
+ */
+int cache_load_block(Cache *cache, int way, uint32_t index, uint32_t block_addr) {
+    uint32_t *block = cache_block_data(cache, index, way);
+    int dirty = 0;
+
+    if (cache->next)
+        cache->next->access_pc = cache->access_pc;
+    int latency = cache_read_block(cache->next, block_addr, block, cache->block_size / 4, &dirty);
+    if (dirty)
+        cache_set_dirty(cache, index)[way] = 1;
+    return latency;
+}
+
+/**
+ * @brief Accesses the cache for a read or write operation.
+ *
+ * cache->service_latency is set to the cycles the access costs beyond a hit:
+ * on a miss, the latency of the level of the hierarchy (or memory) that
+ * supplied the block, plus any write buffer stall. A write miss in a
+ * no-write-allocate cache completes without filling, costing only its write
+ * buffer stall. A hit on a block whose prefetch is still in flight costs the
+ * cycles until it arrives.
+ * @return 1 on hit, 0 on miss.
+ */
+int cache_access(Cache *cache, uint32_t addr, uint32_t *data, int is_write, uint32_t write_data) {
+    if (!cache) {
+        fprintf(stderr, "Error: Cache is NULL\n");
+        return 0;
+    }
+    cache->service_latency = 0;
+
+    /* tag-only: backing memory serves the access, the cache only tracks it */
+    if (cache_tag_only) {
+        if (is_write)
+            mem_write_32(addr, write_data);
+        else
+            *data = mem_read_32(addr);
+    }
+
+    /* Extract address components */
+    uint32_t offset = addr & ((1 << cache->offset_bits) - 1);
+    uint32_t index, tag;
+    cache_decode(cache, addr, &index, &tag);
+
+    /* Validate index bounds */
+    if (index >= (uint32_t)cache->num_sets) {
+        fprintf(stderr, "Error: Cache index out of bounds\n");
+        return 0;
+    }
+    /* Search for the block in the set: one vector compare per tag row chunk */
+    uint32_t *tags = cache_set_tags(cache, index);
+    int hit_way = cache_match_way(tags, cache->associativity, tag | CACHE_TAG_VALID);
+    int merged = cache == cache_merging && hit_way != -1;
+    if (!merged) {
+        cache->stats.accesses++;
+        if (cache->stack_profile)
+            cache_profile_access(cache, addr, index);
+        if (cache->miss_class)
+            missclass_access(cache->miss_class, addr, hit_way == -1);
+        if (cache->set_profile)
+            setprof_access(cache->set_profile, index, hit_way == -1);
+    }
+
+    /* Calculate word offset within the block */
+    uint32_t word_offset = offset / 4;
+
+    if (hit_way != -1) {
+        /* Cache hit */
+        if (!merged)
+            cache->stats.hits++;
+
+        /* Update replacement state (FIFO and random do not change at hits) */
+        cache_update_hit(cache, index, hit_way);
+        cache->service_latency = cache_demand_use(cache, index, hit_way);
+        if (word_offset >= (uint32_t)cache->block_size / 4) {
+            fprintf(stderr, "Error: Word offset out of bounds\n");
+            return 0;
+        }
+        uint32_t *block = cache_block_data(cache, index, hit_way);
+        if (is_write) {
+            /* Write hit */
+            if (block)
+                block[word_offset] = write_data;
+            if (cache->write_policy == WRITE_BACK)
+                cache_set_dirty(cache, index)[hit_way] = 1;
+            else
+                cache->service_latency += cache_write_through(cache, addr, write_data);
+        } else {
+            /* Read hit */
+            if (block)
+                *data = block[word_offset];
+        }
+
+        return 1; /* Hit */
+    } else {
+        /* Cache miss */
+        cache->stats.misses++;
+
+        uint32_t block_addr = addr & ~((1 << cache->offset_bits) - 1);
+
+        /* No-write-allocate: the store goes around the cache (unless the
+         * victim cache holds the block, which is then swapped back in) */
+        if (is_write && !cache->write_allocate && cache_vc_find(cache, block_addr) < 0) {
+            cache->service_latency = cache_write_through(cache, addr, write_data);
+            return 0;
+        }
+
+        /* Find replacement way */
+        int replace_way = cache_find_replacement_way(cache, index);
+        uint8_t *dirty = cache_set_dirty(cache, index);
+
+        TRACE(CACHE_MISS, cache->id, addr, index, replace_way);
+
+        /* Evict, update block metadata, then load the new block from the
+         * victim cache or the next level */
+        int wb_stall;
+        cache->service_latency = cache_fill(cache, index, replace_way, tag, block_addr, &wb_stall) + wb_stall;
+
+        /* Apply insertion policy */
+        cache_update_insertion(cache, index, replace_way);
+
+        uint32_t *block = cache_block_data(cache, index, replace_way);
+        if (is_write) {
+            /* Write miss */
+            if (block)
+                block[word_offset] = write_data;
+            if (cache->write_policy == WRITE_BACK)
+                dirty[replace_way] = 1;
+            else
+                cache->service_latency += cache_write_through(cache, addr, write_data);
+        } else {
+            /* Read miss */
+            if (block)
+                *data = block[word_offset];
+        }
+
+        return 0; /* Miss */
+    }
+}
+
+/*==============================================================================
+ * Replacement Policies
+ *
+ * Each policy keeps only the per-set state it needs (see cache.h). Invalid
+ * ways are always filled first. cache_update_hit() is the hit hook and
+ * cache_update_insertion() the insertion hook; the set-dueling policies (DIP
+ * and DRRIP) train their selector in the latter, since every demand insertion
+ * into a leader set follows a miss in it.
+ *============================================================================*/
+
+/**
+ * @brief Returns the next LRU/FIFO timestamp.
+ *
+ * When the 32-bit counter is about to wrap, every set's stamps are renumbered
+ * to their rank within the set (keeping 0, the LRU-insertion stamp, as is) so
+ * that the order survives long runs.
+ */
+static uint32_t cache_next_stamp(Cache *cache) {
+    if (cache->global_lru_counter == UINT32_MAX) {
+        int ways = cache->associativity;
+        uint32_t *rank = malloc(ways * sizeof(uint32_t));
+        if (!rank) {
+            fprintf(stderr, "Error: Failed to allocate LRU renumbering buffer\n");
+            exit(1);
+        }
+        for (uint32_t index = 0; index < (uint32_t)cache->num_sets; index++) {
+            uint32_t *stamp = cache_set_stamp(cache, index);
+            for (int i = 0; i < ways; i++) {
+                rank[i] = 0;
+                if (stamp[i] == 0)
+                    continue;
+                rank[i] = 1;
+                for (int j = 0; j < ways; j++)
+                    rank[i] += stamp[j] != 0 && stamp[j] < stamp[i];
+            }
+            memcpy(stamp, rank, ways * sizeof(uint32_t));
+        }
+        free(rank);
+        cache->global_lru_counter = cache->associativity;
+    }
+    return ++cache->global_lru_counter;
+}
+
+/**
+ * @brief Points every node on the PLRU tree path of 'way' away from it.
+ */
+static inline void cache_plru_touch(Cache *cache, uint32_t index, int way) {
+    uint64_t bits = cache->plru[index];
+    for (int node = way + cache->associativity; node > 1; node >>= 1) {
+        int parent = node >> 1;
+        if (node & 1)
+            bits &= ~(1ull << parent);   /* we are the right child: point left */
+        else
+            bits |= 1ull << parent;      /* left child: point right */
+    }
+    cache->plru[index] = bits;
+}
+
+/**
+ * @brief Returns the set-dueling role of a set: 1 if it is a leader for the
+ * first policy (MRU insertion, SRRIP), 2 for the second (BIP, BRRIP), 0 for
+ * a follower.
+ */
+static inline int cache_duel_role(Cache *cache, uint32_t index) {
+    /* small caches get fewer leaders, so that most sets still follow */
+    uint32_t sets = (uint32_t)cache->num_sets;
+    uint32_t leaders = sets / 8 < CACHE_DUEL_LEADERS ? sets / 8 : CACHE_DUEL_LEADERS;
+    uint32_t period = leaders > 0 ? sets / leaders : sets;
+    if (period < 2)
+        return 0;
+    uint32_t k = index % period;
+    return k == 0 ? 1 : k == period / 2 ? 2 : 0;
+}
+
+/**
+ * @brief Decides between two competing insertion policies for a set.
+ * @return 1 to use the second (bimodal) policy, 0 for the first.
+ */
+static int cache_duel(Cache *cache, uint32_t index, int demand) {
+    int psel_max = (1 << CACHE_PSEL_BITS) - 1;
+
+    switch (cache_duel_role(cache, index)) {
+        case 1:
+            /* a demand miss in a leader of the first policy counts against it */
+            if (demand && cache->psel < psel_max)
+                cache->psel++;
+            return 0;
+        case 2:
+            if (demand && cache->psel > 0)
+                cache->psel--;
+            return 1;
+        default:
+            return cache->psel >= (1 << (CACHE_PSEL_BITS - 1));
+    }
+}
+
+/**
+ * @brief Bimodal throttle: true once every CACHE_BIP_EPSILON calls.
+ *
+ * Deterministic, so that it does not disturb the random replacement stream.
+ */
+static inline int cache_bimodal(Cache *cache) {
+    return ++cache->bip_counter % CACHE_BIP_EPSILON == 0;
+}
+
+/**
+ * @brief Hashes the SHiP signature of the access in progress: its PC when
+ * known, else the 16KB memory region of the block.
+ */
+static inline uint32_t cache_ship_signature(Cache *cache, uint32_t index, int way) {
+    uint32_t key = cache->access_pc ? cache->access_pc >> 2 : cache_block_addr(cache, index, way) >> 14;
+    return (key ^ (key >> 12)) & (CACHE_SHCT_SIZE - 1);
+}
+
+/**
+ * @brief Finds the way to replace using the LRU policy.
+ */
+int cache_find_lru_way(Cache *cache, uint32_t index) {
+    uint32_t *stamp = cache_set_stamp(cache, index);
+    int replace_way = 0;
+    uint32_t min_lru = stamp[0];
+
+    /* First, look for invalid way */
+    int way = cache_match_way(cache_set_tags(cache, index), cache->associativity, 0);
+    if (way != -1) {
+        return way;
+    }
+
+    /* If no invalid way, find LRU */
+    for (int way = 1; way < cache->associativity; way++) {
+        if (stamp[way] < min_lru) {
+            min_lru = stamp[way];
+            replace_way = way;
+        }
+    }
+
+    return replace_way;
+}
+
+/**
+ * @brief Finds the way to replace using the FIFO policy.
+ */
+int cache_find_fifo_way(Cache *cache, uint32_t index) {
+    uint32_t *stamp = cache_set_stamp(cache, index);
+    int replace_way = 0;
+    uint32_t min_timestamp = stamp[0]; // For FIFO, this represents insertion time
+
+    // First, look for invalid way
+    int way = cache_match_way(cache_set_tags(cache, index), cache->associativity, 0);
+    if (way != -1) {
+        return way;
+    }
+    // If no invalid way, find the way with the smallest insertion timestamp
+    // (oldest insertion = first to be replaced in FIFO)
+    for (int way = 1; way < cache->associativity; way++) {
+        if (stamp[way] < min_timestamp) {
+            min_timestamp = stamp[way];
+            replace_way = way;
+        }
+    }
+
+    return replace_way;
+}
+
+/**
+ * @brief Finds the way to replace using the Random policy.
+ */
+int cache_find_random_way(Cache *cache, uint32_t index) {
+    // First, look for invalid way
+    int way = cache_match_way(cache_set_tags(cache, index), cache->associativity, 0);
+    if (way != -1) {
+        return way;
+    }
+    // If no invalid way, choose random way
+    uint32_t x = cache->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    cache->rand_state = x;
+    return x % cache->associativity;
+}
+
+/**
+ * @brief Finds the way to replace using tree pseudo-LRU: follow the tree bits
+ * from the root.
+ */
+int cache_find_plru_way(Cache *cache, uint32_t index) {
+    int way = cache_match_way(cache_set_tags(cache, index), cache->associativity, 0);
+    if (way != -1)
+        return way;
+
+    uint64_t bits = cache->plru[index];
+    int node = 1;
+    while (node < cache->associativity)
+        node = 2 * node + (int)((bits >> node) & 1);
+    return node - cache->associativity;
+}
+
+/**
+ * @brief Finds the way to replace using RRIP: the first way predicted to be
+ * re-referenced in the distant future, ageing the whole set until there is one.
+ */
+int cache_find_rrip_way(Cache *cache, uint32_t index) {
+    int way = cache_match_way(cache_set_tags(cache, index), cache->associativity, 0);
+    if (way != -1)
+        return way;
+
+    uint8_t *rrpv = cache_set_rrpv(cache, index);
+    int oldest = 0;
+    for (way = 0; way < cache->associativity; way++) {
+        if (rrpv[way] == CACHE_RRPV_MAX)
+            return way;
+        if (rrpv[way] > rrpv[oldest])
+            oldest = way;
+    }
+    /* age everyone at once by what the oldest way still lacks */
+    int age = CACHE_RRPV_MAX - rrpv[oldest];
+    for (way = 0; way < cache->associativity; way++)
+        rrpv[way] += age;
+    return oldest;
+}
+
+/**
+ * @brief Generic dispatcher to find a replacement way based on cache policy.
+ */
+int cache_find_replacement_way(Cache *cache, uint32_t index) {
+    int way = -1;
+
+    switch (cache->replacement_policy) {
+        case REPLACEMENT_LRU:
+            way= cache_find_lru_way(cache, index);
+            break;
+        case REPLACEMENT_FIFO:
+            way= cache_find_fifo_way(cache, index); // Note: shares LRU logic
+            break;
+        case REPLACEMENT_RANDOM:
+            way= cache_find_random_way(cache, index);
+            break;
+        case REPLACEMENT_PLRU:
+            way= cache_find_plru_way(cache, index);
+            break;
+        case REPLACEMENT_SRRIP:
+        case REPLACEMENT_BRRIP:
+        case REPLACEMENT_DRRIP:
+        case REPLACEMENT_SHIP:
+            way= cache_find_rrip_way(cache, index);
+            break;
+        default:
+            way= cache_find_lru_way(cache, index); // Default to LRU
+            break;
+    }
+    return way;
+}
+
+/**
+ * @brief Updates the replacement state of a way that was hit.
+ */
+void cache_update_hit(Cache *cache, uint32_t index, int way) {
+    switch (cache->replacement_policy) {
+        case REPLACEMENT_LRU:
+            cache_set_stamp(cache, index)[way] = cache_next_stamp(cache);
+            break;
+        case REPLACEMENT_PLRU:
+            cache_plru_touch(cache, index, way);
+            break;
+        case REPLACEMENT_SHIP: {
+            size_t slot = (size_t)index * cache->tag_stride + way;
+            cache->reuse[slot] = 1;
+            if (cache->shct[cache->sig[slot]] < 3)
+                cache->shct[cache->sig[slot]]++;
+        }
+            /* fall through */
+        case REPLACEMENT_SRRIP:
+        case REPLACEMENT_BRRIP:
+        case REPLACEMENT_DRRIP:
+            /* hit priority: predict a near re-reference */
+            cache_set_rrpv(cache, index)[way] = 0;
+            break;
+        default:
+            /* FIFO and random do not change on hits */
+            break;
+    }
+}
+
+/**
+ * @brief Updates the replacement state of a block that leaves a way.
+ *
+ * Only SHiP learns from evictions: a block that was never reused makes its
+ * signature less likely to be kept next time.
+ */
+static inline void cache_update_eviction(Cache *cache, uint32_t index, int way) {
+    if (cache->replacement_policy != REPLACEMENT_SHIP)
+        return;
+    size_t slot = (size_t)index * cache->tag_stride + way;
+    if (!cache->reuse[slot] && cache->shct[cache->sig[slot]] > 0)
+        cache->shct[cache->sig[slot]]--;
+    cache->reuse[slot] = 0;
+}
+
+/**
+ * @brief Updates counters based on the insertion policy, for a block a demand
+ * miss just placed in 'way'.
+ */
+void cache_update_insertion(Cache *cache, uint32_t index, int way) {
+    cache_insert(cache, index, way, 1);
+}
+
+/**
+ * @brief Sets the replacement state of a block just placed in 'way'. Only
+ * 'demand' fills, which follow a demand miss in this cache, train the
+ * set-dueling selector; prefetch fills and victims arriving from above
+ * do not.
+ */
+static void cache_insert(Cache *cache, uint32_t index, int way, int demand) {
+    uint32_t state = 0;
+    int mru = 1;
+
+    /* LRU-family insertion position */
+    if (cache->replacement_policy == REPLACEMENT_LRU || cache->replacement_policy == REPLACEMENT_PLRU) {
+        switch (cache->insertion_policy) {
+            case INSERTION_LRU:
+                mru = 0;
+                break;
+            case INSERTION_BIP:
+                mru = cache_bimodal(cache);
+                break;
+            case INSERTION_DIP:
+                mru = !cache_duel(cache, index, demand) || cache_bimodal(cache);
+                break;
+            default:
+                break;
+        }
+    }
+
+   switch (cache->replacement_policy) {
+        case REPLACEMENT_LRU:
+            if (!mru) {
+                /* an LRU insertion takes stamp 0 and ages every other valid
+                 * way, so that the latest LRU insertion is the next victim */
+                uint32_t *stamp = cache_set_stamp(cache, index);
+                uint32_t *tags = cache_set_tags(cache, index);
+                for (int i = 0; i < cache->associativity; i++) {
+                    if (i != way && (tags[i] & CACHE_TAG_VALID) && stamp[i] < UINT32_MAX)
+                        stamp[i]++;
+                }
+            }
+            state = mru ? cache_next_stamp(cache) : 0;
+            cache_set_stamp(cache, index)[way] = state;
+            break;
+
+        case REPLACEMENT_FIFO:
+            // For FIFO, we only set insertion timestamp, never update on access
+            state = cache_next_stamp(cache);
+            cache_set_stamp(cache, index)[way] = state;
+            break;
+
+        case REPLACEMENT_RANDOM:
+            // Random replacement doesn't need any state
+            break;
+
+        case REPLACEMENT_PLRU:
+            /* an LRU insertion leaves the tree pointing at the new block */
+            if (mru)
+                cache_plru_touch(cache, index, way);
+            state = (uint32_t)cache->plru[index];
+            break;
+
+        case REPLACEMENT_SRRIP:
+            state = CACHE_RRPV_MAX - 1;
+            break;
+
+        case REPLACEMENT_BRRIP:
+            state = cache_bimodal(cache) ? CACHE_RRPV_MAX - 1 : CACHE_RRPV_MAX;
+            break;
+
+        case REPLACEMENT_DRRIP:
+            state = cache_duel(cache, index, demand) && !cache_bimodal(cache) ? CACHE_RRPV_MAX : CACHE_RRPV_MAX - 1;
+            break;
+
+        case REPLACEMENT_SHIP: {
+            size_t slot = (size_t)index * cache->tag_stride + way;
+            cache->sig[slot] = (uint16_t)cache_ship_signature(cache, index, way);
+            cache->reuse[slot] = 0;
+            /* signatures that never see reuse are inserted distant */
+            state = cache->shct[cache->sig[slot]] == 0 ? CACHE_RRPV_MAX : CACHE_RRPV_MAX - 1;
+            break;
+        }
+
+        default:
+            break;
+    }
+    if (cache->rrpv)
+        cache_set_rrpv(cache, index)[way] = (uint8_t)state;
+    TRACE(CACHE_INSERT, cache->id, index, way, state);
+}
+/*==============================================================================
+ * Miss Status Holding Registers (non-blocking caches)
+ *
+ * The cache model itself stays functional: a miss installs the block at once.
+ * MSHRs only track *when* each outstanding block arrives, so that the
+ * pipeline can keep going past a miss and wait only where the data is used.
+ *============================================================================*/
+
+/**
+ * @brief Makes a cache non-blocking with 'count' MSHRs (0 = blocking).
+ */
+void cache_set_mshrs(Cache *cache, int count) {
+    free(cache->mshr_addr);
+    free(cache->mshr_ready);
+    cache->num_mshrs = count;
+    cache->mshr_count = 0;
+    cache->mshr_addr = NULL;
+    cache->mshr_ready = NULL;
+    if (count <= 0)
+        return;
+
+    cache->mshr_addr = malloc(count * sizeof(uint32_t));
+    cache->mshr_ready = malloc(count * sizeof(uint64_t));
+    if (!cache->mshr_addr || !cache->mshr_ready) {
+        fprintf(stderr, "Error: Failed to allocate MSHRs\n");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Returns 1 if the block holding 'addr' is present, without side effects.
+ */
+int cache_probe(Cache *cache, uint32_t addr) {
+    uint32_t index, tag;
+    cache_decode(cache, addr, &index, &tag);
+    return cache_match_way(cache_set_tags(cache, index), cache->associativity, tag | CACHE_TAG_VALID) != -1 ||
+        cache_vc_find(cache, addr & ~((1 << cache->offset_bits) - 1)) != -1;
+}
+
+/**
+ * @brief Frees MSHRs whose fill has arrived, then looks up 'addr'.
+ * @return the cycle the outstanding fill of addr's block arrives, or 0 if
+ * there is none.
+ */
+uint64_t cache_mshr_pending(Cache *cache, uint32_t addr, uint64_t now) {
+    uint32_t block_addr = addr & ~((1 << cache->offset_bits) - 1);
+    uint64_t ready = 0;
+
+    for (int i = 0; i < cache->mshr_count; ) {
+        if (cache->mshr_ready[i] <= now) {
+            cache->mshr_count--;
+            cache->mshr_addr[i] = cache->mshr_addr[cache->mshr_count];
+            cache->mshr_ready[i] = cache->mshr_ready[cache->mshr_count];
+            continue;
+        }
+        if (cache->mshr_addr[i] == block_addr)
+            ready = cache->mshr_ready[i];
+        i++;
+    }
+    return ready;
+}
+
+/**
+ * @brief Records a primary miss that completes at cycle 'ready'.
+ */
+static void cache_mshr_allocate(Cache *cache, uint32_t addr, uint64_t now, uint64_t ready) {
+    int i = cache->mshr_count++;
+    cache->mshr_addr[i] = addr & ~((1 << cache->offset_bits) - 1);
+    cache->mshr_ready[i] = ready;
+    cache->stats.mshr_primary++;
+
+    /* memory-level parallelism = occupancy / cycles with any miss outstanding */
+    cache->stats.mshr_occupancy += ready - now;
+    uint64_t start = now > cache->mshr_busy_until ? now : cache->mshr_busy_until;
+    if (ready > start)
+        cache->stats.mshr_busy_cycles += ready - start;
+    if (ready > cache->mshr_busy_until)
+        cache->mshr_busy_until = ready;
+}
+
+/**
+ * @brief Non-blocking access: cache_access() plus MSHR bookkeeping.
+ *
+ * A primary miss takes an MSHR, a secondary miss to a block that is still
+ * being filled merges into the existing one. The primary already counted the
+ * miss, so a merge is counted in mshr_merges only, not as an access (nor a
+ * hit, although the block has been filled functionally). '*ready' is set to the cycle at
+ * which the data is available ('now' for a hit, unless it hit a prefetch
+ * still in flight).
+ * @return 1 on hit, 0 on miss, -1 if the access needed an MSHR and none was
+ * free (nothing was done; retry later).
+ */
+int cache_access_nb(Cache *cache, uint32_t addr, uint32_t *data, int is_write, uint32_t write_data,
+        uint64_t now, uint64_t *ready) {
+    uint64_t pending = cache_mshr_pending(cache, addr, now);
+
+    if (!pending && cache->mshr_count >= cache->num_mshrs && !cache_probe(cache, addr)) {
+        cache->stats.mshr_full++;
+        return -1;
+    }
+
+    cache_merging = pending ? cache : NULL;
+    int hit = cache_access(cache, addr, data, is_write, write_data);
+    cache_merging = NULL;
+    *ready = hit ? now + cache->service_latency : now;
+    if (pending) {
+        /* secondary miss */
+        cache->stats.mshr_merges++;
+        *ready = pending;
+        return 0;
+    }
+    if (!hit && (!is_write || cache->write_allocate)) {
+        *ready = now + cache->service_latency;
+        cache_mshr_allocate(cache, addr, now, *ready);
+    }
+    return hit;
+}
+
+/*==============================================================================
+ * Prefetch Fills
+ *============================================================================*/
+
+/**
+ * @brief Fills the block holding 'addr' on behalf of the cache's prefetcher.
+ *
+ * The fill is functional like a demand miss, but is not counted as an access
+ * here or in the levels below. The block is tagged as prefetched, and the
+ * prefetch occupies a prefetch queue entry until it arrives.
+ * @return 1 if a prefetch was issued, 0 if the block was already present or
+ * the prefetch queue was full.
+ */
+int cache_prefetch(Cache *cache, uint32_t addr) {
+    Prefetcher *pf = cache->prefetcher;
+    uint32_t index, tag;
+    cache_decode(cache, addr, &index, &tag);
+    uint32_t *tags = cache_set_tags(cache, index);
+
+    if (cache_match_way(tags, cache->associativity, tag | CACHE_TAG_VALID) != -1) {
+        pf->stats.redundant++;
+        return 0;
+    }
+    int slot = prefetch_queue_slot(pf, stat_cycles);
+    if (slot < 0) {
+        pf->stats.dropped++;
+        return 0;
+    }
+
+    int way = cache_find_replacement_way(cache, index);
+    uint32_t block_addr = addr & ~((1 << cache->offset_bits) - 1);
+    int stall;
+    cache_prefetching = 1;
+    int latency = cache_fill(cache, index, way, tag, block_addr, &stall);
+    cache_prefetching = 0;
+    cache_insert(cache, index, way, 0);
+    cache_set_pf(cache, index)[way] = 1;
+
+    pf->queue_addr[slot] = block_addr;
+    pf->queue_ready[slot] = stat_cycles + latency;
+    pf->stats.issued++;
+    return 1;
+}
+
+/**
+ * @brief Prints cache statistics.
+ */
+void cache_print_stats(Cache *cache, const char* cache_name) {
+    printf("%s Statistics:\n", cache_name);
+    printf("  Accesses: %" PRIu64 "\n", cache->stats.accesses);
+    printf("  Hits: %" PRIu64 "\n", cache->stats.hits);
+    printf("  Misses: %" PRIu64 "\n", cache->stats.misses);
+    printf("  Writebacks: %" PRIu64 "\n", cache->stats.writebacks);
+    if (cache->miss_class) {
+        printf("  Miss classes: %" PRIu64 " compulsory, %" PRIu64 " capacity, %" PRIu64 " conflict\n",
+                cache->miss_class->compulsory, cache->miss_class->capacity_misses,
+                cache->miss_class->conflict);
+    }
+    if (cache->stats.write_requests > 0)
+        printf("  Writes from above: %" PRIu64 " (%" PRIu64 " misses)\n", cache->stats.write_requests, cache->stats.write_misses);
+    if (cache->num_mshrs > 0) {
+        printf("  MSHRs: %d, %" PRIu64 " primary misses, %" PRIu64 " merged, %" PRIu64 " full stalls\n",
+                cache->num_mshrs, cache->stats.mshr_primary, cache->stats.mshr_merges, cache->stats.mshr_full);
+        if (cache->stats.mshr_busy_cycles > 0)
+            printf("  MLP: %.2f\n", (double)cache->stats.mshr_occupancy / cache->stats.mshr_busy_cycles);
+    }
+    if (cache->vc_entries > 0) {
+        printf("  Victim cache: %d entries, %" PRIu64 " hits, %" PRIu64 " swaps, %" PRIu64 " dirty writebacks\n",
+                cache->vc_entries, cache->stats.vc_hits, cache->stats.vc_swaps, cache->stats.vc_writebacks);
+    }
+    if (cache->wbuf_depth > 0) {
+        printf("  Write buffer: %" PRIu64 " writes, %" PRIu64 " merged, %" PRIu64 " drained, %" PRIu64 " stall cycles\n",
+                cache->stats.wbuf_writes, cache->stats.wbuf_merges, cache->stats.wbuf_drains, cache->stats.wbuf_stall_cycles);
+    }
+    if (cache->inclusion == INCLUSION_INCLUSIVE)
+        printf("  Back-invalidations: %" PRIu64 "\n", cache->stats.back_invalidations);
+    if (cache->replacement_policy == REPLACEMENT_DRRIP ||
+            (cache->insertion_policy == INSERTION_DIP &&
+             (cache->replacement_policy == REPLACEMENT_LRU || cache->replacement_policy == REPLACEMENT_PLRU)))
+        printf("  PSEL: %d/%d\n", cache->psel, (1 << CACHE_PSEL_BITS) - 1);
+    if (cache->stats.prefetch_requests > 0)
+        printf("  Prefetch fills from above: %" PRIu64 "\n", cache->stats.prefetch_requests);
+    if (cache->prefetcher)
+        prefetch_print_stats(cache->prefetcher);
+    if (cache->set_profile && cache->stats.accesses > 0)
+        setprof_print(cache->set_profile);
+    if (cache->stack_profile && cache->stats.accesses > 0)
+        stackdist_print_curve(cache);
+    if (cache->stats.accesses > 0) {
+        printf("  Hit Rate: %.2f%%\n", (double)cache->stats.hits / cache->stats.accesses * 100.0);
+        printf("  Miss Rate: %.2f%%\n", (double)cache->stats.misses / cache->stats.accesses * 100.0);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Registers the counters of 'cache', and of its prefetcher and
+ * profiles, in the statistics registry under 'prefix' (e.g. "dcache").
+ */
+void cache_register_stats(Cache *cache, const char *prefix)
+{
+    stats_counter(prefix, "accesses", &cache->stats.accesses, "demand accesses");
+    stats_counter(prefix, "hits", &cache->stats.hits, "demand hits");
+    stats_counter(prefix, "misses", &cache->stats.misses, "demand misses");
+    stats_ratio(prefix, "hit_rate", &cache->stats.hits, &cache->stats.accesses, 1.0, "hits per access");
+    stats_counter(prefix, "writebacks", &cache->stats.writebacks, "dirty blocks written to the next level");
+    stats_counter(prefix, "back_invalidations", &cache->stats.back_invalidations, "blocks invalidated by inclusion");
+    stats_counter(prefix, "write_requests", &cache->stats.write_requests, "writes received from the level above");
+    stats_counter(prefix, "write_misses", &cache->stats.write_misses, "writes from above that missed");
+    stats_counter(prefix, "prefetch_requests", &cache->stats.prefetch_requests, "prefetch fills received from above");
+    if (cache->wbuf_depth > 0) {
+        stats_counter(prefix, "wbuf.writes", &cache->stats.wbuf_writes, "writes sent through the write buffer");
+        stats_counter(prefix, "wbuf.merges", &cache->stats.wbuf_merges, "writes coalesced with a pending entry");
+        stats_counter(prefix, "wbuf.drains", &cache->stats.wbuf_drains, "entries drained to the next level");
+        stats_counter(prefix, "wbuf.stall_cycles", &cache->stats.wbuf_stall_cycles, "cycles waiting on a full buffer");
+    }
+    if (cache->num_mshrs > 0) {
+        stats_counter(prefix, "mshr.primary", &cache->stats.mshr_primary, "misses that allocated an MSHR");
+        stats_counter(prefix, "mshr.merges", &cache->stats.mshr_merges, "secondary misses merged into one");
+        stats_counter(prefix, "mshr.full", &cache->stats.mshr_full, "accesses refused for lack of an MSHR");
+        stats_ratio(prefix, "mshr.mlp", &cache->stats.mshr_occupancy, &cache->stats.mshr_busy_cycles, 1.0,
+                "mean misses outstanding while any is");
+    }
+    if (cache->vc_entries > 0) {
+        stats_counter(prefix, "victim.hits", &cache->stats.vc_hits, "misses serviced by the victim cache");
+        stats_counter(prefix, "victim.swaps", &cache->stats.vc_swaps, "victim hits that swapped a block in");
+        stats_counter(prefix, "victim.writebacks", &cache->stats.vc_writebacks, "dirty blocks written back from it");
+    }
+    if (cache->miss_class) {
+        Miss_Classifier *mc = cache->miss_class;
+        stats_counter(prefix, "misses.compulsory", &mc->compulsory, "first references to a block");
+        stats_counter(prefix, "misses.capacity", &mc->capacity_misses, "misses of a fully associative LRU cache");
+        stats_counter(prefix, "misses.conflict", &mc->conflict, "the remaining misses");
+    }
+    if (cache->prefetcher) {
+        Prefetcher *pf = cache->prefetcher;
+        stats_counter(prefix, "prefetch.issued", &pf->stats.issued, "prefetches that filled a block");
+        stats_counter(prefix, "prefetch.redundant", &pf->stats.redundant, "prefetches of a present block");
+        stats_counter(prefix, "prefetch.dropped", &pf->stats.dropped, "prefetches dropped on a full queue");
+        stats_counter(prefix, "prefetch.useful", &pf->stats.useful, "prefetched blocks used by a demand access");
+        stats_counter(prefix, "prefetch.late", &pf->stats.late, "useful prefetches still in flight at the access");
+        stats_counter(prefix, "prefetch.unused", &pf->stats.unused, "prefetched blocks evicted unused");
+        stats_ratio(prefix, "prefetch.accuracy", &pf->stats.useful, &pf->stats.issued, 1.0, "useful per issued prefetch");
+    }
+    for (Stack_Profiler *sd = cache->stack_profile; sd; sd = sd->next) {
+        char name[STATS_MAX_NAME];
+        snprintf(name, sizeof(name), "stack_distance.%d", sd->num_sets);
+        stats_histogram(prefix, name, &sd->hist, &sd->hist_size, "sampled references by LRU stack distance");
+    }
+}
@@ -0,0 +1,271 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tag store layout
+ *
+ * Per-block metadata is kept structure-of-arrays style, separate from the
+ * data payload. All metadata lives in a single 64-byte aligned arena:
+ *
+ *   tags  [num_sets][tag_stride]  uint32  (tag | CACHE_TAG_VALID, 0 = invalid)
+ *   dirty [num_sets][tag_stride]  uint8
+ *   pf    [num_sets][tag_stride]  uint8   (filled by a prefetch, not yet used)
+ *
+ * followed by the replacement state, sized to the policy (absent regions are
+ * not allocated and their pointers are NULL):
+ *
+ *   stamp [num_sets][tag_stride]  uint32  LRU, FIFO (timestamp)
+ *   plru  [num_sets]              uint64  PLRU (tree bits, node n at bit n)
+ *   rrpv  [num_sets][tag_stride]  uint8   RRIP family (2-bit re-reference value)
+ *   sig   [num_sets][tag_stride]  uint16  SHiP (signature of the inserting access)
+ *   reuse [num_sets][tag_stride]  uint8   SHiP (hit since insertion)
+ *
+ * tag_stride is the associativity rounded up to CACHE_TAG_LANES so that the
+ * tag-compare kernel can check a whole set with full-width vector loads. The
+ * padding lanes are always 0 and therefore never match a valid tag. The data
+ * payload is a separate [num_sets][associativity][block_size/4] word array. */
+
+#define CACHE_TAG_VALID 0x80000000u /* folded into the stored tag */
+#define CACHE_TAG_LANES 8           /* tag row padding (one AVX2 vector) */
+#define CACHE_ARENA_ALIGN 64        /* host cache line */
+
+// Cache replacement policies
+typedef enum {
+    REPLACEMENT_LRU,
+    REPLACEMENT_FIFO,
+    REPLACEMENT_RANDOM,
+    REPLACEMENT_PLRU,   // tree pseudo-LRU (power-of-two associativity)
+    REPLACEMENT_SRRIP,  // static re-reference interval prediction
+    REPLACEMENT_BRRIP,  // bimodal RRIP (thrash resistant)
+    REPLACEMENT_DRRIP,  // set-dueling between SRRIP and BRRIP
+    REPLACEMENT_SHIP    // SRRIP with signature-based hit prediction
+} ReplacementPolicy;
+
+// Cache insertion policies (LRU and PLRU; the RRIP family chooses its own)
+typedef enum {
+    INSERTION_MRU,  // Most Recently Used (normal)
+    INSERTION_LRU, // Least Recently Used
+    INSERTION_BIP,  // LRU, but MRU once every CACHE_BIP_EPSILON insertions
+    INSERTION_DIP   // set-dueling between MRU and BIP
+} InsertionPolicy;
+
+#define CACHE_RRPV_MAX 3        /* 2-bit RRPV: 0 = near, 3 = distant re-reference */
+#define CACHE_BIP_EPSILON 32    /* bimodal insertions: 1 in N goes to MRU/long */
+#define CACHE_DUEL_LEADERS 32   /* leader sets per competing policy */
+#define CACHE_PSEL_BITS 10      /* policy selection counter width */
+#define CACHE_SHCT_SIZE 4096    /* SHiP signature history counter table */
+
+/* Inclusion of a level with respect to the caches above it */
+typedef enum {
+    INCLUSION_NON_INCLUSIVE, /* no enforcement */
+    INCLUSION_INCLUSIVE,     /* evictions back-invalidate upper copies */
+    INCLUSION_EXCLUSIVE      /* holds only blocks evicted from above */
+} InclusionPolicy;
+
+/* Write hit policy */
+typedef enum {
+    WRITE_BACK,     /* keep dirty, write on eviction or flush */
+    WRITE_THROUGH   /* forward every write to the next level */
+} WritePolicy;
+
+/* Set index function. Power-of-two set counts select index bits, other set
+ * counts take the block number modulo the number of sets; either way the tag
+ * is the block number divided by the number of sets. INDEX_HASH rotates the
+ * set by a hash of the tag so that power-of-two strides spread over all sets. */
+typedef enum {
+    INDEX_MODULO,   /* block number mod sets (bit selection for powers of two) */
+    INDEX_HASH      /* ... offset by a multiplicative hash of the tag */
+} IndexFunction;
+
+#define CACHE_MIN_BLOCK 4       /* block sizes: powers of two in this range */
+#define CACHE_MAX_BLOCK 4096
+
+#define CACHE_MAX_UPPER 4   /* caches that may share one lower level */
+#define CACHE_VC_VALID 1u   /* folded into a victim cache entry's block address */
+
+struct Prefetcher;
+struct Stack_Profiler;
+struct Miss_Classifier;
+struct Set_Profile;
+
+/* statistics counters of a cache level */
+typedef struct Cache_Stats {
+    uint64_t accesses;
+    uint64_t misses;
+    uint64_t hits;
+    uint64_t writebacks;
+    uint64_t back_invalidations;
+    uint64_t write_requests;    /* writes received from the level above */
+    uint64_t write_misses;
+    uint64_t wbuf_writes;       /* writes sent through the write buffer */
+    uint64_t wbuf_merges;       /* ... coalesced with a pending entry */
+    uint64_t wbuf_drains;       /* ... drained to the next level */
+    uint64_t wbuf_stall_cycles; /* cycles spent waiting on a full buffer */
+    uint64_t mshr_primary;      /* misses that allocated an MSHR */
+    uint64_t mshr_merges;       /* secondary misses merged into one */
+    uint64_t mshr_full;         /* accesses refused for lack of an MSHR */
+    uint64_t mshr_occupancy;    /* sum over misses of cycles outstanding */
+    uint64_t mshr_busy_cycles;  /* cycles with at least one miss outstanding */
+    uint64_t vc_hits;           /* misses serviced by the victim cache */
+    uint64_t vc_swaps;          /* ... that swapped a block into it */
+    uint64_t vc_writebacks;     /* dirty blocks written back when leaving it */
+    uint64_t prefetch_requests; /* prefetch fills received from above (not
+                                   counted as accesses) */
+} Cache_Stats;
+
+/* state set aside during a functional warm-up (cache_begin_warmup) */
+typedef struct Cache_Warmup Cache_Warmup;
+
+/* Cache structure */
+typedef struct Cache {
+    int size;               /* cache size in bytes */
+    int block_size;         /* block size in bytes */
+    int associativity;      /* number of ways */
+    int num_sets;           /* number of sets */
+    int index_bits;         /* number of index bits (rounded up) */
+    int offset_bits;        /* number of offset bits */
+    int tag_bits;           /* number of tag bits */
+    int id;                 /* creation order, used in trace records */
+    int tag_stride;         /* ways per tag row, padded to CACHE_TAG_LANES */
+    uint32_t set_mask;      /* num_sets - 1 if a power of two, else 0 (modulo) */
+    IndexFunction indexing;
+    void *arena;            /* metadata arena (owns everything below but data) */
+    uint32_t *tags;         /* [set][tag_stride] tag | CACHE_TAG_VALID */
+    uint8_t *dirty;         /* [set][tag_stride] dirty bits */
+    uint8_t *pf;            /* [set][tag_stride] prefetched, not yet used */
+    uint32_t *stamp;        /* [set][tag_stride] LRU/FIFO timestamps */
+    uint64_t *plru;         /* [set] PLRU tree bits */
+    uint8_t *rrpv;          /* [set][tag_stride] RRIP re-reference values */
+    uint16_t *sig;          /* [set][tag_stride] SHiP signatures */
+    uint8_t *reuse;         /* [set][tag_stride] SHiP reuse bits */
+    uint8_t *shct;          /* [CACHE_SHCT_SIZE] SHiP 2-bit counters */
+    uint32_t *data;         /* [set][way][block_size/4] data payload (NULL if tag-only) */
+    uint32_t global_lru_counter; /* global counter for LRU (renumbered on wrap) */
+    ReplacementPolicy replacement_policy;
+    InsertionPolicy insertion_policy;
+    int psel;               /* set-dueling selector (DIP, DRRIP) */
+    uint32_t bip_counter;   /* bimodal insertion throttle */
+    uint32_t rand_state;    /* random replacement (xorshift32, never 0) */
+    uint32_t access_pc;     /* PC of the access in progress (0 = unknown), for SHiP */
+    /* Hierarchy */
+    int latency;            /* cycles to service a miss from the level above */
+    InclusionPolicy inclusion;
+    struct Cache *next;     /* next level towards memory (NULL = memory) */
+    struct Cache *upper[CACHE_MAX_UPPER]; /* levels directly above */
+    int num_upper;
+    int service_latency;    /* latency of the level that serviced the last miss */
+    /* Write policy */
+    WritePolicy write_policy;
+    int write_allocate;     /* allocate on write miss (else write around) */
+    int wbuf_depth;         /* write buffer entries (0 = ideal, no buffer) */
+    int wbuf_count, wbuf_head;
+    uint32_t *wbuf_addr;    /* [wbuf_depth] block address of each entry */
+    uint64_t *wbuf_done;    /* [wbuf_depth] cycle at which each entry drains */
+    /* Non-blocking operation */
+    int num_mshrs;          /* miss status holding registers (0 = blocking) */
+    int mshr_count;         /* outstanding misses */
+    uint32_t *mshr_addr;    /* [num_mshrs] block address being filled */
+    uint64_t *mshr_ready;   /* [num_mshrs] cycle the fill arrives */
+    uint64_t mshr_busy_until;
+    /* Victim cache: small, fully associative, holds blocks evicted from this
+     * cache and swaps them back on a hit. Entries are [vc_entries], padded to
+     * CACHE_TAG_LANES so that lookups use cache_match_way(). */
+    int vc_entries;         /* victim cache lines (0 = none) */
+    int vc_latency;         /* cycles to service a miss from the victim cache */
+    uint32_t *vc_addr;      /* block address | CACHE_VC_VALID, 0 = invalid */
+    uint8_t *vc_dirty;
+    uint64_t *vc_stamp;     /* LRU timestamps */
+    uint64_t vc_clock;
+    uint32_t *vc_data;      /* [vc_entries + 1][block_size/4], last is swap space
+                               (NULL if tag-only) */
+    /* Prefetching */
+    struct Prefetcher *prefetcher; /* fills this cache (NULL = none) */
+    /* Profiling */
+    struct Stack_Profiler *stack_profile; /* LRU stack distances of the demand
+                                             accesses (NULL = none) */
+    struct Miss_Classifier *miss_class;   /* 3C classification of the demand
+                                             misses (NULL = none) */
+    struct Set_Profile *set_profile;      /* per-set counters (NULL = none) */
+    /* Statistics */
+    Cache_Stats stats;
+} Cache;
+
+/* latency of main memory, below the last level of every hierarchy */
+extern int cache_mem_latency;
+
+/* tag-only mode: caches keep metadata only and every load and store is
+ * served by backing memory, which stays authoritative. Hit, miss and
+ * writeback counts are the same as with data. Set before creating caches. */
+extern int cache_tag_only;
+
+/* Cache functions */
+Cache* cache_create(int size, int block_size, int associativity ,int replacement_policy, int insertion_policy);
+int cache_valid_geometry(int size, int block_size, int associativity);
+void cache_destroy(Cache *cache);
+int cache_access(Cache *cache, uint32_t addr, uint32_t *data, int is_write, uint32_t write_data);
+void cache_print_stats(Cache *cache, const char* cache_name);
+void cache_register_stats(Cache *cache, const char *prefix);
+int cache_find_lru_way(Cache *cache, uint32_t index);
+int cache_find_fifo_way(Cache *cache, uint32_t index);
+int cache_find_random_way(Cache *cache, uint32_t index);
+int cache_find_replacement_way(Cache *cache, uint32_t index) ;
+void cache_update_insertion(Cache *cache, uint32_t index, int way) ;
+void cache_update_hit(Cache *cache, uint32_t index, int way);
+int cache_find_plru_way(Cache *cache, uint32_t index);
+int cache_find_rrip_way(Cache *cache, uint32_t index);
+
+int cache_load_block(Cache *cache, int way, uint32_t index, uint32_t block_addr);
+void cache_attach(Cache *upper, Cache *lower);
+void cache_set_write_buffer(Cache *cache, int depth);
+void cache_flush(Cache *cache);
+void cache_invalidate(Cache *cache);
+Cache_Warmup *cache_begin_warmup(Cache *cache);
+void cache_end_warmup(Cache *cache, Cache_Warmup *w);
+void cache_set_mshrs(Cache *cache, int count);
+void cache_set_victim_cache(Cache *cache, int entries, int latency);
+int cache_probe(Cache *cache, uint32_t addr);
+uint64_t cache_mshr_pending(Cache *cache, uint32_t addr, uint64_t now);
+int cache_access_nb(Cache *cache, uint32_t addr, uint32_t *data, int is_write, uint32_t write_data,
+        uint64_t now, uint64_t *ready);
+int cache_prefetch(Cache *cache, uint32_t addr);
+
+/* Returns the first way in [0, ways) of a tag row equal to 'key', or -1. */
+int cache_match_way(const uint32_t *row, int ways, uint32_t key);
+
+/* metadata row / data block accessors */
+static inline uint32_t *cache_set_tags(Cache *cache, uint32_t index)
+{
+    return cache->tags + (uint32_t)index * cache->tag_stride;
+}
+
+static inline uint32_t *cache_set_stamp(Cache *cache, uint32_t index)
+{
+    return cache->stamp + (uint32_t)index * cache->tag_stride;
+}
+
+static inline uint8_t *cache_set_dirty(Cache *cache, uint32_t index)
+{
+    return cache->dirty + (uint32_t)index * cache->tag_stride;
+}
+
+static inline uint8_t *cache_set_rrpv(Cache *cache, uint32_t index)
+{
+    return cache->rrpv + (uint32_t)index * cache->tag_stride;
+}
+
+static inline uint8_t *cache_set_pf(Cache *cache, uint32_t index)
+{
+    return cache->pf + (uint32_t)index * cache->tag_stride;
+}
+
+/* NULL in tag-only mode */
+static inline uint32_t *cache_block_data(Cache *cache, uint32_t index, int way)
+{
+    if (!cache->data)
+        return NULL;
+    return cache->data + ((uint32_t)index * cache->associativity + way) * (cache->block_size / 4);
+}
+
+#endif
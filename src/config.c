@@ -0,0 +1,715 @@
+#include "config.h"
+#include "pipe.h"
+#include "stackdist.h"
+#include "missclass.h"
+#include "setprof.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <ctype.h>
+
+/*==============================================================================
+ * Defaults
+ *============================================================================*/
+
+#define CACHE_DEFAULTS \
+    .indexing = PIPE_CACHE_INDEXING, \
+    .write_policy = WRITE_BACK, .write_allocate = 1, .victim_latency = PIPE_VICTIM_LATENCY, \
+    .prefetch_degree = PIPE_PREFETCH_DEGREE, .prefetch_distance = PIPE_PREFETCH_DISTANCE
+
+Sim_Config sim_config = {
+    .icache = { CACHE_DEFAULTS, .size = 8 * 1024, .block_size = 32, .assoc = 4,
+        .replacement = REPLACEMENT_RANDOM, .insertion = INSERTION_MRU, .latency = 1,
+        .inclusion = INCLUSION_NON_INCLUSIVE,
+        .mshrs = PIPE_ICACHE_MSHRS, .victim = PIPE_ICACHE_VICTIM },
+    .dcache = { CACHE_DEFAULTS, .size = 64 * 1024, .block_size = 32, .assoc = 4,
+        .replacement = PIPE_DCACHE_REPLACEMENT, .insertion = PIPE_DCACHE_INSERTION, .latency = 1,
+        .inclusion = INCLUSION_NON_INCLUSIVE,
+        .mshrs = PIPE_DCACHE_MSHRS, .victim = PIPE_DCACHE_VICTIM,
+        .prefetcher = PIPE_DCACHE_PREFETCHER },
+    .l2 = { CACHE_DEFAULTS, .size = 256 * 1024, .block_size = 64, .assoc = 8,
+        .replacement = PIPE_L2_REPLACEMENT, .insertion = PIPE_L2_INSERTION, .latency = 12,
+        .inclusion = INCLUSION_NON_INCLUSIVE },
+    .llc = { CACHE_DEFAULTS, .size = PIPE_LLC_SIZE, .block_size = 64, .assoc = 16,
+        .replacement = PIPE_LLC_REPLACEMENT, .insertion = PIPE_LLC_INSERTION, .latency = 35,
+        .inclusion = INCLUSION_INCLUSIVE },
+    .mem_latency = 50,
+    .tag_only = PIPE_TAG_ONLY,
+    .mult_latency = 4,
+    .div_latency = 32,
+    .ff_warm = PIPE_FF_WARM,
+    .bpred = PIPE_BPRED,
+    .btb_entries = PIPE_BTB_ENTRIES,
+    .bpred_entries = PIPE_BPRED_ENTRIES,
+    .bpred_history = PIPE_BPRED_HISTORY,
+    .ras_entries = PIPE_RAS_ENTRIES,
+};
+
+/*==============================================================================
+ * Option Table
+ *============================================================================*/
+
+typedef enum {
+    OPT_INT,
+    OPT_SIZE,   /* integer with an optional K/M/G suffix */
+    OPT_BOOL,
+    OPT_ENUM    /* index into a NULL-terminated name list */
+} Option_Type;
+
+typedef struct Config_Option {
+    const char *section;
+    const char *key;
+    Option_Type type;
+    size_t offset;              /* of the int in Sim_Config */
+    const char *const *names;   /* OPT_ENUM values */
+    int min;                    /* smallest valid value */
+} Config_Option;
+
+static const char *const replacement_names[] = {
+    "lru", "fifo", "random", "plru", "srrip", "brrip", "drrip", "ship", NULL };
+static const char *const insertion_names[] = { "mru", "lru", "bip", "dip", NULL };
+static const char *const indexing_names[] = { "modulo", "hash", NULL };
+static const char *const inclusion_names[] = { "non-inclusive", "inclusive", "exclusive", NULL };
+static const char *const write_names[] = { "back", "through", NULL };
+static const char *const prefetch_names[] = { "none", "next-line", "stride", "stream", NULL };
+static const char *const bpred_names[] = { "none", "btfn", "bimodal", "gshare", "tournament", NULL };
+
+#define CFG(field) offsetof(Sim_Config, field)
+
+/* options every cache level has */
+#define CACHE_OPTIONS(sec) \
+    { #sec, "size", OPT_SIZE, CFG(sec.size), NULL, 0 }, \
+    { #sec, "block_size", OPT_SIZE, CFG(sec.block_size), NULL, 0 }, \
+    { #sec, "assoc", OPT_INT, CFG(sec.assoc), NULL, 0 }, \
+    { #sec, "replacement", OPT_ENUM, CFG(sec.replacement), replacement_names, 0 }, \
+    { #sec, "insertion", OPT_ENUM, CFG(sec.insertion), insertion_names, 0 }, \
+    { #sec, "indexing", OPT_ENUM, CFG(sec.indexing), indexing_names, 0 }, \
+    { #sec, "latency", OPT_INT, CFG(sec.latency), NULL, 0 }, \
+    { #sec, "victim", OPT_INT, CFG(sec.victim), NULL, 0 }, \
+    { #sec, "victim_latency", OPT_INT, CFG(sec.victim_latency), NULL, 0 }, \
+    { #sec, "mrc", OPT_INT, CFG(sec.mrc), NULL, 0 }, \
+    { #sec, "classify", OPT_BOOL, CFG(sec.classify), NULL, 0 }, \
+    { #sec, "set_profile", OPT_INT, CFG(sec.set_profile), NULL, 0 }
+
+#define WRITE_OPTIONS(sec) \
+    { #sec, "write_policy", OPT_ENUM, CFG(sec.write_policy), write_names, 0 }, \
+    { #sec, "write_allocate", OPT_BOOL, CFG(sec.write_allocate), NULL, 0 }, \
+    { #sec, "write_buffer", OPT_INT, CFG(sec.write_buffer), NULL, 0 }
+
+static const Config_Option config_options[] = {
+    CACHE_OPTIONS(icache),
+    { "icache", "mshrs", OPT_INT, CFG(icache.mshrs), NULL, 0 },
+
+    CACHE_OPTIONS(dcache),
+    WRITE_OPTIONS(dcache),
+    { "dcache", "mshrs", OPT_INT, CFG(dcache.mshrs), NULL, 0 },
+    { "dcache", "prefetcher", OPT_ENUM, CFG(dcache.prefetcher), prefetch_names, 0 },
+    { "dcache", "prefetch_degree", OPT_INT, CFG(dcache.prefetch_degree), NULL, 1 },
+    { "dcache", "prefetch_distance", OPT_INT, CFG(dcache.prefetch_distance), NULL, 1 },
+
+    CACHE_OPTIONS(l2),
+    WRITE_OPTIONS(l2),
+    { "l2", "inclusion", OPT_ENUM, CFG(l2.inclusion), inclusion_names, 0 },
+
+    CACHE_OPTIONS(llc),
+    WRITE_OPTIONS(llc),
+    { "llc", "inclusion", OPT_ENUM, CFG(llc.inclusion), inclusion_names, 0 },
+
+    { "memory", "latency", OPT_INT, CFG(mem_latency), NULL, 0 },
+    { "memory", "tag_only", OPT_BOOL, CFG(tag_only), NULL, 0 },
+
+    { "core", "mult_latency", OPT_INT, CFG(mult_latency), NULL, 0 },
+    { "core", "div_latency", OPT_INT, CFG(div_latency), NULL, 0 },
+    { "core", "ff_warm", OPT_BOOL, CFG(ff_warm), NULL, 0 },
+
+    { "bpred", "type", OPT_ENUM, CFG(bpred), bpred_names, 0 },
+    { "bpred", "btb_entries", OPT_INT, CFG(btb_entries), NULL, 1 },
+    { "bpred", "entries", OPT_INT, CFG(bpred_entries), NULL, 1 },
+    { "bpred", "history", OPT_INT, CFG(bpred_history), NULL, 0 },
+    { "bpred", "ras", OPT_INT, CFG(ras_entries), NULL, 0 },
+};
+
+#define CONFIG_NUM_OPTIONS ((int)(sizeof(config_options) / sizeof(config_options[0])))
+
+static int *config_field(const Config_Option *opt)
+{
+    return (int *)((char *)&sim_config + opt->offset);
+}
+
+/*==============================================================================
+ * Setting Options
+ *============================================================================*/
+
+/* the config file and line being read, for error messages (NULL while
+ * applying the command line) */
+static const char *config_file;
+static int config_line;
+
+/* starts an error message, prefixed with the config file location if any */
+static void config_error_start()
+{
+    fprintf(stderr, "Error: ");
+    if (config_file)
+        fprintf(stderr, "%s:%d: ", config_file, config_line);
+}
+
+/**
+ * @brief Parses an option value.
+ * @return 0 on success, -1 if the value is not valid for the option.
+ */
+static int config_parse_value(const Config_Option *opt, const char *value, int *out)
+{
+    char *end;
+
+    switch (opt->type) {
+        case OPT_ENUM:
+            for (int i = 0; opt->names[i]; i++) {
+                if (strcasecmp(value, opt->names[i]) == 0) {
+                    *out = i;
+                    return 0;
+                }
+            }
+            return -1;
+        case OPT_BOOL:
+            if (strcasecmp(value, "true") == 0 || strcasecmp(value, "yes") == 0 ||
+                    strcasecmp(value, "on") == 0 || strcmp(value, "1") == 0) {
+                *out = 1;
+                return 0;
+            }
+            if (strcasecmp(value, "false") == 0 || strcasecmp(value, "no") == 0 ||
+                    strcasecmp(value, "off") == 0 || strcmp(value, "0") == 0) {
+                *out = 0;
+                return 0;
+            }
+            return -1;
+        default: {
+            long v = strtol(value, &end, 0);
+            if (end == value)
+                return -1;
+            if (opt->type == OPT_SIZE) {
+                switch (toupper((unsigned char)*end)) {
+                    case 'K': v <<= 10; end++; break;
+                    case 'M': v <<= 20; end++; break;
+                    case 'G': v <<= 30; end++; break;
+                }
+                if (toupper((unsigned char)*end) == 'B')
+                    end++;
+            }
+            if (*end != '\0' || v < opt->min || v > 0x7fffffffL)
+                return -1;
+            *out = (int)v;
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Sets one option.
+ * @return 0 on success, -1 for an unknown option or invalid value (both
+ * reported on stderr).
+ */
+int config_set(const char *section, const char *key, const char *value)
+{
+    for (int i = 0; i < CONFIG_NUM_OPTIONS; i++) {
+        const Config_Option *opt = &config_options[i];
+        if (strcmp(opt->section, section) != 0 || strcmp(opt->key, key) != 0)
+            continue;
+        if (config_parse_value(opt, value, config_field(opt)) != 0) {
+            config_error_start();
+            fprintf(stderr, "Invalid value '%s' for %s.%s\n", value, section, key);
+            return -1;
+        }
+        return 0;
+    }
+    config_error_start();
+    fprintf(stderr, "Unknown option %s.%s\n", section, key);
+    return -1;
+}
+
+/* trims leading and trailing white space in place */
+static char *config_trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+/**
+ * @brief Sets an option given as "section.key=value".
+ */
+int config_apply(const char *assignment)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "%s", assignment);
+    char *eq = strchr(text, '=');
+    char *dot = strchr(text, '.');
+    if (!eq || !dot || dot > eq) {
+        fprintf(stderr, "Error: Expected section.key=value, got '%s'\n", assignment);
+        return -1;
+    }
+    *eq = '\0';
+    *dot = '\0';
+    return config_set(config_trim(text), config_trim(dot + 1), config_trim(eq + 1));
+}
+
+/*==============================================================================
+ * Config Files
+ *============================================================================*/
+
+/**
+ * @brief Loads an INI file: "[section]" headers and "key = value" lines.
+ */
+static int config_load_ini(char *text)
+{
+    char section[64] = "";
+    int errors = 0;
+
+    /* blank lines count too, so walk the lines rather than strtok them */
+    for (char *line = text, *next; line; line = next, config_line++) {
+        next = strchr(line, '\n');
+        if (next)
+            *next++ = '\0';
+        char *comment = strpbrk(line, "#;");
+        if (comment)
+            *comment = '\0';
+        line = config_trim(line);
+        if (!*line)
+            continue;
+
+        if (*line == '[') {
+            char *close = strchr(line, ']');
+            if (!close) {
+                config_error_start();
+                fprintf(stderr, "unterminated section header\n");
+                errors++;
+                continue;
+            }
+            *close = '\0';
+            snprintf(section, sizeof(section), "%s", config_trim(line + 1));
+            continue;
+        }
+        char *eq = strchr(line, '=');
+        if (!eq || !*section) {
+            config_error_start();
+            fprintf(stderr, "expected key = value inside a section\n");
+            errors++;
+            continue;
+        }
+        *eq = '\0';
+        if (config_set(section, config_trim(line), config_trim(eq + 1)) != 0)
+            errors++;
+    }
+    return errors;
+}
+
+/* JSON reader position */
+typedef struct Json_Reader {
+    const char *p;
+} Json_Reader;
+
+static void json_skip_space(Json_Reader *r)
+{
+    for (; isspace((unsigned char)*r->p); r->p++) {
+        if (*r->p == '\n')
+            config_line++;
+    }
+}
+
+/**
+ * @brief Copies the next string or bare scalar (number, true, false) into
+ * 'buf'.
+ * @return 0, or -1 on a syntax error.
+ */
+static int json_read_token(Json_Reader *r, char *buf, size_t size)
+{
+    size_t n = 0;
+
+    json_skip_space(r);
+    if (*r->p == '"') {
+        for (r->p++; *r->p && *r->p != '"'; r->p++) {
+            if (n + 1 < size)
+                buf[n++] = *r->p;
+        }
+        if (*r->p != '"')
+            return -1;
+        r->p++;
+    } else {
+        for (; isalnum((unsigned char)*r->p) || *r->p == '-' || *r->p == '+' || *r->p == '.'; r->p++) {
+            if (n + 1 < size)
+                buf[n++] = *r->p;
+        }
+        if (n == 0)
+            return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Loads a JSON file: an object whose members are section objects
+ * holding string, number or boolean values.
+ */
+static int config_load_json(char *text)
+{
+    Json_Reader r = { text };
+    int errors = 0;
+
+    json_skip_space(&r);
+    if (*r.p++ != '{')
+        goto syntax;
+    json_skip_space(&r);
+    while (*r.p != '}') {
+        char section[64], key[64], value[64];
+        if (json_read_token(&r, section, sizeof(section)) != 0)
+            goto syntax;
+        json_skip_space(&r);
+        if (*r.p++ != ':')
+            goto syntax;
+        json_skip_space(&r);
+        if (*r.p++ != '{')
+            goto syntax;
+        json_skip_space(&r);
+        while (*r.p != '}') {
+            if (json_read_token(&r, key, sizeof(key)) != 0)
+                goto syntax;
+            json_skip_space(&r);
+            if (*r.p++ != ':' || json_read_token(&r, value, sizeof(value)) != 0)
+                goto syntax;
+            if (config_set(section, key, value) != 0)
+                errors++;
+            json_skip_space(&r);
+            if (*r.p == ',') {
+                r.p++;
+                json_skip_space(&r);
+            } else if (*r.p != '}') {
+                goto syntax;
+            }
+        }
+        r.p++;
+        json_skip_space(&r);
+        if (*r.p == ',') {
+            r.p++;
+            json_skip_space(&r);
+        } else if (*r.p != '}') {
+            goto syntax;
+        }
+    }
+    return errors;
+
+syntax:
+    config_error_start();
+    fprintf(stderr, "JSON syntax error\n");
+    return errors + 1;
+}
+
+/**
+ * @brief Loads a config file, INI or JSON; exits on any error.
+ */
+void config_load_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open config file %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(len + 1);
+    if (!text || fread(text, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "Error: Can't read config file %s\n", path);
+        exit(1);
+    }
+    text[len] = '\0';
+    fclose(f);
+
+    const char *ext = strrchr(path, '.');
+    char *first = text + strspn(text, " \t\r\n");
+    config_file = path;
+    config_line = 1;
+    int errors = (ext && strcasecmp(ext, ".json") == 0) || *first == '{' ?
+        config_load_json(text) : config_load_ini(text);
+    config_file = NULL;
+    free(text);
+    if (errors)
+        exit(1);
+}
+
+/*==============================================================================
+ * Command Line
+ *============================================================================*/
+
+/**
+ * @brief Prints the command line usage and every option with its default.
+ */
+static void config_usage(const char *prog)
+{
+    printf("usage: %s [-c file] [--section.key=value ...] <program_file_1> ...\n\n", prog);
+    printf("options (current value):\n");
+    for (int i = 0; i < CONFIG_NUM_OPTIONS; i++) {
+        const Config_Option *opt = &config_options[i];
+        int v = *config_field(opt);
+        printf("  --%s.%s=", opt->section, opt->key);
+        if (opt->type == OPT_ENUM) {
+            for (int n = 0; opt->names[n]; n++)
+                printf("%s%s", n ? "|" : "", opt->names[n]);
+            printf(" (%s)\n", opt->names[v]);
+        } else {
+            printf("%s (%d)\n", opt->type == OPT_BOOL ? "0|1" : "N", v);
+        }
+    }
+}
+
+/**
+ * @brief Applies the options at the start of the command line, in order,
+ * then validates the result. Exits on any error.
+ * @return the index of the first program file in argv.
+ */
+int config_parse_args(int argc, char *argv[])
+{
+    int i = 1;
+    int errors = 0;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        char *arg = argv[i];
+        if (strcmp(arg, "--") == 0) {
+            i++;
+            break;
+        }
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            config_usage(argv[0]);
+            exit(0);
+        }
+        if (strcmp(arg, "-c") == 0 || strcmp(arg, "--config") == 0) {
+            if (++i >= argc) {
+                fprintf(stderr, "Error: %s needs a file name\n", arg);
+                exit(1);
+            }
+            config_load_file(argv[i]);
+            continue;
+        }
+        if (strncmp(arg, "--config=", 9) == 0) {
+            config_load_file(arg + 9);
+            continue;
+        }
+        if (arg[1] != '-' || config_apply(arg + 2) != 0)
+            errors++;
+    }
+    if (errors) {
+        fprintf(stderr, "Run %s --help for the list of options\n", argv[0]);
+        exit(1);
+    }
+    config_validate();
+    return i;
+}
+
+/*==============================================================================
+ * Validation and Output
+ *============================================================================*/
+
+/**
+ * @brief Checks one cache level; returns the number of problems reported.
+ */
+static int config_check_cache(const char *name, const Cache_Config *c)
+{
+    int errors = 0;
+
+    if (!cache_valid_geometry(c->size, c->block_size, c->assoc)) {
+        fprintf(stderr, "Error: %s: invalid geometry (%d bytes, %d-byte blocks, %d ways)\n",
+                name, c->size, c->block_size, c->assoc);
+        errors++;
+    }
+    if (c->replacement == REPLACEMENT_PLRU && ((c->assoc & (c->assoc - 1)) != 0 || c->assoc > 64)) {
+        fprintf(stderr, "Error: %s: PLRU needs a power-of-two associativity up to 64\n", name);
+        errors++;
+    }
+    if (c->victim > 0 && c->victim_latency <= 0) {
+        fprintf(stderr, "Error: %s: victim cache latency must be positive\n", name);
+        errors++;
+    }
+    if (c->set_profile < 0) {
+        fprintf(stderr, "Error: %s: set_profile window may not be negative\n", name);
+        errors++;
+    }
+    return errors;
+}
+
+/**
+ * @brief Checks a whole configuration, reporting every problem.
+ * @return the number of problems found.
+ */
+int config_check(const Sim_Config *c)
+{
+    int errors = 0;
+
+    errors += config_check_cache("icache", &c->icache);
+    errors += config_check_cache("dcache", &c->dcache);
+    errors += config_check_cache("l2", &c->l2);
+    if (c->llc.size > 0)
+        errors += config_check_cache("llc", &c->llc);
+
+    /* blocks may only grow towards memory, and exclusive levels move whole
+     * blocks, so they must match the level above */
+    if (c->l2.block_size < c->icache.block_size || c->l2.block_size < c->dcache.block_size ||
+            (c->l2.inclusion == INCLUSION_EXCLUSIVE &&
+             (c->l2.block_size != c->icache.block_size || c->l2.block_size != c->dcache.block_size))) {
+        fprintf(stderr, "Error: l2: block size %d does not fit the L1 block sizes\n", c->l2.block_size);
+        errors++;
+    }
+    if (c->llc.size > 0 && (c->llc.block_size < c->l2.block_size ||
+            (c->llc.inclusion == INCLUSION_EXCLUSIVE && c->llc.block_size != c->l2.block_size))) {
+        fprintf(stderr, "Error: llc: block size %d does not fit the L2 block size\n", c->llc.block_size);
+        errors++;
+    }
+    if ((c->btb_entries & (c->btb_entries - 1)) != 0 || (c->bpred_entries & (c->bpred_entries - 1)) != 0) {
+        fprintf(stderr, "Error: bpred: BTB and table entries must be powers of two\n");
+        errors++;
+    }
+    if (c->bpred_history > 30) {
+        fprintf(stderr, "Error: bpred: history may be at most 30 bits\n");
+        errors++;
+    }
+    return errors;
+}
+
+/**
+ * @brief Checks sim_config; exits if there is any problem.
+ */
+void config_validate()
+{
+    if (config_check(&sim_config))
+        exit(1);
+}
+
+/**
+ * @brief Prints the configuration, one line per section, in the same
+ * key=value form the command line accepts.
+ */
+void config_print()
+{
+    const char *section = NULL;
+
+    printf("Configuration:");
+    for (int i = 0; i < CONFIG_NUM_OPTIONS; i++) {
+        const Config_Option *opt = &config_options[i];
+        /* an absent LLC has nothing else to show */
+        if (strcmp(opt->section, "llc") == 0 && sim_config.llc.size == 0 && strcmp(opt->key, "size") != 0)
+            continue;
+        if (!section || strcmp(section, opt->section) != 0) {
+            section = opt->section;
+            printf("\n  %s:", section);
+        }
+        int v = *config_field(opt);
+        if (opt->type == OPT_ENUM)
+            printf(" %s=%s", opt->key, opt->names[v]);
+        else
+            printf(" %s=%d", opt->key, v);
+    }
+    printf("\n\n");
+}
+
+/*==============================================================================
+ * Building the Hierarchy
+ *============================================================================*/
+
+/**
+ * @brief Creates one cache level as configured, apart from its place in the
+ * hierarchy.
+ */
+static Cache *config_create_cache(const Cache_Config *c)
+{
+    Cache *cache = cache_create(c->size, c->block_size, c->assoc, c->replacement, c->insertion);
+    cache->latency = c->latency;
+    cache->inclusion = c->inclusion;
+    cache->indexing = c->indexing;
+    cache->write_policy = c->write_policy;
+    cache->write_allocate = c->write_allocate;
+    cache_set_write_buffer(cache, c->write_buffer);
+    cache_set_victim_cache(cache, c->victim, c->victim_latency);
+    /* miss ratio curves at this block size: fully associative, and over the
+     * associativity at this set count */
+    if (c->mrc > 0) {
+        cache_add_stack_profile(cache, stackdist_create(c->block_size, 1, c->mrc));
+        if (cache->num_sets > 1)
+            cache_add_stack_profile(cache, stackdist_create(c->block_size, cache->num_sets, c->mrc));
+    }
+    if (c->classify)
+        cache->miss_class = missclass_create(cache->size / cache->block_size, cache->block_size);
+    if (c->set_profile > 0)
+        cache->set_profile = setprof_create(cache->num_sets, c->set_profile);
+    return cache;
+}
+
+/**
+ * @brief Builds the cache hierarchy a configuration describes. Memory
+ * latency and tag-only mode are global and left to the caller.
+ */
+void config_create_caches(const Sim_Config *cfg, Cache_Hierarchy *h)
+{
+    /* Split L1s (default: 8KB I-cache with random replacement, 64KB
+     * D-cache, both 4-way with 32-byte blocks) */
+    h->icache = config_create_cache(&cfg->icache);
+    h->dcache = config_create_cache(&cfg->dcache);
+
+    /* Unified L2 (default: 8-way, 256KB, 64-byte blocks, 12-cycle latency) */
+    h->l2 = config_create_cache(&cfg->l2);
+    cache_attach(h->icache, h->l2);
+    cache_attach(h->dcache, h->l2);
+
+    /* Optional shared LLC below the L2 (size 0 = none) */
+    h->llc = NULL;
+    if (cfg->llc.size > 0) {
+        h->llc = config_create_cache(&cfg->llc);
+        cache_attach(h->l2, h->llc);
+    }
+
+    /* Non-blocking L1s (0 MSHRs = blocking) */
+    cache_set_mshrs(h->icache, cfg->icache.mshrs);
+    cache_set_mshrs(h->dcache, cfg->dcache.mshrs);
+
+    /* D-cache prefetcher, trained by the memory stage */
+    if (cfg->dcache.prefetcher != PREFETCH_NONE)
+        cache_set_prefetcher(h->dcache, prefetch_create(cfg->dcache.prefetcher,
+                    cfg->dcache.prefetch_degree, cfg->dcache.prefetch_distance));
+}
+
+/**
+ * @brief Destroys every cache of a hierarchy.
+ */
+void config_destroy_caches(Cache_Hierarchy *h)
+{
+    cache_destroy(h->icache);
+    cache_destroy(h->dcache);
+    cache_destroy(h->l2);
+    cache_destroy(h->llc);
+    memset(h, 0, sizeof(*h));
+}
+
+/**
+ * @brief Writes the per-set profile of each level that has one to
+ * <prefix>.<section>.csv (see setprof.h).
+ */
+void config_write_set_profiles(const Cache_Hierarchy *h, const char *prefix)
+{
+    const Cache *levels[] = { h->icache, h->dcache, h->l2, h->llc };
+    const char *names[] = { "icache", "dcache", "l2", "llc" };
+    char path[1024];
+
+    for (int i = 0; i < 4; i++) {
+        if (!levels[i] || !levels[i]->set_profile)
+            continue;
+        snprintf(path, sizeof(path), "%s.%s.csv", prefix, names[i]);
+        FILE *f = fopen(path, "w");
+        if (!f) {
+            fprintf(stderr, "Error: Can't open set profile file %s\n", path);
+            continue;
+        }
+        setprof_write(levels[i]->set_profile, f);
+        fclose(f);
+    }
+}
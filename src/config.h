@@ -0,0 +1,81 @@
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include "cache.h"
+
+/* Runtime configuration
+ *
+ * Every cache and core parameter lives in sim_config, which starts out with
+ * the compile-time defaults from pipe.h and is then overridden, in order, by
+ * the command line:
+ *
+ *   sim [-c file] [--section.key=value ...] program.x ...
+ *
+ * A config file is INI (sections in brackets, "key = value" lines, '#' or
+ * ';' comments) or JSON (an object of section objects), chosen by a .json
+ * extension or a leading '{'. Sizes accept K/M/G suffixes and enumerations
+ * take their lower-case names. Sections are icache, dcache, l2, llc, memory,
+ * core and bpred; "sim --help" lists every key. The configuration is validated
+ * before the simulator starts and echoed with the statistics. */
+
+typedef struct Cache_Config {
+    int size;               /* bytes (0 = level absent, LLC only) */
+    int block_size;
+    int assoc;
+    int replacement;        /* ReplacementPolicy */
+    int insertion;          /* InsertionPolicy */
+    int indexing;           /* IndexFunction */
+    int latency;            /* cycles to service a miss from the level above */
+    int inclusion;          /* InclusionPolicy */
+    int write_policy;       /* WritePolicy */
+    int write_allocate;
+    int write_buffer;       /* entries (0 = ideal) */
+    int mshrs;              /* 0 = blocking (L1s) */
+    int victim;             /* victim cache entries (0 = none) */
+    int victim_latency;
+    int prefetcher;         /* PrefetchType (D-cache) */
+    int prefetch_degree;
+    int prefetch_distance;
+    int mrc;                /* LRU miss ratio curve: profile 1 in N blocks (0 = off) */
+    int classify;           /* 3C miss classification */
+    int set_profile;        /* per-set statistics: window in demand accesses (0 = off) */
+} Cache_Config;
+
+typedef struct Sim_Config {
+    Cache_Config icache, dcache, l2, llc;
+    int mem_latency;        /* main memory */
+    int tag_only;           /* see cache_tag_only */
+    int mult_latency;       /* multiplier */
+    int div_latency;        /* divider */
+    int ff_warm;            /* warm the caches while fast-forwarding */
+    int bpred;              /* BpredType */
+    int btb_entries;
+    int bpred_entries;      /* counters per direction table */
+    int bpred_history;      /* global history bits (gshare) */
+    int ras_entries;        /* return address stack (0 = none) */
+} Sim_Config;
+
+extern Sim_Config sim_config;
+
+/* the simulated hierarchy: split L1s over a unified L2 and an optional LLC */
+typedef struct Cache_Hierarchy {
+    Cache *icache, *dcache, *l2, *llc;  /* llc is NULL if absent */
+} Cache_Hierarchy;
+
+/* parses and validates the command line; returns the index of the first
+ * program file in argv */
+int config_parse_args(int argc, char *argv[]);
+void config_load_file(const char *path);
+int config_set(const char *section, const char *key, const char *value);
+int config_apply(const char *assignment);
+int config_check(const Sim_Config *c);
+void config_validate();
+void config_print();
+void config_create_caches(const Sim_Config *cfg, Cache_Hierarchy *h);
+void config_destroy_caches(Cache_Hierarchy *h);
+
+/* writes the per-set profile of each level that has one to
+ * <prefix>.<section>.csv */
+void config_write_set_profiles(const Cache_Hierarchy *h, const char *prefix);
+
+#endif
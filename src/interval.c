@@ -0,0 +1,194 @@
+#include "interval.h"
+#include "pipe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERVAL_LEVELS 4
+
+int interval_on = 0;
+
+/* counters at the start of the current interval */
+typedef struct Interval_Snapshot {
+    uint64_t cycles, retired, flushes;
+    uint64_t stalls[4];     /* I-cache, D-cache, load-use, multiply/divide */
+    uint64_t accesses[INTERVAL_LEVELS], hits[INTERVAL_LEVELS], misses[INTERVAL_LEVELS];
+} Interval_Snapshot;
+
+static const char *const interval_stall_names[] = { "stall_icache", "stall_dcache", "stall_load_use", "stall_muldiv" };
+static const char *const interval_level_names[] = { "icache", "dcache", "l2", "llc" };
+
+static FILE *interval_file;
+static char *interval_buffer;
+static int interval_json;
+static int interval_by_insts;   /* period counts retired instructions, not cycles */
+static uint64_t interval_period, interval_next;
+static Cache *interval_caches[INTERVAL_LEVELS];
+static Interval_Snapshot interval_last;
+
+static void interval_take(Interval_Snapshot *s)
+{
+    s->cycles = stat_cycles;
+    s->retired = stat_inst_retire;
+    s->flushes = stat_squash;
+    s->stalls[0] = pipe.stall_icache;
+    s->stalls[1] = pipe.stall_dcache;
+    s->stalls[2] = pipe.stall_load_use;
+    s->stalls[3] = pipe.stall_muldiv;
+    for (int i = 0; i < INTERVAL_LEVELS; i++) {
+        Cache *c = interval_caches[i];
+        s->accesses[i] = c ? c->stats.accesses : 0;
+        s->hits[i] = c ? c->stats.hits : 0;
+        s->misses[i] = c ? c->stats.misses : 0;
+    }
+}
+
+static uint64_t interval_env(const char *name)
+{
+    const char *v = getenv(name);
+    if (!v || !*v)
+        return 0;
+    long long n = strtoll(v, NULL, 0);
+    if (n <= 0) {
+        fprintf(stderr, "Error: %s must be a positive number\n", name);
+        exit(1);
+    }
+    return (uint64_t)n;
+}
+
+/**
+ * @brief Opens the file named by SIM_INTERVAL_FILE, if set, and starts
+ * sampling the given hierarchy.
+ */
+void interval_init(const Cache_Hierarchy *h)
+{
+    const char *path = getenv("SIM_INTERVAL_FILE");
+    if (!path || !*path || interval_file)
+        return;
+
+    interval_period = interval_env("SIM_INTERVAL_CYCLES");
+    if (!interval_period) {
+        interval_period = interval_env("SIM_INTERVAL_INSTS");
+        interval_by_insts = interval_period > 0;
+    }
+    if (!interval_period)
+        interval_period = INTERVAL_DEFAULT_CYCLES;
+
+    interval_file = fopen(path, "w");
+    if (!interval_file) {
+        fprintf(stderr, "Error: Can't open interval statistics file %s\n", path);
+        return;
+    }
+    interval_buffer = malloc(INTERVAL_BUFFER);
+    if (interval_buffer)
+        setvbuf(interval_file, interval_buffer, _IOFBF, INTERVAL_BUFFER);
+    const char *ext = strrchr(path, '.');
+    interval_json = ext && (strcmp(ext, ".json") == 0 || strcmp(ext, ".jsonl") == 0);
+
+    interval_caches[0] = h->icache;
+    interval_caches[1] = h->dcache;
+    interval_caches[2] = h->l2;
+    interval_caches[3] = h->llc;
+
+    if (!interval_json) {
+        fprintf(interval_file, "cycle,instructions,ipc,flushes");
+        for (int i = 0; i < 4; i++)
+            fprintf(interval_file, ",%s", interval_stall_names[i]);
+        for (int i = 0; i < INTERVAL_LEVELS; i++) {
+            if (interval_caches[i])
+                fprintf(interval_file, ",%s_hit_rate,%s_mpki", interval_level_names[i], interval_level_names[i]);
+        }
+        fprintf(interval_file, "\n");
+    }
+
+    interval_take(&interval_last);
+    interval_next = interval_period;
+    interval_on = 1;
+    atexit(interval_close);
+}
+
+/**
+ * @brief Appends the row for the interval since the last one.
+ */
+static void interval_write(const Interval_Snapshot *now)
+{
+    const Interval_Snapshot *last = &interval_last;
+    uint64_t cycles = now->cycles - last->cycles, retired = now->retired - last->retired;
+    double ipc = cycles ? (double)retired / cycles : 0.0;
+    FILE *f = interval_file;
+
+    if (interval_json)
+        fprintf(f, "{\"cycle\":%llu,\"instructions\":%llu,\"ipc\":%.4f,\"flushes\":%llu",
+                (unsigned long long)now->cycles, (unsigned long long)now->retired, ipc,
+                (unsigned long long)(now->flushes - last->flushes));
+    else
+        fprintf(f, "%llu,%llu,%.4f,%llu", (unsigned long long)now->cycles, (unsigned long long)now->retired,
+                ipc, (unsigned long long)(now->flushes - last->flushes));
+
+    for (int i = 0; i < 4; i++) {
+        unsigned long long stalls = now->stalls[i] - last->stalls[i];
+        if (interval_json)
+            fprintf(f, ",\"%s\":%llu", interval_stall_names[i], stalls);
+        else
+            fprintf(f, ",%llu", stalls);
+    }
+
+    for (int i = 0; i < INTERVAL_LEVELS; i++) {
+        if (!interval_caches[i])
+            continue;
+        uint64_t accesses = now->accesses[i] - last->accesses[i];
+        uint64_t hits = now->hits[i] - last->hits[i];
+        double mpki = retired ? (now->misses[i] - last->misses[i]) * 1000.0 / retired : 0.0;
+        const char *name = interval_level_names[i];
+        if (interval_json) {
+            if (accesses)
+                fprintf(f, ",\"%s_hit_rate\":%.4f", name, (double)hits / accesses);
+            else
+                fprintf(f, ",\"%s_hit_rate\":null", name);
+            fprintf(f, ",\"%s_mpki\":%.3f", name, mpki);
+        } else {
+            if (accesses)
+                fprintf(f, ",%.4f", (double)hits / accesses);
+            else
+                fprintf(f, ",");
+            fprintf(f, ",%.3f", mpki);
+        }
+    }
+    fprintf(f, interval_json ? "}\n" : "\n");
+}
+
+/**
+ * @brief Writes a row if the current interval is over (called through
+ * INTERVAL_TICK()).
+ */
+void interval_sample()
+{
+    uint64_t now = interval_by_insts ? stat_inst_retire : stat_cycles;
+    if (now < interval_next)
+        return;
+
+    Interval_Snapshot snap;
+    interval_take(&snap);
+    interval_write(&snap);
+    interval_last = snap;
+    interval_next = now + interval_period;
+}
+
+/**
+ * @brief Writes the last, partial interval and closes the file.
+ */
+void interval_close()
+{
+    if (!interval_file)
+        return;
+
+    interval_on = 0;
+    Interval_Snapshot snap;
+    interval_take(&snap);
+    if (snap.cycles > interval_last.cycles)
+        interval_write(&snap);
+    fclose(interval_file);
+    interval_file = NULL;
+    free(interval_buffer);
+    interval_buffer = NULL;
+}
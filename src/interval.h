@@ -0,0 +1,40 @@
+#ifndef _INTERVAL_H_
+#define _INTERVAL_H_
+
+#include "config.h"
+#include <stdint.h>
+
+/* Interval statistics
+ *
+ * Samples the simulation periodically so that phase behaviour shows up: at
+ * the end of every interval one row is appended to the file named by
+ * SIM_INTERVAL_FILE (read at pipe_init() time; sampling is off when it is
+ * unset). The interval is SIM_INTERVAL_CYCLES cycles or, if that is unset,
+ * SIM_INTERVAL_INSTS retired instructions (default: 100000 cycles). A file
+ * name ending in .json or .jsonl gives JSON lines, anything else CSV with a
+ * header row.
+ *
+ * Each row holds the cycle and retired instruction count at its end, then,
+ * over the interval: IPC, flushes, stall cycles by cause (see Pipe_State)
+ * and, per cache level, the hit rate (empty / null without accesses) and
+ * misses per thousand retired instructions. A last, partial interval is
+ * written at exit. Rows go through a large stdio buffer, and with sampling
+ * off the only cost is one test per cycle. */
+
+#define INTERVAL_DEFAULT_CYCLES 100000
+#define INTERVAL_BUFFER (1 << 20)   /* output buffer bytes */
+
+extern int interval_on;
+
+void interval_init(const Cache_Hierarchy *h);
+void interval_sample();
+void interval_close();
+
+/* called once per cycle: samples at the end of each interval */
+#define INTERVAL_TICK()                                                        \
+    do {                                                                       \
+        if (interval_on)                                                       \
+            interval_sample();                                                 \
+    } while (0)
+
+#endif
@@ -0,0 +1,130 @@
+#include "missclass.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static void *missclass_alloc(size_t size)
+{
+    void *p = calloc(1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate miss classifier\n");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * @brief Creates a classifier for a cache of 'blocks' blocks of
+ * 'block_size' bytes.
+ */
+Miss_Classifier *missclass_create(int blocks, int block_size)
+{
+    if (blocks <= 0 || block_size < CACHE_MIN_BLOCK || block_size > CACHE_MAX_BLOCK ||
+            (block_size & (block_size - 1)) != 0) {
+        fprintf(stderr, "Error: Invalid miss classifier (%d blocks of %d bytes)\n", blocks, block_size);
+        exit(1);
+    }
+    Miss_Classifier *mc = missclass_alloc(sizeof(Miss_Classifier));
+    mc->offset_bits = (int)log2(block_size);
+    mc->capacity = blocks;
+    blockmap_init(&mc->map, 2 * mc->capacity);
+    mc->block = missclass_alloc(mc->capacity * sizeof(uint32_t));
+    mc->prev = missclass_alloc(mc->capacity * sizeof(uint32_t));
+    mc->next = missclass_alloc(mc->capacity * sizeof(uint32_t));
+    mc->head = mc->tail = MISSCLASS_NONE;
+    return mc;
+}
+
+void missclass_destroy(Miss_Classifier *mc)
+{
+    if (!mc)
+        return;
+    blockmap_free(&mc->map);
+    free(mc->block);
+    free(mc->prev);
+    free(mc->next);
+    free(mc);
+}
+
+/*==============================================================================
+ * Shadow Cache
+ *============================================================================*/
+
+static void missclass_unlink(Miss_Classifier *mc, uint32_t n)
+{
+    if (mc->prev[n] != MISSCLASS_NONE)
+        mc->next[mc->prev[n]] = mc->next[n];
+    else
+        mc->head = mc->next[n];
+    if (mc->next[n] != MISSCLASS_NONE)
+        mc->prev[mc->next[n]] = mc->prev[n];
+    else
+        mc->tail = mc->prev[n];
+}
+
+static void missclass_push_front(Miss_Classifier *mc, uint32_t n)
+{
+    mc->prev[n] = MISSCLASS_NONE;
+    mc->next[n] = mc->head;
+    if (mc->head != MISSCLASS_NONE)
+        mc->prev[mc->head] = n;
+    else
+        mc->tail = n;
+    mc->head = n;
+}
+
+/**
+ * @brief Brings a block into the shadow cache, evicting the least recently
+ * used one if it is full.
+ * @return the block's node.
+ */
+static uint32_t missclass_fill(Miss_Classifier *mc, uint32_t block)
+{
+    uint32_t n;
+    if (mc->used < mc->capacity) {
+        n = mc->used++;
+    } else {
+        n = mc->tail;
+        missclass_unlink(mc, n);
+        mc->map.value[blockmap_find(&mc->map, mc->block[n])] = MISSCLASS_ABSENT;
+    }
+    mc->block[n] = block;
+    missclass_push_front(mc, n);
+    return n;
+}
+
+/*==============================================================================
+ * Classification
+ *============================================================================*/
+
+/**
+ * @brief Replays one demand access, and classifies it if the real cache
+ * missed.
+ */
+void missclass_access(Miss_Classifier *mc, uint32_t addr, int miss)
+{
+    uint32_t block = addr >> mc->offset_bits;
+    uint32_t i = blockmap_find(&mc->map, block);
+
+    if (!mc->map.key[i]) {
+        /* first reference */
+        if (miss)
+            mc->compulsory++;
+        i = blockmap_insert(&mc->map, block);
+        mc->map.value[i] = missclass_fill(mc, block);
+    } else if (mc->map.value[i] == MISSCLASS_ABSENT) {
+        /* evicted from the shadow cache */
+        if (miss)
+            mc->capacity_misses++;
+        mc->map.value[i] = missclass_fill(mc, block);
+    } else {
+        /* resident in the shadow cache */
+        if (miss)
+            mc->conflict++;
+        uint32_t n = mc->map.value[i];
+        if (mc->head != n) {
+            missclass_unlink(mc, n);
+            missclass_push_front(mc, n);
+        }
+    }
+}
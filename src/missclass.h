@@ -0,0 +1,54 @@
+#ifndef _MISSCLASS_H_
+#define _MISSCLASS_H_
+
+#include "cache.h"
+#include "blockmap.h"
+#include <stdint.h>
+
+/* 3C miss classification
+ *
+ * A Miss_Classifier sorts the misses of one cache into the three classes of
+ * Hill's model, by replaying the cache's demand accesses against two
+ * references:
+ *
+ *   compulsory  the block was never referenced before (it would miss even
+ *               in an infinite cache)
+ *   capacity    otherwise, a fully associative LRU cache of the same
+ *               capacity misses as well
+ *   conflict    the fully associative cache hits: the miss is due to the
+ *               placement (set mapping or replacement) of the real cache
+ *
+ * Both references share one block map (blockmap.h) from block number to the
+ * block's node in the shadow cache (or MISSCLASS_ABSENT once it has been
+ * evicted); a block is never removed from the map, so the map is also the
+ * set of blocks seen. The shadow cache is an intrusive doubly linked list
+ * over a fixed node array, most recently used first, so an access costs
+ * one or two map probes and a few index updates.
+ *
+ * Accesses that hit in the real cache only update the shadow cache. A hit
+ * that the shadow cache would miss (the real cache doing better than LRU)
+ * is not counted: the classes add up to the cache's misses. */
+
+#define MISSCLASS_ABSENT 0xFFFFFFFFu /* seen, not in the shadow cache */
+#define MISSCLASS_NONE   0xFFFFFFFFu /* end of the shadow list */
+
+typedef struct Miss_Classifier {
+    int offset_bits;
+    uint32_t capacity;      /* shadow cache blocks */
+    Block_Map map;          /* block -> shadow node */
+    /* shadow fully associative LRU cache */
+    uint32_t *block;        /* [capacity] block held by each node */
+    uint32_t *prev, *next;  /* [capacity] LRU list links */
+    uint32_t head, tail;    /* most / least recently used */
+    uint32_t used;          /* nodes in use */
+    /* Statistics */
+    uint64_t compulsory;
+    uint64_t capacity_misses;
+    uint64_t conflict;
+} Miss_Classifier;
+
+Miss_Classifier *missclass_create(int blocks, int block_size);
+void missclass_destroy(Miss_Classifier *mc);
+void missclass_access(Miss_Classifier *mc, uint32_t addr, int miss);
+
+#endif
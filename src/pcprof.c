@@ -0,0 +1,186 @@
+#include "pcprof.h"
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int pc_profile_on = 0;
+
+static Pc_Profile_Entry *pc_profile_table;
+static uint32_t pc_profile_size;    /* power of two */
+static uint32_t pc_profile_count;
+static uint32_t pc_profile_text;    /* start of the text segment */
+static const char *pc_profile_path;
+
+static Pc_Profile_Entry *pc_profile_alloc(uint32_t size)
+{
+    Pc_Profile_Entry *t = calloc(size, sizeof(Pc_Profile_Entry));
+    if (!t) {
+        fprintf(stderr, "Error: Failed to allocate PC profile\n");
+        exit(1);
+    }
+    return t;
+}
+
+/**
+ * @brief Starts profiling if SIM_PC_PROFILE is set, for a program of
+ * 'text_words' instructions loaded at 'text_start'.
+ */
+void pc_profile_init(uint32_t text_start, int text_words)
+{
+    const char *path = getenv("SIM_PC_PROFILE");
+    if (!path || !*path || pc_profile_on)
+        return;
+
+    pc_profile_path = path;
+    pc_profile_text = text_start;
+    pc_profile_size = 1024;
+    while (pc_profile_size < 2 * (uint32_t)text_words)
+        pc_profile_size *= 2;
+    pc_profile_table = pc_profile_alloc(pc_profile_size);
+    pc_profile_on = 1;
+    atexit(pc_profile_close);
+}
+
+static uint32_t pc_profile_slot(uint32_t pc)
+{
+    uint32_t i = (pc >> 2) & (pc_profile_size - 1);
+    while (pc_profile_table[i].pc && pc_profile_table[i].pc != pc)
+        i = (i + 1) & (pc_profile_size - 1);
+    return i;
+}
+
+/**
+ * @brief Doubles the table, keeping it at most half full.
+ */
+static void pc_profile_grow()
+{
+    Pc_Profile_Entry *old = pc_profile_table;
+    uint32_t old_size = pc_profile_size;
+
+    pc_profile_size *= 2;
+    pc_profile_table = pc_profile_alloc(pc_profile_size);
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old[i].pc)
+            pc_profile_table[pc_profile_slot(old[i].pc)] = old[i];
+    }
+    free(old);
+}
+
+/**
+ * @brief Returns the counters of the instruction at 'pc', adding it on
+ * first use.
+ */
+Pc_Profile_Entry *pc_profile_find(uint32_t pc)
+{
+    uint32_t i = pc_profile_slot(pc);
+    if (!pc_profile_table[i].pc) {
+        if (++pc_profile_count * 2 > pc_profile_size) {
+            pc_profile_grow();
+            i = pc_profile_slot(pc);
+        }
+        pc_profile_table[i].pc = pc;
+    }
+    return &pc_profile_table[i];
+}
+
+/*==============================================================================
+ * Reports
+ *============================================================================*/
+
+static uint64_t pc_profile_stalls(const Pc_Profile_Entry *e)
+{
+    return e->stall_cycles + e->load_use_stalls;
+}
+
+/* most stall cycles first, then most D-cache misses, then by address */
+static int pc_profile_by_stalls(const void *a, const void *b)
+{
+    const Pc_Profile_Entry *x = *(Pc_Profile_Entry *const *)a, *y = *(Pc_Profile_Entry *const *)b;
+    if (pc_profile_stalls(x) != pc_profile_stalls(y))
+        return pc_profile_stalls(x) < pc_profile_stalls(y) ? 1 : -1;
+    if (x->dcache_misses != y->dcache_misses)
+        return x->dcache_misses < y->dcache_misses ? 1 : -1;
+    return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+static int pc_profile_by_pc(const void *a, const void *b)
+{
+    const Pc_Profile_Entry *x = *(Pc_Profile_Entry *const *)a, *y = *(Pc_Profile_Entry *const *)b;
+    return x->pc < y->pc ? -1 : x->pc > y->pc;
+}
+
+/* word index in the text segment, or -1 outside it */
+static long pc_profile_word(uint32_t pc)
+{
+    return pc >= pc_profile_text ? (long)(pc - pc_profile_text) / 4 : -1;
+}
+
+static void pc_profile_print_top(Pc_Profile_Entry **entries, int top)
+{
+    qsort(entries, pc_profile_count, sizeof(*entries), pc_profile_by_stalls);
+    if ((uint32_t)top > pc_profile_count)
+        top = pc_profile_count;
+
+    printf("PC profile: top %d of %u instructions by stall cycles\n", top, pc_profile_count);
+    printf("  %8s %6s %8s %12s %10s %10s %8s %10s %10s\n", "pc", "word", "inst", "executions",
+            "d_access", "d_miss", "i_miss", "stalls", "load_use");
+    for (int i = 0; i < top; i++) {
+        const Pc_Profile_Entry *e = entries[i];
+        printf("  %08x %6ld %08x %12llu %10llu %10llu %8llu %10llu %10llu\n", e->pc,
+                pc_profile_word(e->pc), mem_read_32(e->pc), (unsigned long long)e->executions,
+                (unsigned long long)e->dcache_accesses, (unsigned long long)e->dcache_misses,
+                (unsigned long long)e->icache_misses, (unsigned long long)e->stall_cycles,
+                (unsigned long long)e->load_use_stalls);
+    }
+    printf("\n");
+}
+
+static void pc_profile_write_csv(Pc_Profile_Entry **entries)
+{
+    FILE *f = fopen(pc_profile_path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open PC profile file %s\n", pc_profile_path);
+        return;
+    }
+    qsort(entries, pc_profile_count, sizeof(*entries), pc_profile_by_pc);
+    fprintf(f, "pc,word,instruction,executions,dcache_accesses,dcache_misses,icache_misses,"
+            "stall_cycles,load_use_stalls\n");
+    for (uint32_t i = 0; i < pc_profile_count; i++) {
+        const Pc_Profile_Entry *e = entries[i];
+        fprintf(f, "0x%08x,%ld,0x%08x,%llu,%llu,%llu,%llu,%llu,%llu\n", e->pc, pc_profile_word(e->pc),
+                mem_read_32(e->pc), (unsigned long long)e->executions,
+                (unsigned long long)e->dcache_accesses, (unsigned long long)e->dcache_misses,
+                (unsigned long long)e->icache_misses, (unsigned long long)e->stall_cycles,
+                (unsigned long long)e->load_use_stalls);
+    }
+    fclose(f);
+}
+
+/**
+ * @brief Prints the top-N report and writes the CSV file (at exit).
+ */
+void pc_profile_close()
+{
+    if (!pc_profile_on)
+        return;
+    pc_profile_on = 0;
+
+    Pc_Profile_Entry **entries = malloc((pc_profile_count + 1) * sizeof(*entries));
+    if (!entries) {
+        fprintf(stderr, "Error: Failed to allocate PC profile\n");
+        return;
+    }
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < pc_profile_size; i++) {
+        if (pc_profile_table[i].pc)
+            entries[n++] = &pc_profile_table[i];
+    }
+
+    const char *top = getenv("SIM_PC_PROFILE_TOP");
+    pc_profile_print_top(entries, top && *top ? atoi(top) : PC_PROFILE_DEFAULT_TOP);
+    pc_profile_write_csv(entries);
+    free(entries);
+    free(pc_profile_table);
+    pc_profile_table = NULL;
+}
@@ -0,0 +1,56 @@
+#ifndef _PCPROF_H_
+#define _PCPROF_H_
+
+#include <stdint.h>
+
+/* Per-instruction profile
+ *
+ * Attributes cache misses and stalls to the static instructions that cause
+ * them. Profiling is on when SIM_PC_PROFILE names a CSV output file at
+ * pc_profile_init() time (once the program is loaded). At exit the
+ * SIM_PC_PROFILE_TOP (default 20) instructions with the most stall cycles
+ * are printed, and the file receives every instruction that was fetched,
+ * in address order, with its word index in the text segment (the line of
+ * the .x file, from 0) so that it can be matched with the .s source.
+ *
+ * Counters, per instruction:
+ *   executions       times it retired
+ *   dcache_accesses  loads/stores performed (once per execution)
+ *   dcache_misses    ... that missed in the D-cache
+ *   icache_misses    fetches of it that missed in the I-cache
+ *   stall_cycles     cycles its I-cache and D-cache misses froze the
+ *                    pipeline (or fetch, with a non-blocking I-cache),
+ *                    counted as the core's stall counters count them, so
+ *                    the column adds up to stall.icache + stall.dcache
+ *   load_use_stalls  cycles it waited in execute for a load's result
+ *
+ * The table is open-addressed on pc / 4 and sized to twice the text
+ * segment, so the program's instructions map to distinct slots and a
+ * lookup is normally a single probe. */
+
+#define PC_PROFILE_DEFAULT_TOP 20
+
+typedef struct Pc_Profile_Entry {
+    uint32_t pc;            /* 0 = empty slot */
+    uint64_t executions;
+    uint64_t dcache_accesses;
+    uint64_t dcache_misses;
+    uint64_t icache_misses;
+    uint64_t stall_cycles;
+    uint64_t load_use_stalls;
+} Pc_Profile_Entry;
+
+extern int pc_profile_on;
+
+void pc_profile_init(uint32_t text_start, int text_words);
+void pc_profile_close();
+Pc_Profile_Entry *pc_profile_find(uint32_t pc);
+
+/* adds 'n' to one counter of the instruction at 'pc' if profiling is on */
+#define PC_PROFILE(pc, field, n)                                               \
+    do {                                                                       \
+        if (pc_profile_on)                                                     \
+            pc_profile_find(pc)->field += (n);                                 \
+    } while (0)
+
+#endif
@@ -1,6 +1,12 @@
 #include "pipe.h"
 #include "shell.h"
 #include "mips.h"
+#include "trace.h"
+#include "config.h"
+#include "addrtrace.h"
+#include "pcprof.h"
+#include "interval.h"
+#include "stats.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -30,357 +36,259 @@ void print_op(Pipe_Op *op)
 
 
 /*==============================================================================
- * Cache Implementation
+ * Pipe_Op Pool
  *============================================================================*/
 
-/**
- * @brief Creates and initializes a cache.
- */
-Cache* cache_create(int size, int block_size, int associativity, int replacement_policy,int insertion_policy) {
-    Cache *cache = malloc(sizeof(Cache));
-    if (!cache) {
-        fprintf(stderr, "Error: Failed to allocate cache\n");
-        exit(1);
-    }
-    cache->size = size;
-    cache->block_size = block_size;
-    cache->associativity = associativity;
-    cache->num_sets = size / (block_size * associativity);
-    cache->replacement_policy = replacement_policy;
-    cache->insertion_policy = insertion_policy;
-
-    // Validate cache parameters
-    if (cache->num_sets <= 0 || (cache->num_sets & (cache->num_sets - 1)) != 0) {
-        fprintf(stderr, "Error: Invalid cache configuration\n");
-        exit(1);
-    }
-    /* Calculate bit fields */
-    cache->offset_bits = (int)log2(block_size);
-    cache->index_bits = (int)log2(cache->num_sets);
-    cache->tag_bits = 32 - cache->index_bits - cache->offset_bits;
-    
-    /* Allocate cache blocks */
-    cache->blocks = malloc(cache->num_sets * sizeof(Cache_Block*));
-    if (!cache->blocks) {
-        fprintf(stderr, "Error: Failed to allocate cache blocks\n");
-        exit(1);
-    }
-    for (int i = 0; i < cache->num_sets; i++) {
-        cache->blocks[i] = malloc(associativity * sizeof(Cache_Block));
-         if (!cache->blocks[i]) {
-            fprintf(stderr, "Error: Failed to allocate cache set %d\n", i);
-            exit(1);
-        }
-        for (int j = 0; j < associativity; j++) {
-            cache->blocks[i][j].valid = 0;
-            cache->blocks[i][j].dirty = 0;
-            cache->blocks[i][j].tag = 0;
-            cache->blocks[i][j].lru_counter = 0;
-            memset(cache->blocks[i][j].data, 0, sizeof(cache->blocks[i][j].data));
-        }
-    }
-    
-    cache->global_lru_counter = 0;
-    cache->accesses = 0;
-    cache->misses = 0;
-    cache->hits = 0;
-    cache->writebacks = 0;
-    
-    return cache;
-}
+#define PIPE_OP_SLOT (((sizeof(Pipe_Op) + CACHE_ARENA_ALIGN - 1) / CACHE_ARENA_ALIGN) * CACHE_ARENA_ALIGN)
+#define PIPE_OP_POISON_BYTE 0xA5
 
 /**
- * @brief Destroys a cache and frees its memory.
+ * @brief Allocates the pool, with every slot free.
  */
-void cache_destroy(Cache *cache) {
-    if (!cache) return;
-
-    for (int i = 0; i < cache->num_sets; i++) {
-        free(cache->blocks[i]);
-    }
-    free(cache->blocks);
-    free(cache);
-}
-/**
- * @brief Helper function to load a block from memory into the cache.
- */
-void cache_load_block(Cache *cache, int way, uint32_t index, uint32_t block_addr) {
-    Cache_Block *block = &cache->blocks[index][way];
-    
-    /* Simulate loading entire block from memory */
-    for (int i = 0; i < cache->block_size / 4; i++) {
-        block->data[i] = mem_read_32(block_addr + i * 4);
+static void pipe_op_pool_init()
+{
+    pipe.op_pool = aligned_alloc(CACHE_ARENA_ALIGN, PIPE_OP_POOL * PIPE_OP_SLOT);
+    if (!pipe.op_pool) {
+        fprintf(stderr, "Error: Failed to allocate Pipe_Op pool\n");
+        exit(1);
     }
+    memset(pipe.op_pool, PIPE_OP_POISON_BYTE, PIPE_OP_POOL * PIPE_OP_SLOT);
+    for (int i = 0; i < PIPE_OP_POOL; i++)
+        pipe.op_free[i] = (Pipe_Op *)(pipe.op_pool + (PIPE_OP_POOL - 1 - i) * PIPE_OP_SLOT);
+    pipe.op_free_count = PIPE_OP_POOL;
 }
 
 /**
- * @brief Accesses the cache for a read or write operation.
- * @return 1 on hit, 0 on miss.
+ * @brief Takes an op from the pool, uninitialized.
  */
-int cache_access(Cache *cache, uint32_t addr, uint32_t *data, int is_write, uint32_t write_data) {
-    if (!cache) {
-        fprintf(stderr, "Error: Cache is NULL\n");
-        return 0;
-    }
-    cache->accesses++;
-    
-    /* Extract address components */
-    uint32_t offset = addr & ((1 << cache->offset_bits) - 1);
-    uint32_t index = (addr >> cache->offset_bits) & ((1 << cache->index_bits) - 1);
-    uint32_t tag = addr >> (cache->offset_bits + cache->index_bits);
-    
-    /* Validate index bounds */
-    if (index >= cache->num_sets) {
-        fprintf(stderr, "Error: Cache index out of bounds\n");
-        return 0;
-    }
-    /* Search for the block in the set */
-    Cache_Block *set = cache->blocks[index];
-    int hit_way = -1;
-    
-    for (int way = 0; way < cache->associativity; way++) {
-        if (set[way].valid && set[way].tag == tag) {
-            hit_way = way;
-            break;
-        }
+static Pipe_Op *pipe_op_acquire()
+{
+    if (pipe.op_free_count == 0) {
+        fprintf(stderr, "Error: Pipe_Op pool exhausted (%d ops in flight)\n", PIPE_OP_POOL);
+        exit(1);
     }
-    
-    if (hit_way != -1) {
-        /* Cache hit */
-        cache->hits++;
-        
-        /* Update LRU 
-        this because fifo and  random doesnot change at hits*/ 
-       if (cache->replacement_policy == REPLACEMENT_LRU) {
-            set[hit_way].lru_counter = ++cache->global_lru_counter;
-        }
-        /* Calculate word offset within the block */
-        uint32_t word_offset = offset / 4;
-        if (word_offset >= cache->block_size / 4) {
-            fprintf(stderr, "Error: Word offset out of bounds\n");
-            return 0;
-        }
-        if (is_write) {
-            /* Write hit */
-            set[hit_way].dirty = 1;
-            set[hit_way].data[word_offset] = write_data;
-        } else {
-            /* Read hit */
-          
-            *data = set[hit_way].data[word_offset];
+    Pipe_Op *op = pipe.op_free[--pipe.op_free_count];
+#if PIPE_OP_POISON
+    for (size_t i = 0; i < sizeof(Pipe_Op); i++) {
+        if (((uint8_t *)op)[i] != PIPE_OP_POISON_BYTE) {
+            fprintf(stderr, "Error: Pipe_Op %p written after release\n", (void *)op);
+            abort();
         }
-        
-        return 1; /* Hit */
-    } else {
-        /* Cache miss */
-        cache->misses++;
-        
-        /* Find replacement way */
-    int replace_way = cache_find_replacement_way(cache, index);
-
-
-        
-        
-       
-        /* Handle dirty eviction  */
-        if (set[replace_way].valid && set[replace_way].dirty) {
-            /* Write back dirty block - instantaneous */
-             cache->writebacks++;
-            set[replace_way].dirty = 0;
-        }
-        
-        /* Load new block from memory */
-        uint32_t block_addr = addr & ~((1 << cache->offset_bits) - 1);
-        cache_load_block(cache, replace_way, index, block_addr);
-     printf("[DEBUG]  Replace_way=%d\n", replace_way);
-       /* Update block metadata */
-       set[replace_way].valid = 1;
-       set[replace_way].tag = tag;
-       set[replace_way].dirty = 0;
-
-       /* Apply insertion policy */
-       cache_update_insertion(cache, index, replace_way);
-
-
-        /* Calculate word offset within the block */
-        uint32_t word_offset = offset / 4;
-        if (is_write) {
-            /* Write miss */
-            set[replace_way].dirty = 1;
-            set[replace_way].data[word_offset] = write_data;
-        } else {
-            /* Read miss */
-            *data = set[replace_way].data[word_offset];
-        }
-        
-        return 0; /* Miss */
     }
+#endif
+    return op;
 }
 
 /**
- * @brief Finds the way to replace using the LRU policy.
+ * @brief Returns an op to the pool.
  */
-int cache_find_lru_way(Cache *cache, uint32_t index) {
-    Cache_Block *set = cache->blocks[index];
-    int replace_way = 0;
-    uint32_t min_lru = set[0].lru_counter;
-    
-    /* First, look for invalid way */
-    for (int way = 0; way < cache->associativity; way++) {
-        printf("[DEBUG] LRU: way=%d, valid=%d\n", way, set[way].valid);
-        if (!set[way].valid) {
-            return way;
-        }
-    }
-    printf("[DEBUG] LRU:evection\n"); 
-    
-    /* If no invalid way, find LRU */
-    for (int way = 1; way < cache->associativity; way++) {
-        if (set[way].lru_counter < min_lru) {
-            min_lru = set[way].lru_counter;
-            replace_way = way;
-        }
-    }
-    
-    return replace_way;
+static void pipe_op_release(Pipe_Op *op)
+{
+    assert(pipe.op_free_count < PIPE_OP_POOL);
+#if PIPE_OP_POISON
+    memset(op, PIPE_OP_POISON_BYTE, sizeof(Pipe_Op));
+#endif
+    pipe.op_free[pipe.op_free_count++] = op;
 }
 
-/**
- * @brief Finds the way to replace using the FIFO policy.
- */
-int cache_find_fifo_way(Cache *cache, uint32_t index) {
-    Cache_Block *set = cache->blocks[index];
-    int replace_way = 0;
-    uint32_t min_timestamp = set[0].lru_counter; // For FIFO, this represents insertion time
-    
-    // First, look for invalid way
-    for (int way = 0; way < cache->associativity; way++) {
-        if (!set[way].valid) {
-            return way;
-        }
-    }
-     printf("[DEBUG] FIFO:evection\n"); 
-    // If no invalid way, find the way with the smallest insertion timestamp
-    // (oldest insertion = first to be replaced in FIFO)
-    for (int way = 1; way < cache->associativity; way++) {
-        if (set[way].lru_counter < min_timestamp) {
-            min_timestamp = set[way].lru_counter;
-            replace_way = way;
-        }
-    }
-    
-    return replace_way;
-}
+/*==============================================================================
+ * Predecode
+ *============================================================================*/
 
 /**
- * @brief Finds the way to replace using the Random policy.
+ * @brief Allocates the predecode table, with no valid entry (an odd PC is
+ * never fetched).
  */
-int cache_find_random_way(Cache *cache, uint32_t index) {
-    Cache_Block *set = cache->blocks[index];
-   
-    
-    // First, look for invalid way
-    for (int way = 0; way < cache->associativity; way++) {
-        if (!set[way].valid) {
-            return way;
-        }
+static void pipe_predecode_init()
+{
+    pipe.predecode = malloc(PIPE_PREDECODE_ENTRIES * sizeof(Pipe_Op));
+    if (!pipe.predecode) {
+        fprintf(stderr, "Error: Failed to allocate predecode table\n");
+        exit(1);
     }
-     printf("[DEBUG] Random:evection\n"); 
-    // If no invalid way, choose random way
-    return rand() % cache->associativity;
+    for (int i = 0; i < PIPE_PREDECODE_ENTRIES; i++)
+        pipe.predecode[i].pc = 1;
 }
+
 /**
- * @brief Generic dispatcher to find a replacement way based on cache policy.
+ * @brief Decodes the word 'instruction' at 'pc' into 'op': every field that
+ * depends only on the two (opcode, registers, immediates, branch targets,
+ * link values), with the rest zeroed.
  */
-int cache_find_replacement_way(Cache *cache, uint32_t index) {
-    int way = -1;
+static void pipe_decode(Pipe_Op *op, uint32_t pc, uint32_t instruction)
+{
+    /* set up info fields (source/dest regs, immediate, jump dest) as necessary */
+    uint32_t opcode = (instruction >> 26) & 0x3F;
+    uint32_t rs = (instruction >> 21) & 0x1F;
+    uint32_t rt = (instruction >> 16) & 0x1F;
+    uint32_t rd = (instruction >> 11) & 0x1F;
+    uint32_t shamt = (instruction >> 6) & 0x1F;
+    uint32_t funct1 = (instruction >> 0) & 0x1F;
+    uint32_t funct2 = (instruction >> 0) & 0x3F;
+    uint32_t imm16 = (instruction >> 0) & 0xFFFF;
+    uint32_t se_imm16 = imm16 | ((imm16 & 0x8000) ? 0xFFFF8000 : 0);
+    uint32_t targ = (instruction & ((1UL << 26) - 1)) << 2;
+
+    memset(op, 0, sizeof(Pipe_Op));
+    op->pc = pc;
+    op->instruction = instruction;
+    op->reg_src1 = op->reg_src2 = op->reg_dst = -1;
+
+    op->opcode = opcode;
+    op->imm16 = imm16;
+    op->se_imm16 = se_imm16;
+    op->shamt = shamt;
+
+    switch (opcode) {
+        case OP_SPECIAL:
+            /* all "SPECIAL" insts are R-types that use the ALU and both source
+             * regs. Set up source regs and immediate value. */
+            op->reg_src1 = rs;
+            op->reg_src2 = rt;
+            op->reg_dst = rd;
+            op->subop = funct2;
+            if (funct2 == SUBOP_SYSCALL) {
+                op->reg_src1 = 2; // v0
+                op->reg_src2 = 3; // v1
+            }
+            if (funct2 == SUBOP_JR || funct2 == SUBOP_JALR) {
+                op->is_branch = 1;
+                op->branch_cond = 0;
+            }
 
-    switch (cache->replacement_policy) {
-        case REPLACEMENT_LRU:
-            way= cache_find_lru_way(cache, index);
-            break;
-        case REPLACEMENT_FIFO:
-            way= cache_find_fifo_way(cache, index); // Note: shares LRU logic
             break;
-        case REPLACEMENT_RANDOM:
-            way= cache_find_random_way(cache, index);
+
+        case OP_BRSPEC:
+            /* branches that have -and-link variants come here */
+            op->is_branch = 1;
+            op->reg_src1 = rs;
+            op->reg_src2 = rt;
+            op->is_branch = 1;
+            op->branch_cond = 1; /* conditional branch */
+            op->branch_dest = op->pc + 4 + (se_imm16 << 2);
+            op->subop = rt;
+            if (rt == BROP_BLTZAL || rt == BROP_BGEZAL) {
+                /* link reg */
+                op->reg_dst = 31;
+                op->reg_dst_value = op->pc + 4;
+                op->reg_dst_value_ready = 1;
+            }
             break;
-        default:
-            way= cache_find_lru_way(cache, index); // Default to LRU
+
+        case OP_JAL:
+            op->reg_dst = 31;
+            op->reg_dst_value = op->pc + 4;
+            op->reg_dst_value_ready = 1;
+            op->branch_taken = 1;
+            /* fallthrough */
+        case OP_J:
+            op->is_branch = 1;
+            op->branch_cond = 0;
+            op->branch_taken = 1;
+            op->branch_dest = (op->pc & 0xF0000000) | targ;
+			 
             break;
-    }
-    printf("[DEBUG] Replacement: set=%u, selected_way=%d (policy=%d)\n", index, way, cache->replacement_policy);
-    return way;
-}
 
-/**
- * @brief Updates counters based on the insertion policy.
- */
-void cache_update_insertion(Cache *cache, uint32_t index, int way) {
-    Cache_Block *set = cache->blocks[index];
-    
-   switch (cache->replacement_policy) {
-        case REPLACEMENT_LRU:
-            switch (cache->insertion_policy) {
-                case INSERTION_MRU:
-                    // Normal LRU behavior - new block becomes MRU
-                    set[way].lru_counter = ++cache->global_lru_counter;
-                    printf("[DEBUG] Insertion: set=%u, way=%d, lru_counter=%u\n", index, way, set[way].lru_counter);
-                    break;
-                    
-                case INSERTION_LRU:
-                    // New block becomes LRU
-                    set[way].lru_counter = 0;
-                    // Increment all other valid counters
-                    for (int i = 0; i < cache->associativity; i++) {
-                        if (i != way && set[i].valid) {
-                            set[i].lru_counter++;
-                        }
-                    }
-                    break;
-                    
-                default:
-                    set[way].lru_counter = ++cache->global_lru_counter;
-                    break;
-            }
+        case OP_BEQ:
+        case OP_BNE:
+        case OP_BLEZ:
+        case OP_BGTZ:
+            /* ordinary conditional branches (resolved after execute) */
+            op->is_branch = 1;
+            op->branch_cond = 1;
+            op->branch_dest = op->pc + 4 + (se_imm16 << 2);
+            op->reg_src1 = rs;
+            op->reg_src2 = rt;
             break;
-            
-        case REPLACEMENT_FIFO:
-            // For FIFO, we only set insertion timestamp, never update on access
-            set[way].lru_counter = ++cache->global_lru_counter;
+
+        case OP_ADDI:
+        case OP_ADDIU:
+        case OP_SLTI:
+        case OP_SLTIU:
+            /* I-type ALU ops with sign-extended immediates */
+            op->reg_src1 = rs;
+            op->reg_dst = rt;
             break;
-            
-        case REPLACEMENT_RANDOM:
-            // Random replacement doesn't need counter updates
-            // Just set a dummy value for consistency
-            set[way].lru_counter = cache->global_lru_counter;
+
+        case OP_ANDI:
+        case OP_ORI:
+        case OP_XORI:
+        case OP_LUI:
+            /* I-type ALU ops with non-sign-extended immediates */
+            op->reg_src1 = rs;
+            op->reg_dst = rt;
             break;
-            
-        default:
-            set[way].lru_counter = ++cache->global_lru_counter;
+
+        case OP_LW:
+        case OP_LH:
+        case OP_LHU:
+        case OP_LB:
+        case OP_LBU:
+        case OP_SW:
+        case OP_SH:
+        case OP_SB:
+            /* memory ops */
+            op->is_mem = 1;
+            op->reg_src1 = rs;
+            if (opcode == OP_LW || opcode == OP_LH || opcode == OP_LHU || opcode == OP_LB || opcode == OP_LBU) {
+                /* load */
+                op->mem_write = 0;
+                op->reg_dst = rt;
+            }
+            else {
+                /* store */
+                op->mem_write = 1;
+                op->reg_src2 = rt;
+            }
             break;
-    }printf("[DEBUG] Global LRU: %u\n", cache->global_lru_counter);
+    }
 }
+
 /**
- * @brief Prints cache statistics.
+ * @brief Returns the decoded template of the word 'instruction' fetched at
+ * 'pc', decoding it on a miss. Templates are tagged with the word as well as
+ * the PC, so a write to the text region that reaches fetch just misses.
  */
-void cache_print_stats(Cache *cache, const char* cache_name) {
-    printf("%s Statistics:\n", cache_name);
-    printf("  Accesses: %llu\n", cache->accesses);
-    printf("  Hits: %llu\n", cache->hits);
-    printf("  Misses: %llu\n", cache->misses);
-    if (cache->accesses > 0) {
-        printf("  Hit Rate: %.2f%%\n", (double)cache->hits / cache->accesses * 100.0);
-        printf("  Miss Rate: %.2f%%\n", (double)cache->misses / cache->accesses * 100.0);
-    }
-    printf("\n");
+static const Pipe_Op *pipe_predecode(uint32_t pc, uint32_t instruction)
+{
+    Pipe_Op *t = &pipe.predecode[(pc >> 2) & (PIPE_PREDECODE_ENTRIES - 1)];
+    if (t->pc != pc || t->instruction != instruction)
+        pipe_decode(t, pc, instruction);
+    return t;
 }
 
-
 /*==============================================================================
  * Pipeline Control
  *============================================================================*/
 
+/**
+ * @brief Registers the core's and every cache level's statistics.
+ */
+static void pipe_register_stats()
+{
+    stats_counter("core", "cycles", &stat_cycles, "cycles simulated");
+    stats_counter("core", "fetched", &stat_inst_fetch, "instructions fetched");
+    stats_counter("core", "retired", &stat_inst_retire, "instructions retired");
+    stats_ratio("core", "ipc", &stat_inst_retire, &stat_cycles, 1.0, "retired instructions per cycle");
+    stats_counter("core", "flushes", &stat_squash, "pipeline flushes");
+    stats_counter("core", "stall.icache", &pipe.stall_icache, "fetch waiting for an I-cache miss");
+    stats_counter("core", "stall.dcache", &pipe.stall_dcache, "pipeline frozen by the D-cache");
+    stats_counter("core", "stall.load_use", &pipe.stall_load_use, "execute waiting for a load");
+    stats_counter("core", "stall.muldiv", &pipe.stall_muldiv, "execute waiting for HI/LO");
+    stats_counter("core", "fast_forwarded", &pipe.fast_forwarded, "instructions executed functionally");
+    bpred_register_stats(pipe.bpred, "bpred");
+
+    Cache *levels[] = { pipe.icache, pipe.dcache, pipe.l2, pipe.llc };
+    const char *names[] = { "icache", "dcache", "l2", "llc" };
+    for (int i = 0; i < 4; i++) {
+        if (!levels[i])
+            continue;
+        cache_register_stats(levels[i], names[i]);
+        stats_ratio(names[i], "mpki", &levels[i]->stats.misses, &stat_inst_retire, 1000.0,
+                "misses per thousand retired instructions");
+    }
+}
+
 /**
  * @brief Initializes the pipeline state and caches.
  */
@@ -389,36 +297,85 @@ void pipe_init()
     srand(time(NULL)); // Seed random number generator for cache replacement
     memset(&pipe, 0, sizeof(Pipe_State));
     pipe.PC = 0x00400000;
+    pipe_op_pool_init();
+    pipe_predecode_init();
+
+    trace_init();
+    addr_trace_init();
     
 
     printf("Initializing caches...\n");
     
-    /* Initialize caches */
-    /* Instruction cache: 4-way, 8KB, 32-byte blocks */
-    pipe.icache = cache_create(8*1024, 32, 4,REPLACEMENT_RANDOM, INSERTION_MRU);
-	if (!pipe.icache) {
-        fprintf(stderr, "Error: Failed to create instruction cache\n");
-        exit(1);
-    }
-   
-     
+    /* Initialize caches from the runtime configuration (see config.h) */
+    Sim_Config *cfg = &sim_config;
+    cache_tag_only = cfg->tag_only;
+    cache_mem_latency = cfg->mem_latency;
+
+    Cache_Hierarchy caches;
+    config_create_caches(cfg, &caches);
+    pipe.icache = caches.icache;
+    pipe.dcache = caches.dcache;
+    pipe.l2 = caches.l2;
+    pipe.llc = caches.llc;
+    interval_init(&caches);
+
+    pipe.bpred = bpred_create(cfg->bpred, cfg->btb_entries, cfg->bpred_entries, cfg->bpred_history,
+            cfg->ras_entries);
+    pipe_register_stats();
 
-    
-    /* Data cache: 8-way, 64KB, 32-byte blocks */
-    pipe.dcache = cache_create(64*1024, 32, 4,REPLACEMENT_RANDOM, INSERTION_MRU);
-     if (!pipe.dcache) {
-        fprintf(stderr, "Error: Failed to create data cache\n");
-        exit(1);
-    }
-   
-    
-    
     pipe.icache_stall = 0;
     pipe.dcache_stall = 0;
 
     printf("Cache initialization complete\n\n");
 }
 
+/**
+ * @brief Writes all dirty data in the hierarchy back to memory, top down.
+ */
+void pipe_flush_caches()
+{
+    cache_flush(pipe.icache);
+    cache_flush(pipe.dcache);
+    cache_flush(pipe.l2);
+    cache_flush(pipe.llc);
+}
+
+/**
+ * @brief Prints statistics for every level of the cache hierarchy, exports
+ * the per-set profiles if SIM_SET_PROFILE gives a file prefix, and writes
+ * the statistics registry to SIM_STATS_FILE if it is set.
+ */
+void pipe_print_cache_stats()
+{
+    config_print();
+    cache_print_stats(pipe.icache, "L1 I-Cache");
+    cache_print_stats(pipe.dcache, "L1 D-Cache");
+    if (pipe.l2)
+        cache_print_stats(pipe.l2, "L2 Cache");
+    if (pipe.llc)
+        cache_print_stats(pipe.llc, "LLC");
+
+    const char *prefix = getenv("SIM_SET_PROFILE");
+    if (prefix && *prefix) {
+        Cache_Hierarchy caches = { pipe.icache, pipe.dcache, pipe.l2, pipe.llc };
+        config_write_set_profiles(&caches, prefix);
+    }
+
+    const char *path = getenv("SIM_STATS_FILE");
+    if (path && *path)
+        stats_write(path);
+}
+
+/**
+ * @brief Counts one I-cache or D-cache stall cycle in 'counter' and charges
+ * it to the instruction at 'pc' in the PC profile.
+ */
+static inline void pipe_count_stall(uint64_t *counter, uint32_t pc)
+{
+    (*counter)++;
+    PC_PROFILE(pc, stall_cycles, 1);
+}
+
 /**
  * @brief Simulates one clock cycle of the pipeline.
  */
@@ -428,11 +385,13 @@ void pipe_cycle()
    
     if (pipe.icache_stall > 1) {
         pipe.icache_stall--;
+        pipe_count_stall(&pipe.stall_icache, pipe.icache_miss_addr);
         return;
        
     }
     if (pipe.dcache_stall > 1) {
         pipe.dcache_stall--;
+        pipe_count_stall(&pipe.stall_dcache, pipe.dcache_stall_pc);
         return;
     }
 
@@ -449,23 +408,31 @@ void pipe_cycle()
 
 
     
-    if(pipe.icache_stall == 0 && pipe.dcache_stall == 0){
-        pipe_stage_wb();
-        pipe_stage_mem();
-        pipe_stage_execute();
-        pipe_stage_decode();
-        pipe_stage_fetch();
+    /* The last cycle of a stall also resumes what it froze: the whole
+     * pipeline after a D-cache stall (an access that completed but stalled
+     * has already left the memory stage and must retire before the next op
+     * takes its place), fetch alone after an I-cache stall. The state is
+     * taken once, before any stage runs, so that a stall raised during this
+     * cycle's pass neither starts a second pass nor gets cleared. */
+    int dcache_resume = pipe.dcache_stall == 1;
+    int icache_resume = pipe.icache_stall == 1;
+    if (dcache_resume) {
+        pipe_count_stall(&pipe.stall_dcache, pipe.dcache_stall_pc);
+        pipe.dcache_stall = 0;
     }
-    if(pipe.dcache_stall == 1){
+    if (icache_resume) {
+        pipe_count_stall(&pipe.stall_icache, pipe.icache_miss_addr);
+        pipe.icache_stall = 0;
+    }
+
+    if (icache_resume && !dcache_resume) {
+        pipe_stage_fetch();
+    } else {
+        pipe_stage_wb();
         pipe_stage_mem();
         pipe_stage_execute();
         pipe_stage_decode();
         pipe_stage_fetch();
-        pipe.dcache_stall = 0; // Reset dcache stall after processing
-    }
-     if(pipe.icache_stall == 1){
-        pipe_stage_fetch();
-        pipe.icache_stall = 0; // Reset icache stall after processing
     }
     if(pipe.icache_stall > 0 || pipe.dcache_stall > 0) {
         return;
@@ -474,30 +441,32 @@ void pipe_cycle()
 
     /* handle branch recoveries */
     if (pipe.branch_recover) {
-        printf("Entered branch recovery\n");
+        TRACE(RECOVER, pipe.branch_dest, pipe.branch_flush, 0, 0);
 #ifdef DEBUG
         printf("branch recovery: new dest %08x flush %d stages\n", pipe.branch_dest, pipe.branch_flush);
 #endif
 
         pipe.PC = pipe.branch_dest;
+        /* undo the wrong path's pushes and pops */
+        bpred_ras_restore(pipe.bpred, &pipe.branch_ras);
 
         if (pipe.branch_flush >= 2) {
-            if (pipe.decode_op) free(pipe.decode_op);
+            if (pipe.decode_op) pipe_op_release(pipe.decode_op);
             pipe.decode_op = NULL;
         }
 
         if (pipe.branch_flush >= 3) {
-            if (pipe.execute_op) free(pipe.execute_op);
+            if (pipe.execute_op) pipe_op_release(pipe.execute_op);
             pipe.execute_op = NULL;
         }
 
         if (pipe.branch_flush >= 4) {
-            if (pipe.mem_op) free(pipe.mem_op);
+            if (pipe.mem_op) pipe_op_release(pipe.mem_op);
             pipe.mem_op = NULL;
         }
 
         if (pipe.branch_flush >= 5) {
-            if (pipe.wb_op) free(pipe.wb_op);
+            if (pipe.wb_op) pipe_op_release(pipe.wb_op);
             pipe.wb_op = NULL;
         }
 
@@ -540,6 +509,7 @@ void pipe_stage_wb()
     /* if this instruction writes a register, do so now */
     if (op->reg_dst != -1 && op->reg_dst != 0) {
         pipe.REGS[op->reg_dst] = op->reg_dst_value;
+        pipe.reg_ready[op->reg_dst] = op->ready_cycle;
 #ifdef DEBUG
         printf("R%d = %08x\n", op->reg_dst, op->reg_dst_value);
 #endif
@@ -549,199 +519,210 @@ void pipe_stage_wb()
     if (op->opcode == OP_SPECIAL && op->subop == SUBOP_SYSCALL) {
         if (op->reg_src1_value == 0xA) {
             pipe.PC = op->pc; /* fetch will do pc += 4, then we stop with correct PC */
+            if (pipe.fetch_halt)
+                pipe.PC += 4; /* ... unless the pipeline is draining */
             RUN_BIT = 0;
+            /* write dirty data back so memory holds the final program state */
+            pipe_flush_caches();
         }
     }
 
+    PC_PROFILE(op->pc, executions, 1);
+
     /* free the op */
-    free(op);
+    pipe_op_release(op);
 
     stat_inst_retire++;
 }
 
 /**
- * @brief The Memory stage.
+ * @brief Returns the bytes a load or store opcode accesses.
  */
-void pipe_stage_mem()
+static int pipe_mem_size(int opcode)
 {
-    /* if there is no instruction in this pipeline stage, we are done */
-    if (!pipe.mem_op)
-        return;
-
-    /* grab the op out of our input slot */
-    Pipe_Op *op = pipe.mem_op;
-
-    uint32_t val = 0;
-    if (op->is_mem) {
-        /* Access data cache */
-        int cache_hit;
-        if (op->mem_write) {
-            /* Store operation */
-            uint32_t store_val = 0;
-            switch (op->opcode) {
-                case OP_SW:
-                    store_val = op->mem_value;
-                    break;
-                case OP_SH:
-                    /* Read-modify-write for partial word stores */
-                    cache_hit = cache_access(pipe.dcache, op->mem_addr & ~3, &val, 0, 0);
-                    if (!cache_hit) {
-                        pipe.dcache_stall = 50;
-                        return; /* Stall for cache miss */
-                    }
-                    if (op->mem_addr & 2)
-                        store_val = (val & 0x0000FFFF) | (op->mem_value << 16);
-                    else
-                        store_val = (val & 0xFFFF0000) | (op->mem_value & 0xFFFF);
-                    break;
-                case OP_SB:
-                    /* Read-modify-write for partial word stores */
-                    cache_hit = cache_access(pipe.dcache, op->mem_addr & ~3, &val, 0, 0);
-                    if (!cache_hit) {
-                        pipe.dcache_stall = 50;
-                        return; /* Stall for cache miss */
-                    }
-                    switch (op->mem_addr & 3) {
-                        case 0: store_val = (val & 0xFFFFFF00) | ((op->mem_value & 0xFF) << 0); break;
-                        case 1: store_val = (val & 0xFFFF00FF) | ((op->mem_value & 0xFF) << 8); break;
-                        case 2: store_val = (val & 0xFF00FFFF) | ((op->mem_value & 0xFF) << 16); break;
-                        case 3: store_val = (val & 0x00FFFFFF) | ((op->mem_value & 0xFF) << 24); break;
-                    }
-                    break;
-            }
-            
-            cache_hit = cache_access(pipe.dcache, op->mem_addr & ~3, NULL, 1, store_val);
-            if (!cache_hit) {
-                pipe.dcache_stall = 50;
-                return; /* Stall for cache miss */
-            }
-        } else {
-            /* Load operation */
-            cache_hit = cache_access(pipe.dcache, op->mem_addr & ~3, &val, 0, 0);
-            if (!cache_hit) {
-                pipe.dcache_stall = 50;
-                return; /* Stall for cache miss */
-            }
-        }
+    switch (opcode) {
+        case OP_LB:
+        case OP_LBU:
+        case OP_SB:
+            return 1;
+        case OP_LH:
+        case OP_LHU:
+        case OP_SH:
+            return 2;
+        default:
+            return 4;
     }
+}
 
+/**
+ * @brief Returns the value a load puts in its destination register, taken
+ * from the aligned word 'word' that holds its address.
+ */
+static uint32_t pipe_load_value(const Pipe_Op *op, uint32_t word)
+{
     switch (op->opcode) {
-        case OP_LW:
         case OP_LH:
         case OP_LHU:
+            word = (op->mem_addr & 2) ? (word >> 16) & 0xFFFF : word & 0xFFFF;
+            if (op->opcode == OP_LH)
+                word |= (word & 0x8000) ? 0xFFFF8000 : 0;
+            return word;
         case OP_LB:
         case OP_LBU:
-            {
-                /* extract needed value */
-                op->reg_dst_value_ready = 1;
-                if (op->opcode == OP_LW) {
-                    op->reg_dst_value = val;
-                }
-                else if (op->opcode == OP_LH || op->opcode == OP_LHU) {
-                    if (op->mem_addr & 2)
-                        val = (val >> 16) & 0xFFFF;
-                    else
-                        val = val & 0xFFFF;
-
-                    if (op->opcode == OP_LH)
-                        val |= (val & 0x8000) ? 0xFFFF8000 : 0;
-
-                    op->reg_dst_value = val;
-                }
-                else if (op->opcode == OP_LB || op->opcode == OP_LBU) {
-                    switch (op->mem_addr & 3) {
-                        case 0:
-                            val = val & 0xFF;
-                            break;
-                        case 1:
-                            val = (val >> 8) & 0xFF;
-                            break;
-                        case 2:
-                            val = (val >> 16) & 0xFF;
-                            break;
-                        case 3:
-                            val = (val >> 24) & 0xFF;
-                            break;
-                    }
-
-                    if (op->opcode == OP_LB)
-                        val |= (val & 0x80) ? 0xFFFFFF80 : 0;
-
-                    op->reg_dst_value = val;
-                }
-            }
-            break;
+            word = (word >> (8 * (op->mem_addr & 3))) & 0xFF;
+            if (op->opcode == OP_LB)
+                word |= (word & 0x80) ? 0xFFFFFF80 : 0;
+            return word;
+        default:
+            return word;
+    }
+}
 
-        case OP_SB:
+/**
+ * @brief Returns the aligned word 'word' with a store's value merged in at
+ * its address.
+ */
+static uint32_t pipe_store_value(const Pipe_Op *op, uint32_t word)
+{
+    switch (op->opcode) {
         case OP_SH:
-        case OP_SW:
-            /* Store operations already handled above */
-            break;
+            if (op->mem_addr & 2)
+                return (word & 0x0000FFFF) | (op->mem_value << 16);
+            return (word & 0xFFFF0000) | (op->mem_value & 0xFFFF);
+        case OP_SB:
+            {
+                int shift = 8 * (op->mem_addr & 3);
+                return (word & ~(0xFFu << shift)) | ((op->mem_value & 0xFF) << shift);
+            }
+        default:
+            return op->mem_value;
     }
-
-    /* clear stage input and transfer to next stage */
-    pipe.mem_op = NULL;
-    pipe.wb_op = op;
 }
+
 /**
- * @brief The Execute stage.
+ * @brief Performs one D-cache access for the op in the memory stage.
+ *
+ * With a blocking D-cache a miss freezes the pipeline for the latency of the
+ * level that serviced it, and the access is repeated afterwards (except for
+ * a store, which the missing access already performed). With MSHRs the op
+ * moves on: a load's destination register becomes ready when the fill
+ * arrives, and the stage only stalls when no MSHR is free. The first access
+ * an op makes trains the D-cache prefetcher, if there is one.
+ * @return 1 if the access is complete, 0 if the stage must stall and retry.
  */
-void pipe_stage_execute()
+static int pipe_dcache_access(Pipe_Op *op, uint32_t *val, int is_write, uint32_t write_data)
 {
-    /* if a multiply/divide is in progress, decrement cycles until value is ready */
-    if (pipe.multiplier_stall > 0)
-        pipe.multiplier_stall--;
+    Cache *dcache = pipe.dcache;
+    int cache_hit;
 
-    /* if downstream stall, return (and leave any input we had) */
-    if (pipe.mem_op != NULL)
-        return;
+    dcache->access_pc = op->pc;
+    if (!op->addr_traced) {
+        ADDR_TRACE(op->mem_write ? ADDR_STORE : ADDR_LOAD, op->pc, op->mem_addr, pipe_mem_size(op->opcode));
+        op->addr_traced = 1;
+    }
+    if (dcache->num_mshrs > 0) {
+        uint64_t ready;
+        cache_hit = cache_access_nb(dcache, op->mem_addr & ~3, val, is_write, write_data, stat_cycles, &ready);
+        if (cache_hit < 0) {
+            pipe_count_stall(&pipe.stall_dcache, op->pc);
+            return 0; /* all MSHRs busy */
+        }
+        if (!is_write && ready > op->ready_cycle)
+            op->ready_cycle = ready;
+    } else {
+        cache_hit = cache_access(dcache, op->mem_addr & ~3, val, is_write, write_data);
+    }
 
-    /* if no op to execute, return */
-    if (pipe.execute_op == NULL)
-        return;
+    if (pc_profile_on && !op->profiled && cache_hit >= 0) {
+        Pc_Profile_Entry *e = pc_profile_find(op->pc);
+        e->dcache_accesses++;
+        e->dcache_misses += !cache_hit;
+        op->profiled = 1;
+    }
 
-    /* grab op and read sources */
-    Pipe_Op *op = pipe.execute_op;
+    if (dcache->prefetcher && !op->prefetch_trained) {
+        prefetch_train(dcache->prefetcher, op->pc, op->mem_addr, cache_hit);
+        op->prefetch_trained = 1;
+    }
 
-    /* read register values, and check for bypass; stall if necessary */
-    int stall = 0;
-    if (op->reg_src1 != -1) {
-        if (op->reg_src1 == 0)
-            op->reg_src1_value = 0;
-        else if (pipe.mem_op && pipe.mem_op->reg_dst == op->reg_src1) {
-            if (!pipe.mem_op->reg_dst_value_ready)
-                stall = 1;
-            else
-                op->reg_src1_value = pipe.mem_op->reg_dst_value;
-        }
-        else if (pipe.wb_op && pipe.wb_op->reg_dst == op->reg_src1) {
-            op->reg_src1_value = pipe.wb_op->reg_dst_value;
+    if (dcache->num_mshrs == 0) {
+        if (!cache_hit && (!is_write || dcache->write_allocate)) {
+            /* a store has been written into the filled block; only the miss
+             * latency remains, so do not repeat it afterwards */
+            if (is_write)
+                op->store_done = 1;
+            pipe.dcache_stall = dcache->service_latency;
+            pipe.dcache_stall_pc = op->pc;
+            TRACE(DCACHE_STALL, op->pc, op->mem_addr, pipe.dcache_stall, 0);
+            return 0;
         }
-        else
-            op->reg_src1_value = pipe.REGS[op->reg_src1];
     }
-    if (op->reg_src2 != -1) {
-        if (op->reg_src2 == 0)
-            op->reg_src2_value = 0;
-        else if (pipe.mem_op && pipe.mem_op->reg_dst == op->reg_src2) {
-            if (!pipe.mem_op->reg_dst_value_ready)
-                stall = 1;
-            else
-                op->reg_src2_value = pipe.mem_op->reg_dst_value;
-        }
-        else if (pipe.wb_op && pipe.wb_op->reg_dst == op->reg_src2) {
-            op->reg_src2_value = pipe.wb_op->reg_dst_value;
-        }
-        else
-            op->reg_src2_value = pipe.REGS[op->reg_src2];
+
+    if (dcache->service_latency > 0 && ((is_write && (cache_hit > 0 || !dcache->write_allocate)) ||
+                (!is_write && cache_hit > 0 && dcache->num_mshrs == 0))) {
+        /* the access completes, but stalls: the write buffer was full, or the
+         * block is a prefetch that has not arrived yet */
+        pipe.dcache_stall = dcache->service_latency;
+        pipe.dcache_stall_pc = op->pc;
+        TRACE(DCACHE_STALL, op->pc, op->mem_addr, pipe.dcache_stall, 0);
     }
+    return 1;
+}
 
-    /* if bypassing requires a stall (e.g. use immediately after load),
-     * return without clearing stage input */
-    if (stall) 
+/**
+ * @brief The Memory stage.
+ */
+void pipe_stage_mem()
+{
+    /* if there is no instruction in this pipeline stage, we are done */
+    if (!pipe.mem_op)
         return;
 
-    /* execute the op */
+    /* grab the op out of our input slot */
+    Pipe_Op *op = pipe.mem_op;
+
+    uint32_t val = 0;
+    if (op->is_mem) {
+        /* Access data cache */
+        if (op->mem_write && op->store_done) {
+            /* Store already performed by the access that missed */
+        } else if (op->mem_write) {
+            /* Store operation */
+            uint32_t store_val = op->mem_value;
+            if (op->opcode != OP_SW) {
+                /* Read-modify-write for partial word stores */
+                if (!pipe_dcache_access(op, &val, 0, 0))
+                    return; /* Stall for cache miss */
+                store_val = pipe_store_value(op, val);
+            }
+
+            if (!pipe_dcache_access(op, NULL, 1, store_val))
+                return; /* Stall for cache miss */
+        } else {
+            /* Load operation */
+            if (!pipe_dcache_access(op, &val, 0, 0))
+                return; /* Stall for cache miss */
+        }
+    }
+
+    if (op->is_mem && !op->mem_write) {
+        /* extract needed value */
+        op->reg_dst_value_ready = 1;
+        op->reg_dst_value = pipe_load_value(op, val);
+    }
+
+    /* clear stage input and transfer to next stage */
+    pipe.mem_op = NULL;
+    pipe.wb_op = op;
+}
+/**
+ * @brief Computes the results of 'op', whose source values have been read:
+ * the destination value, HI/LO, the outcome of a branch or the address of a
+ * load or store. Shared by the execute stage and the fast-forward.
+ * @return 1, or 0 if the op must wait for the multiplier or divider.
+ */
+static int pipe_execute(Pipe_Op *op)
+{
     switch (op->opcode) {
         case OP_SPECIAL:
             op->reg_dst_value_ready = 1;
@@ -785,8 +766,8 @@ void pipe_stage_execute()
                         pipe.HI = (uval >> 32) & 0xFFFFFFFF;
                         pipe.LO = (uval >>  0) & 0xFFFFFFFF;
 
-                        /* four-cycle multiplier latency */
-                        pipe.multiplier_stall = 4;
+                        /* multiplier latency (four cycles by default) */
+                        pipe.multiplier_stall = sim_config.mult_latency;
                     }
                     break;
                 case SUBOP_MULTU:
@@ -795,8 +776,8 @@ void pipe_stage_execute()
                         pipe.HI = (val >> 32) & 0xFFFFFFFF;
                         pipe.LO = (val >>  0) & 0xFFFFFFFF;
 
-                        /* four-cycle multiplier latency */
-                        pipe.multiplier_stall = 4;
+                        /* multiplier latency (four cycles by default) */
+                        pipe.multiplier_stall = sim_config.mult_latency;
                     }
                     break;
 
@@ -817,8 +798,8 @@ void pipe_stage_execute()
                         pipe.HI = pipe.LO = 0;
                     }
 
-                    /* 32-cycle divider latency */
-                    pipe.multiplier_stall = 32;
+                    /* divider latency (32 cycles by default) */
+                    pipe.multiplier_stall = sim_config.div_latency;
                     break;
 
                 case SUBOP_DIVU:
@@ -830,22 +811,21 @@ void pipe_stage_execute()
                         pipe.HI = pipe.LO = 0;
                     }
 
-                    /* 32-cycle divider latency */
-					/* 32-cycle divider latency */
-                    pipe.multiplier_stall = 32;
+                    /* divider latency (32 cycles by default) */
+                    pipe.multiplier_stall = sim_config.div_latency;
                     break;
 
                 case SUBOP_MFHI:
                     /* stall until value is ready */
                     if (pipe.multiplier_stall > 0)
-                        return;
+                        return 0;
 
                     op->reg_dst_value = pipe.HI;
                     break;
                 case SUBOP_MTHI:
                     /* stall to respect WAW dependence */
                     if (pipe.multiplier_stall > 0)
-                        return;
+                        return 0;
 
                     pipe.HI = op->reg_src1_value;
                     break;
@@ -853,14 +833,14 @@ void pipe_stage_execute()
                 case SUBOP_MFLO:
                     /* stall until value is ready */
                     if (pipe.multiplier_stall > 0)
-                        return;
+                        return 0;
 
                     op->reg_dst_value = pipe.LO;
                     break;
                 case SUBOP_MTLO:
                     /* stall to respect WAW dependence */
                     if (pipe.multiplier_stall > 0)
-                        return;
+                        return 0;
 
                     pipe.LO = op->reg_src1_value;
                     break;
@@ -970,10 +950,94 @@ void pipe_stage_execute()
             op->mem_value = op->reg_src2_value;
             break;
     }
+    return 1;
+}
+
+/**
+ * @brief The Execute stage.
+ */
+void pipe_stage_execute()
+{
+    /* if a multiply/divide is in progress, decrement cycles until value is ready */
+    if (pipe.multiplier_stall > 0)
+        pipe.multiplier_stall--;
+
+    /* if downstream stall, return (and leave any input we had) */
+    if (pipe.mem_op != NULL)
+        return;
+
+    /* if no op to execute, return */
+    if (pipe.execute_op == NULL)
+        return;
+
+    /* grab op and read sources */
+    Pipe_Op *op = pipe.execute_op;
+
+    /* read register values, and check for bypass; stall if necessary */
+    int stall = 0;
+    if (op->reg_src1 != -1) {
+        if (op->reg_src1 == 0)
+            op->reg_src1_value = 0;
+        else if (pipe.mem_op && pipe.mem_op->reg_dst == op->reg_src1) {
+            if (!pipe.mem_op->reg_dst_value_ready)
+                stall = 1;
+            else
+                op->reg_src1_value = pipe.mem_op->reg_dst_value;
+        }
+        else if (pipe.wb_op && pipe.wb_op->reg_dst == op->reg_src1) {
+            if (pipe.wb_op->ready_cycle > stat_cycles)
+                stall = 1; /* load still waiting for its fill */
+            else
+                op->reg_src1_value = pipe.wb_op->reg_dst_value;
+        }
+        else if (pipe.reg_ready[op->reg_src1] > stat_cycles)
+            stall = 1;
+        else
+            op->reg_src1_value = pipe.REGS[op->reg_src1];
+    }
+    if (op->reg_src2 != -1) {
+        if (op->reg_src2 == 0)
+            op->reg_src2_value = 0;
+        else if (pipe.mem_op && pipe.mem_op->reg_dst == op->reg_src2) {
+            if (!pipe.mem_op->reg_dst_value_ready)
+                stall = 1;
+            else
+                op->reg_src2_value = pipe.mem_op->reg_dst_value;
+        }
+        else if (pipe.wb_op && pipe.wb_op->reg_dst == op->reg_src2) {
+            if (pipe.wb_op->ready_cycle > stat_cycles)
+                stall = 1; /* load still waiting for its fill */
+            else
+                op->reg_src2_value = pipe.wb_op->reg_dst_value;
+        }
+        else if (pipe.reg_ready[op->reg_src2] > stat_cycles)
+            stall = 1;
+        else
+            op->reg_src2_value = pipe.REGS[op->reg_src2];
+    }
+
+    /* if bypassing requires a stall (e.g. use immediately after load),
+     * return without clearing stage input */
+    if (stall) {
+        pipe.stall_load_use++;
+        PC_PROFILE(op->pc, load_use_stalls, 1);
+        return;
+    }
 
-    /* handle branch recoveries at this point */
-    if (op->branch_taken)
-        pipe_recover(3, op->branch_dest);
+    /* execute the op */
+    if (!pipe_execute(op)) {
+        pipe.stall_muldiv++;
+        return;
+    }
+
+    /* handle branch recoveries at this point: redirect fetch if the branch
+     * did not go where it was predicted to (without a predictor, whenever
+     * it was taken) */
+    if (op->is_branch && bpred_resolve(pipe.bpred, op->pc, op->branch_cond, op->branch_taken,
+                op->branch_dest, &op->pred)) {
+        pipe.branch_ras = op->pred.ras;
+        pipe_recover(3, op->branch_taken ? op->branch_dest : op->pc + 4);
+    }
 
     /* remove from upstream stage and place in downstream stage */
     pipe.execute_op = NULL;
@@ -997,126 +1061,8 @@ void pipe_stage_decode()
     Pipe_Op *op = pipe.decode_op;
     pipe.decode_op = NULL;
 
-    /* set up info fields (source/dest regs, immediate, jump dest) as necessary */
-    uint32_t opcode = (op->instruction >> 26) & 0x3F;
-    uint32_t rs = (op->instruction >> 21) & 0x1F;
-    uint32_t rt = (op->instruction >> 16) & 0x1F;
-    uint32_t rd = (op->instruction >> 11) & 0x1F;
-    uint32_t shamt = (op->instruction >> 6) & 0x1F;
-    uint32_t funct1 = (op->instruction >> 0) & 0x1F;
-    uint32_t funct2 = (op->instruction >> 0) & 0x3F;
-    uint32_t imm16 = (op->instruction >> 0) & 0xFFFF;
-    uint32_t se_imm16 = imm16 | ((imm16 & 0x8000) ? 0xFFFF8000 : 0);
-    uint32_t targ = (op->instruction & ((1UL << 26) - 1)) << 2;
-
-    op->opcode = opcode;
-    op->imm16 = imm16;
-    op->se_imm16 = se_imm16;
-    op->shamt = shamt;
-
-    switch (opcode) {
-        case OP_SPECIAL:
-            /* all "SPECIAL" insts are R-types that use the ALU and both source
-             * regs. Set up source regs and immediate value. */
-            op->reg_src1 = rs;
-            op->reg_src2 = rt;
-            op->reg_dst = rd;
-            op->subop = funct2;
-            if (funct2 == SUBOP_SYSCALL) {
-                op->reg_src1 = 2; // v0
-                op->reg_src2 = 3; // v1
-            }
-            if (funct2 == SUBOP_JR || funct2 == SUBOP_JALR) {
-                op->is_branch = 1;
-                op->branch_cond = 0;
-            }
-
-            break;
-
-        case OP_BRSPEC:
-            /* branches that have -and-link variants come here */
-            op->is_branch = 1;
-            op->reg_src1 = rs;
-            op->reg_src2 = rt;
-            op->is_branch = 1;
-            op->branch_cond = 1; /* conditional branch */
-            op->branch_dest = op->pc + 4 + (se_imm16 << 2);
-            op->subop = rt;
-            if (rt == BROP_BLTZAL || rt == BROP_BGEZAL) {
-                /* link reg */
-                op->reg_dst = 31;
-                op->reg_dst_value = op->pc + 4;
-                op->reg_dst_value_ready = 1;
-            }
-            break;
-
-        case OP_JAL:
-            op->reg_dst = 31;
-            op->reg_dst_value = op->pc + 4;
-            op->reg_dst_value_ready = 1;
-            op->branch_taken = 1;
-            /* fallthrough */
-        case OP_J:
-            op->is_branch = 1;
-            op->branch_cond = 0;
-            op->branch_taken = 1;
-            op->branch_dest = (op->pc & 0xF0000000) | targ;
-			 
-            break;
-
-        case OP_BEQ:
-        case OP_BNE:
-        case OP_BLEZ:
-        case OP_BGTZ:
-            /* ordinary conditional branches (resolved after execute) */
-            op->is_branch = 1;
-            op->branch_cond = 1;
-            op->branch_dest = op->pc + 4 + (se_imm16 << 2);
-            op->reg_src1 = rs;
-            op->reg_src2 = rt;
-            break;
-
-        case OP_ADDI:
-        case OP_ADDIU:
-        case OP_SLTI:
-        case OP_SLTIU:
-            /* I-type ALU ops with sign-extended immediates */
-            op->reg_src1 = rs;
-            op->reg_dst = rt;
-            break;
-
-        case OP_ANDI:
-        case OP_ORI:
-        case OP_XORI:
-        case OP_LUI:
-            /* I-type ALU ops with non-sign-extended immediates */
-            op->reg_src1 = rs;
-            op->reg_dst = rt;
-            break;
-
-        case OP_LW:
-        case OP_LH:
-        case OP_LHU:
-        case OP_LB:
-        case OP_LBU:
-        case OP_SW:
-        case OP_SH:
-        case OP_SB:
-            /* memory ops */
-            op->is_mem = 1;
-            op->reg_src1 = rs;
-            if (opcode == OP_LW || opcode == OP_LH || opcode == OP_LHU || opcode == OP_LB || opcode == OP_LBU) {
-                /* load */
-                op->mem_write = 0;
-                op->reg_dst = rt;
-            }
-            else {
-                /* store */
-                op->mem_write = 1;
-                op->reg_src2 = rt;
-            }
-            break;
-    }
+    /* the static fields were filled in at fetch, from the predecoded
+     * template of the instruction (see pipe_predecode) */
 
     /* we will handle reg-read together with bypass in the execute stage */
 
@@ -1133,6 +1079,10 @@ void pipe_stage_fetch()
     if (pipe.decode_op != NULL)
         return;
 
+    /* nothing more enters the pipeline while it drains */
+    if (pipe.fetch_halt)
+        return;
+
     /* Validate PC alignment */
     if (pipe.PC & 0x3) {
         fprintf(stderr, "Error: Unaligned PC: 0x%08x\n", pipe.PC);
@@ -1140,35 +1090,172 @@ void pipe_stage_fetch()
     }
     /* Access instruction cache */
     uint32_t instruction;
-    int cache_hit = cache_access(pipe.icache, pipe.PC, &instruction, 0, 0);
+    int cache_hit;
+
+    pipe.icache->access_pc = pipe.PC;
+    if (pipe.icache->num_mshrs > 0) {
+        /* Non-blocking I-cache: only fetch waits for the fill, the rest of
+         * the pipeline keeps draining */
+        uint64_t ready = stat_cycles;
+        if (cache_mshr_pending(pipe.icache, pipe.PC, stat_cycles)) {
+            pipe_count_stall(&pipe.stall_icache, pipe.PC);
+            return;
+        }
+        cache_hit = cache_access_nb(pipe.icache, pipe.PC, &instruction, 0, 0, stat_cycles, &ready);
+        if (cache_hit <= 0) {
+            TRACE(ICACHE_STALL, pipe.PC, (uint32_t)(ready - stat_cycles), 0, 0);
+            pipe_count_stall(&pipe.stall_icache, pipe.PC);
+            PC_PROFILE(pipe.PC, icache_misses, cache_hit == 0);
+            return; /* retried once the block has arrived */
+        }
+    } else
+        cache_hit = cache_access(pipe.icache, pipe.PC, &instruction, 0, 0);
 
     /* Handle cache miss */ 
     if (!cache_hit) {
-        printf("Cache miss at PC: %08x\n", pipe.PC);
-        /* Set stall counter for a 50-cycle penalty */
-        pipe.icache_stall = 50; 
-        
+        /* Stall for the latency of the level that supplied the block */
+        pipe.icache_stall = pipe.icache->service_latency;
+        pipe.icache_miss_addr = pipe.PC;
+        TRACE(ICACHE_STALL, pipe.PC, pipe.icache_stall, 0, 0);
+        PC_PROFILE(pipe.PC, icache_misses, 1);
+
         /* Do not advance PC or send an op down the pipeline.
          * The fetch will be retried with the same PC after the stall. */
       return;
     }
 
     /* On a cache hit, proceed as normal */
-    Pipe_Op *op = malloc(sizeof(Pipe_Op));
-    if (!op) {
-        fprintf(stderr, "Error: Failed to allocate Pipe_Op\n");
-        return;
-    }
-    memset(op, 0, sizeof(Pipe_Op));
-    op->reg_src1 = op->reg_src2 = op->reg_dst = -1;
-
-    op->instruction = instruction; // Use the instruction fetched from the cache
-    printf("Fetched instruction: %08x\n", instruction);
-    op->pc = pipe.PC;
+    Pipe_Op *op = pipe_op_acquire();
+    *op = *pipe_predecode(pipe.PC, instruction); // decoded from the instruction fetched from the cache
+    TRACE(FETCH, pipe.PC, instruction, 0, 0);
+    ADDR_TRACE(ADDR_IFETCH, pipe.PC, pipe.PC, 4);
     pipe.decode_op = op;
 
-    /* update PC for the next instruction */
-    pipe.PC += 4;
+    /* update PC for the next instruction: the predicted target of a branch
+     * the predictor knows, else the next word */
+    bpred_predict(pipe.bpred, op->pc, instruction, &op->pred);
+    pipe.PC = op->pred.taken ? op->pred.target : pipe.PC + 4;
 
     stat_inst_fetch++;
-}
\ No newline at end of file
+}
+
+/*==============================================================================
+ * Fast-Forward
+ *============================================================================*/
+
+/**
+ * @brief Returns 1 if no instruction is in flight (nor a recovery pending).
+ */
+int pipe_empty()
+{
+    return !pipe.decode_op && !pipe.execute_op && !pipe.mem_op && !pipe.wb_op && !pipe.branch_recover;
+}
+
+/* reads the aligned word at 'addr' for the op, through 'cache' when warming */
+static uint32_t pipe_ff_read(Cache *cache, uint32_t pc, uint32_t addr, int warm)
+{
+    uint32_t word;
+    if (!warm)
+        return mem_read_32(addr);
+    cache->access_pc = pc;
+    cache_access(cache, addr, &word, 0, 0);
+    return word;
+}
+
+/**
+ * @brief Executes 'count' instructions at the ISA level, starting at the
+ * fetch PC of an empty pipeline, with no timing at all: each one is fetched,
+ * decoded (through the predecode table), executed and written back before
+ * the next, with the semantics the pipeline stages use. The detailed
+ * pipeline then picks up where it stopped.
+ *
+ * With core.ff_warm the instruction and data accesses go through the caches,
+ * so that the hierarchy is warm at the hand-off. Their statistics counters
+ * and the prefetcher's are put back afterwards, and their profilers (stack
+ * distances, 3C classification, set profile) are suspended meanwhile, so
+ * that only the detailed run is measured.
+ * Otherwise memory serves every access and the caches are written back and
+ * left cold. Neither trains the branch predictor or the prefetcher, and no
+ * cycles pass: fast-forwarded instructions only count in
+ * core.fast_forwarded.
+ * @return the instructions executed, fewer than 'count' if the program
+ * stopped.
+ */
+uint64_t pipe_fast_forward(uint64_t count)
+{
+    int warm = sim_config.ff_warm;
+    Cache *levels[] = { pipe.icache, pipe.dcache, pipe.l2, pipe.llc };
+    Cache_Warmup *saved[4];
+    uint32_t pc = pipe.PC;
+    uint64_t n;
+
+    assert(pipe_empty());
+    for (int i = 0; i < 4; i++) {
+        if (warm)
+            saved[i] = cache_begin_warmup(levels[i]);
+    }
+    if (!warm) {
+        /* memory must hold the latest data, and the caches must not keep
+         * copies the stores below would leave stale */
+        pipe_flush_caches();
+        if (!cache_tag_only) {
+            for (int i = 0; i < 4; i++)
+                cache_invalidate(levels[i]);
+        }
+    }
+
+    for (n = 0; n < count && RUN_BIT; n++) {
+        if (pc & 0x3) {
+            fprintf(stderr, "Error: Unaligned PC: 0x%08x\n", pc);
+            break;
+        }
+        Pipe_Op op = *pipe_predecode(pc, pipe_ff_read(pipe.icache, pc, pc, warm));
+
+        if (op.reg_src1 > 0)
+            op.reg_src1_value = pipe.REGS[op.reg_src1];
+        if (op.reg_src2 > 0)
+            op.reg_src2_value = pipe.REGS[op.reg_src2];
+        pipe_execute(&op);
+        pipe.multiplier_stall = 0; /* HI/LO are ready at once */
+
+        if (op.is_mem) {
+            uint32_t addr = op.mem_addr & ~3;
+            if (!op.mem_write) {
+                op.reg_dst_value = pipe_load_value(&op, pipe_ff_read(pipe.dcache, pc, addr, warm));
+            } else {
+                uint32_t store_val = op.mem_value;
+                if (op.opcode != OP_SW)
+                    store_val = pipe_store_value(&op, pipe_ff_read(pipe.dcache, pc, addr, warm));
+                if (warm) {
+                    pipe.dcache->access_pc = pc;
+                    cache_access(pipe.dcache, addr, NULL, 1, store_val);
+                } else
+                    mem_write_32(addr, store_val);
+            }
+        }
+
+        if (op.reg_dst > 0)
+            pipe.REGS[op.reg_dst] = op.reg_dst_value;
+
+        if (op.opcode == OP_SPECIAL && op.subop == SUBOP_SYSCALL && op.reg_src1_value == 0xA) {
+            RUN_BIT = 0;
+            if (warm)
+                pipe_flush_caches();
+        }
+        pc = op.branch_taken ? op.branch_dest : pc + 4;
+    }
+
+    /* hand off: the detailed pipeline starts at the next instruction, with
+     * nothing outstanding */
+    pipe.PC = pc;
+    pipe.fast_forwarded += n;
+    pipe.multiplier_stall = 0;
+    pipe.icache_stall = 0;
+    pipe.dcache_stall = 0;
+    memset(pipe.reg_ready, 0, sizeof(pipe.reg_ready));
+    for (int i = 0; i < 4; i++) {
+        if (warm)
+            cache_end_warmup(levels[i], saved[i]);
+    }
+    return n;
+}
@@ -2,62 +2,126 @@
 #define _PIPE_H_
 
 #include "shell.h"
+#include "cache.h"
+#include "prefetch.h"
+#include "bpred.h"
 #include <stdbool.h>
 #include <stdint.h>
-/* Cache block structure */
-
-typedef struct Cache_Block {
-    uint32_t tag;           /* tag bits */
-    int valid;              /* valid bit */
-    int dirty;              /* dirty bit (for data cache) */
-    uint32_t lru_counter;   /* for LRU replacement */
-    uint32_t data[8];       /* 32-byte block = 8 words */
-} Cache_Block;
-// Cache replacement policies
-typedef enum {
-    REPLACEMENT_LRU,
-    REPLACEMENT_FIFO,
-    REPLACEMENT_RANDOM
-} ReplacementPolicy;
-
-// Cache insertion policies
-typedef enum {
-    INSERTION_MRU,  // Most Recently Used (normal)
-    INSERTION_LRU // Least Recently Used
-} InsertionPolicy;
-
-/* Cache structure */
-typedef struct Cache {
-    int size;               /* cache size in bytes */
-    int block_size;         /* block size in bytes */
-    int associativity;      /* number of ways */
-    int num_sets;           /* number of sets */
-    int index_bits;         /* number of index bits */
-    int offset_bits;        /* number of offset bits */
-    int tag_bits;           /* number of tag bits */
-    Cache_Block **blocks;   /* 2D array: [set][way] */
-    uint32_t global_lru_counter; /* global counter for LRU */
-    ReplacementPolicy replacement_policy;
-    InsertionPolicy insertion_policy;
-    /* Statistics */
-    uint64_t accesses;
-    uint64_t misses;
-    uint64_t hits;
-    uint64_t writebacks;
-} Cache;
-
-
-// Performance metrics structure
-typedef struct {
-    uint64_t accesses;
-    uint64_t hits;
-    uint64_t misses;
-    uint64_t writebacks;
-    uint64_t cycles;
-    double ipc;
-    double hit_rate;
-    double miss_rate;
-} PerformanceMetrics;
+
+/* Compile-time defaults of the runtime configuration (config.h); every one of
+ * them can also be overridden at startup. */
+
+/* size in bytes of the optional LLC below the L2 (0 = no LLC) */
+#ifndef PIPE_LLC_SIZE
+#define PIPE_LLC_SIZE 0
+#endif
+
+/* replacement and insertion policy of the D-cache, L2 and LLC (see cache.h) */
+#ifndef PIPE_DCACHE_REPLACEMENT
+#define PIPE_DCACHE_REPLACEMENT REPLACEMENT_RANDOM
+#endif
+#ifndef PIPE_DCACHE_INSERTION
+#define PIPE_DCACHE_INSERTION INSERTION_MRU
+#endif
+#ifndef PIPE_L2_REPLACEMENT
+#define PIPE_L2_REPLACEMENT REPLACEMENT_LRU
+#endif
+#ifndef PIPE_L2_INSERTION
+#define PIPE_L2_INSERTION INSERTION_MRU
+#endif
+#ifndef PIPE_LLC_REPLACEMENT
+#define PIPE_LLC_REPLACEMENT REPLACEMENT_LRU
+#endif
+#ifndef PIPE_LLC_INSERTION
+#define PIPE_LLC_INSERTION INSERTION_MRU
+#endif
+
+/* MSHRs per L1 cache (0 = blocking: a miss freezes the pipeline) */
+#ifndef PIPE_ICACHE_MSHRS
+#define PIPE_ICACHE_MSHRS 0
+#endif
+#ifndef PIPE_DCACHE_MSHRS
+#define PIPE_DCACHE_MSHRS 0
+#endif
+
+/* set index function of every cache (INDEX_MODULO or INDEX_HASH) */
+#ifndef PIPE_CACHE_INDEXING
+#define PIPE_CACHE_INDEXING INDEX_MODULO
+#endif
+
+/* model caches as tags only (1) instead of holding block data (0); memory
+ * then serves every access, with identical hit/miss/writeback counts */
+#ifndef PIPE_TAG_ONLY
+#define PIPE_TAG_ONLY 0
+#endif
+
+/* victim cache lines behind each L1 (0 = none) and their hit latency */
+#ifndef PIPE_ICACHE_VICTIM
+#define PIPE_ICACHE_VICTIM 0
+#endif
+#ifndef PIPE_DCACHE_VICTIM
+#define PIPE_DCACHE_VICTIM 0
+#endif
+#ifndef PIPE_VICTIM_LATENCY
+#define PIPE_VICTIM_LATENCY 2
+#endif
+
+/* D-cache prefetcher (PREFETCH_NONE, PREFETCH_NEXT_LINE, PREFETCH_STRIDE or
+ * PREFETCH_STREAM) with its degree and distance, see prefetch.h */
+#ifndef PIPE_DCACHE_PREFETCHER
+#define PIPE_DCACHE_PREFETCHER PREFETCH_NONE
+#endif
+#ifndef PIPE_PREFETCH_DEGREE
+#define PIPE_PREFETCH_DEGREE 1
+#endif
+#ifndef PIPE_PREFETCH_DISTANCE
+#define PIPE_PREFETCH_DISTANCE 1
+#endif
+
+/* branch predictor (BPRED_NONE, BPRED_BTFN, BPRED_BIMODAL, BPRED_GSHARE or
+ * BPRED_TOURNAMENT) with its BTB and table sizes and global history length,
+ * see bpred.h */
+#ifndef PIPE_BPRED
+#define PIPE_BPRED BPRED_NONE
+#endif
+#ifndef PIPE_BTB_ENTRIES
+#define PIPE_BTB_ENTRIES 512
+#endif
+#ifndef PIPE_BPRED_ENTRIES
+#define PIPE_BPRED_ENTRIES 4096
+#endif
+#ifndef PIPE_BPRED_HISTORY
+#define PIPE_BPRED_HISTORY 12
+#endif
+/* return address stack entries (0 = none) */
+#ifndef PIPE_RAS_ENTRIES
+#define PIPE_RAS_ENTRIES 8
+#endif
+
+/* warm the caches while fast-forwarding (1), or leave them cold (0): see
+ * pipe_fast_forward() */
+#ifndef PIPE_FF_WARM
+#define PIPE_FF_WARM 1
+#endif
+
+/* Pipe_Ops in flight at once: one per stage input (decode, execute, memory,
+ * write-back), with room to spare */
+#define PIPE_OP_POOL 8
+
+/* predecoded instruction templates, direct mapped by PC (power of two) */
+#ifndef PIPE_PREDECODE_ENTRIES
+#define PIPE_PREDECODE_ENTRIES 1024
+#endif
+
+/* fill released Pipe_Ops with a pattern and check it is intact when they are
+ * handed out again, so that a use after release shows (on with DEBUG) */
+#ifndef PIPE_OP_POISON
+#ifdef DEBUG
+#define PIPE_OP_POISON 1
+#else
+#define PIPE_OP_POISON 0
+#endif
+#endif
 
 /* Pipeline ops (instances of this structure) are high-level representations of
  * the instructions that actually flow through the pipeline. This struct does
@@ -87,6 +151,10 @@ typedef struct Pipe_Op {
     int is_mem;       /* is this a load/store? */
     uint32_t mem_addr; /* address if applicable */
     int mem_write; /* is this a write to memory? */
+    int store_done; /* store performed by an access that missed? */
+    int prefetch_trained; /* access already shown to the D-cache prefetcher? */
+    int addr_traced; /* access already written to the address trace? */
+    int profiled; /* access already counted in the PC profile? */
     uint32_t mem_value; /* value loaded from memory or to be written to memory */
 
     /* register destination information */
@@ -94,6 +162,8 @@ typedef struct Pipe_Op {
                     otherwise */
     uint32_t reg_dst_value; /* value to write into dest reg. */
     int reg_dst_value_ready; /* destination value produced yet? */
+    uint64_t ready_cycle;    /* cycle the value may be used (loads under a
+                                non-blocking miss), 0 = immediately */
 
     /* branch information */
     int is_branch;        /* is this a branch? */
@@ -103,6 +173,7 @@ typedef struct Pipe_Op {
                              for unconditional, execute for conditional) */
     int is_link;          /* jump-and-link or branch-and-link inst? */
     int link_reg;         /* register to place link into? */
+    Bpred_Info pred;      /* prediction made at fetch */
 
 } Pipe_Op;
 
@@ -119,12 +190,23 @@ typedef struct Pipe_State {
     /* pipe op currently at the input of the given stage (NULL for none) */
     Pipe_Op *decode_op, *execute_op, *mem_op, *wb_op;
 
+    /* every op in flight lives in this pool: fetch acquires a slot,
+     * write-back and flushes release it */
+    char *op_pool;                  /* [PIPE_OP_POOL] cache-line aligned slots */
+    Pipe_Op *op_free[PIPE_OP_POOL]; /* released slots, a stack */
+    int op_free_count;
+    Pipe_Op *predecode;             /* [PIPE_PREDECODE_ENTRIES] decoded templates */
+
     /* register file state */
     uint32_t REGS[32];
     uint32_t HI, LO;
+    /* cycle at which each register's last written value becomes usable
+     * (non-zero only for loads that missed in a non-blocking D-cache) */
+    uint64_t reg_ready[32];
 
     /* program counter in fetch stage */
     uint32_t PC;
+    int fetch_halt; /* fetch nothing, so that the pipeline drains */
 
     /* information for PC update (branch recovery). Branches should use this
      * mechanism to redirect the fetch stage, and flush the ops that came after
@@ -132,6 +214,7 @@ typedef struct Pipe_State {
     int branch_recover; /* set to '1' to load a new PC */
     uint32_t branch_dest; /* next fetch will be from this PC */
     int branch_flush; /* how many stages to flush during recover? (1 = fetch, 2 = fetch/decode, ...) */
+    Ras_Checkpoint branch_ras; /* return address stack to restore with it */
 
     /* multiplier stall info */
     int multiplier_stall; /* number of remaining cycles until HI/LO are ready */
@@ -139,14 +222,32 @@ typedef struct Pipe_State {
     /* Cache structures */
     Cache *icache;      /* instruction cache */
     Cache *dcache;      /* data cache */
+    Cache *l2;          /* unified L2, shared by both L1s */
+    Cache *llc;         /* optional last-level cache (NULL if absent) */
+
+    /* branch predictor, queried by fetch and trained by execute */
+    Branch_Predictor *bpred;
     
     /* Cache miss handling */
     int icache_stall;   /* cycles remaining for I-cache miss */
     int dcache_stall;   /* cycles remaining for D-cache miss */
     uint32_t icache_miss_addr;
+    uint32_t dcache_stall_pc; /* instruction the D-cache stall is charged to */
     /* place other information here as necessary */
     bool is_stalled;
 
+    /* stall cycles by cause, counted cycle by cycle; a blocking stall of
+     * latency L counts L cycles, up to and including the one that resumes.
+     * Each is also charged to the instruction responsible in the PC
+     * profile (pcprof.h). */
+    uint64_t stall_icache;   /* fetch waiting for an I-cache miss */
+    uint64_t stall_dcache;   /* pipeline frozen by the D-cache (miss, full
+                                MSHRs or write buffer, prefetch in flight) */
+    uint64_t stall_load_use; /* execute waiting for a load's result */
+    uint64_t stall_muldiv;   /* execute waiting for HI/LO */
+
+    uint64_t fast_forwarded; /* instructions executed by pipe_fast_forward() */
+
 } Pipe_State;
 
 /* global variable -- pipeline state */
@@ -155,9 +256,22 @@ extern Pipe_State pipe;
 /* called during simulator startup */
 void pipe_init();
 
+/* writes all dirty cached data back to memory */
+void pipe_flush_caches();
+
+/* prints per-level cache statistics */
+void pipe_print_cache_stats();
+
 /* this function calls the others */
 void pipe_cycle();
 
+/* true if no instruction is in flight */
+int pipe_empty();
+
+/* executes 'count' instructions functionally, from the fetch PC of an empty
+ * pipeline, and returns how many were executed before the program stopped */
+uint64_t pipe_fast_forward(uint64_t count);
+
 /* pipe stages can call this to schedule a branch recovery */
 /* flushes 'flush' stages (1 = execute only, 2 = fetch/decode, ...) and then
  * sets the fetch PC to the given destination. */
@@ -172,17 +286,4 @@ void pipe_stage_wb();
 
 
 
-/* Cache functions */
-Cache* cache_create(int size, int block_size, int associativity ,int replacement_policy, int insertion_policy);
-void cache_destroy(Cache *cache);
-int cache_access(Cache *cache, uint32_t addr, uint32_t *data, int is_write, uint32_t write_data);
-void cache_print_stats(Cache *cache, const char* cache_name);
-int cache_find_lru_way(Cache *cache, uint32_t index);
-int cache_find_fifo_way(Cache *cache, uint32_t index);
-int cache_find_random_way(Cache *cache, uint32_t index);
-int cache_find_replacement_way(Cache *cache, uint32_t index) ;
-void cache_update_insertion(Cache *cache, uint32_t index, int way) ;
-
-void cache_load_block(Cache *cache, int way, uint32_t index, uint32_t block_addr);
-
 #endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "prefetch.h"
+#include "shell.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+/*==============================================================================
+ * Prefetcher Framework
+ *============================================================================*/
+
+static const char *prefetch_names[] = { "none", "next-line", "stride", "stream" };
+
+/**
+ * @brief Creates a prefetcher of the given type.
+ */
+Prefetcher *prefetch_create(PrefetchType type, int degree, int distance) {
+    if (degree <= 0 || distance <= 0) {
+        fprintf(stderr, "Error: Invalid prefetcher configuration\n");
+        exit(1);
+    }
+    Prefetcher *pf = calloc(1, sizeof(Prefetcher));
+    if (!pf) {
+        fprintf(stderr, "Error: Failed to allocate prefetcher\n");
+        exit(1);
+    }
+    pf->type = type;
+    pf->degree = degree;
+    pf->distance = distance;
+    return pf;
+}
+
+/**
+ * @brief Destroys a prefetcher.
+ */
+void prefetch_destroy(Prefetcher *pf) {
+    free(pf);
+}
+
+/**
+ * @brief Attaches a prefetcher to the cache it fills (NULL detaches).
+ *
+ * The cache owns the prefetcher from then on and destroys it with itself.
+ */
+void cache_set_prefetcher(Cache *cache, Prefetcher *pf) {
+    if (cache->prefetcher && cache->prefetcher != pf)
+        prefetch_destroy(cache->prefetcher);
+    cache->prefetcher = pf;
+    if (pf)
+        pf->cache = cache;
+}
+
+/**
+ * @brief Finds a free prefetch queue entry (one whose fill has arrived).
+ * @return the entry, or -1 if every entry is still in flight.
+ */
+int prefetch_queue_slot(Prefetcher *pf, uint64_t now) {
+    for (int i = 0; i < PREFETCH_QUEUE; i++) {
+        if (pf->queue_ready[i] <= now)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Records the first demand access to a prefetched block.
+ * @return cycles until the block arrives if its prefetch is still in flight
+ * (a late prefetch), else 0.
+ */
+int prefetch_demand_use(Prefetcher *pf, uint32_t block_addr, uint64_t now) {
+    pf->stats.useful++;
+    pf->triggered = 1;
+
+    for (int i = 0; i < PREFETCH_QUEUE; i++) {
+        if (pf->queue_addr[i] == block_addr && pf->queue_ready[i] > now) {
+            pf->stats.late++;
+            return (int)(pf->queue_ready[i] - now);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Next-N-line: fetch the 'degree' blocks starting 'distance' blocks
+ * past the one accessed.
+ */
+static void prefetch_next_line(Prefetcher *pf, uint32_t addr) {
+    uint32_t block_addr = addr & ~(pf->cache->block_size - 1);
+
+    for (int i = 0; i < pf->degree; i++)
+        cache_prefetch(pf->cache, block_addr + (uint32_t)(pf->distance + i) * pf->cache->block_size);
+}
+
+/**
+ * @brief PC-stride: trains the reference prediction table entry of 'pc' and,
+ * once its stride is steady, fetches 'degree' strides starting 'distance'
+ * strides ahead.
+ */
+static void prefetch_stride(Prefetcher *pf, uint32_t pc, uint32_t addr) {
+    Rpt_Entry *e = &pf->rpt[(pc >> 2) & (PREFETCH_RPT_ENTRIES - 1)];
+
+    if (e->pc != pc) {
+        e->pc = pc;
+        e->last_addr = addr;
+        e->stride = 0;
+        e->state = RPT_INITIAL;
+        return;
+    }
+
+    int32_t stride = (int32_t)(addr - e->last_addr);
+    int correct = stride == e->stride;
+    switch (e->state) {
+        case RPT_INITIAL:
+            if (!correct) e->stride = stride;
+            e->state = correct ? RPT_STEADY : RPT_TRANSIENT;
+            break;
+        case RPT_TRANSIENT:
+            if (!correct) e->stride = stride;
+            e->state = correct ? RPT_STEADY : RPT_NO_PRED;
+            break;
+        case RPT_STEADY:
+            /* keep the stride: one irregular access should not lose it */
+            if (!correct) e->state = RPT_INITIAL;
+            break;
+        case RPT_NO_PRED:
+            if (!correct) e->stride = stride;
+            e->state = correct ? RPT_TRANSIENT : RPT_NO_PRED;
+            break;
+    }
+    e->last_addr = addr;
+
+    if (e->state != RPT_STEADY || e->stride == 0)
+        return;
+    for (int i = 0; i < pf->degree; i++)
+        cache_prefetch(pf->cache, addr + (uint32_t)(e->stride * (pf->distance + i)));
+}
+
+/**
+ * @brief Stream buffers: a miss that does not continue an existing stream
+ * starts a new one in the least recently used buffer. Each buffer follows an
+ * ascending stream and keeps up to 'distance' blocks fetched ahead of it,
+ * issuing at most 'degree' per access.
+ */
+static void prefetch_stream(Prefetcher *pf, uint32_t addr) {
+    uint32_t block = addr >> pf->cache->offset_bits;
+    Stream_Buffer *s = NULL;
+
+    for (int i = 0; i < PREFETCH_STREAMS; i++) {
+        Stream_Buffer *b = &pf->streams[i];
+        if (b->valid && block - b->head < PREFETCH_STREAM_WINDOW) {
+            s = b;
+            break;
+        }
+    }
+    if (!s) {
+        s = &pf->streams[0];
+        for (int i = 1; i < PREFETCH_STREAMS && s->valid; i++) {
+            if (!pf->streams[i].valid || pf->streams[i].last_use < s->last_use)
+                s = &pf->streams[i];
+        }
+        s->valid = 1;
+        s->tail = block + 1;
+    }
+    s->head = block + 1;
+    s->last_use = stat_cycles;
+    if ((int32_t)(s->tail - s->head) < 0)
+        s->tail = s->head;
+
+    for (int n = 0; n < pf->degree && s->tail - s->head < (uint32_t)pf->distance; n++) {
+        cache_prefetch(pf->cache, s->tail << pf->cache->offset_bits);
+        s->tail++;
+    }
+}
+
+/**
+ * @brief Trains the prefetcher on one demand access to its cache.
+ *
+ * 'hit' is the outcome of the access, which must already have been made.
+ * Next-line and stream prefetchers act on misses and on the first use of a
+ * prefetched block; the PC-stride table sees every access.
+ */
+void prefetch_train(Prefetcher *pf, uint32_t pc, uint32_t addr, int hit) {
+    int trigger = !hit || pf->triggered;
+    pf->triggered = 0;
+
+    switch (pf->type) {
+        case PREFETCH_NEXT_LINE:
+            if (trigger)
+                prefetch_next_line(pf, addr);
+            break;
+        case PREFETCH_STRIDE:
+            prefetch_stride(pf, pc, addr);
+            break;
+        case PREFETCH_STREAM:
+            if (trigger)
+                prefetch_stream(pf, addr);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Prints prefetcher statistics.
+ *
+ * Accuracy is the fraction of prefetches that were used, coverage the
+ * fraction of would-be demand misses they removed, and timeliness the
+ * fraction of useful prefetches that arrived before they were needed.
+ */
+void prefetch_print_stats(Prefetcher *pf) {
+    uint64_t misses = pf->cache->stats.misses;
+
+    printf("  Prefetcher: %s (degree %d, distance %d)\n", prefetch_names[pf->type], pf->degree, pf->distance);
+    printf("  Prefetches: %" PRIu64 " issued, %" PRIu64 " redundant, %" PRIu64 " dropped\n",
+            pf->stats.issued, pf->stats.redundant, pf->stats.dropped);
+    printf("  Prefetches used: %" PRIu64 " (%" PRIu64 " late), %" PRIu64 " evicted unused\n",
+            pf->stats.useful, pf->stats.late, pf->stats.unused);
+    if (pf->stats.issued > 0)
+        printf("  Prefetch Accuracy: %.2f%%\n", (double)pf->stats.useful / pf->stats.issued * 100.0);
+    if (pf->stats.useful + misses > 0)
+        printf("  Prefetch Coverage: %.2f%%\n", (double)pf->stats.useful / (pf->stats.useful + misses) * 100.0);
+    if (pf->stats.useful > 0)
+        printf("  Prefetch Timeliness: %.2f%%\n", (double)(pf->stats.useful - pf->stats.late) / pf->stats.useful * 100.0);
+}
@@ -0,0 +1,94 @@
+#ifndef _PREFETCH_H_
+#define _PREFETCH_H_
+
+#include "cache.h"
+#include <stdint.h>
+
+/* Hardware prefetching
+ *
+ * A Prefetcher is attached to one cache (cache_set_prefetcher) and trained on
+ * the demand stream that reaches it (prefetch_train, called with the access
+ * address and the PC of the instruction). It issues its predictions through
+ * cache_prefetch(), which fills the block without touching the demand
+ * statistics of this or any lower level. Prefetched blocks are tagged in the
+ * tag store; the first demand access to one counts it as useful, and one that
+ * is evicted untouched counts as unused. In-flight prefetches are tracked in
+ * a small queue so that a demand access which arrives before the fill is
+ * counted as late and waits for the remaining cycles.
+ *
+ *   degree    blocks issued per trigger
+ *   distance  how far ahead of the demand stream the first of them is, in
+ *             blocks (next-line) or strides (PC-stride); for stream buffers,
+ *             the number of blocks each buffer runs ahead of its stream */
+
+typedef enum {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE, /* next-N-line, tagged: triggers on miss or first use */
+    PREFETCH_STRIDE,    /* PC-indexed reference prediction table */
+    PREFETCH_STREAM     /* multi-way stream buffers */
+} PrefetchType;
+
+#define PREFETCH_QUEUE       16 /* prefetches in flight at once */
+#define PREFETCH_RPT_ENTRIES 64 /* reference prediction table (power of two) */
+#define PREFETCH_STREAMS     8  /* stream buffers */
+#define PREFETCH_STREAM_WINDOW 4 /* blocks past a buffer head that still match */
+
+/* reference prediction table entry states (Chen & Baer) */
+typedef enum {
+    RPT_INITIAL,
+    RPT_TRANSIENT,
+    RPT_STEADY,
+    RPT_NO_PRED
+} RptState;
+
+typedef struct Rpt_Entry {
+    uint32_t pc;            /* tag (0 = free) */
+    uint32_t last_addr;
+    int32_t stride;
+    RptState state;
+} Rpt_Entry;
+
+typedef struct Stream_Buffer {
+    int valid;
+    uint32_t head;          /* next block number the stream is expected at */
+    uint32_t tail;          /* next block number to prefetch */
+    uint64_t last_use;      /* for LRU reallocation */
+} Stream_Buffer;
+
+/* statistics counters of a prefetcher */
+typedef struct Prefetch_Stats {
+    uint64_t issued;        /* prefetches that filled a block */
+    uint64_t redundant;     /* ... dropped because the block was present */
+    uint64_t dropped;       /* ... dropped because the queue was full */
+    uint64_t useful;        /* prefetched blocks later used by a demand access */
+    uint64_t late;          /* ... that were still in flight at that access */
+    uint64_t unused;        /* prefetched blocks evicted before any use */
+} Prefetch_Stats;
+
+typedef struct Prefetcher {
+    PrefetchType type;
+    int degree;
+    int distance;
+    Cache *cache;           /* cache the prefetches fill */
+    int triggered;          /* last demand access was the first use of a prefetch */
+
+    /* per-type state */
+    Rpt_Entry rpt[PREFETCH_RPT_ENTRIES];
+    Stream_Buffer streams[PREFETCH_STREAMS];
+
+    /* prefetches in flight: block address and fill arrival cycle */
+    uint32_t queue_addr[PREFETCH_QUEUE];
+    uint64_t queue_ready[PREFETCH_QUEUE];
+
+    Prefetch_Stats stats;
+} Prefetcher;
+
+Prefetcher *prefetch_create(PrefetchType type, int degree, int distance);
+void prefetch_destroy(Prefetcher *pf);
+void cache_set_prefetcher(Cache *cache, Prefetcher *pf);
+void prefetch_train(Prefetcher *pf, uint32_t pc, uint32_t addr, int hit);
+int prefetch_queue_slot(Prefetcher *pf, uint64_t now);
+int prefetch_demand_use(Prefetcher *pf, uint32_t block_addr, uint64_t now);
+void prefetch_print_stats(Prefetcher *pf);
+
+#endif
@@ -0,0 +1,174 @@
+#include "setprof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define SETPROF_HOT_SETS 4  /* hottest sets listed in the statistics */
+
+static void *setprof_alloc(size_t size)
+{
+    void *p = calloc(1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate set profile\n");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * @brief Creates a profile of a cache with 'num_sets' sets, with windows of
+ * 'window' demand accesses.
+ */
+Set_Profile *setprof_create(int num_sets, int window)
+{
+    if (num_sets <= 0 || window <= 0) {
+        fprintf(stderr, "Error: Invalid set profile (%d sets, window %d)\n", num_sets, window);
+        exit(1);
+    }
+    Set_Profile *sp = setprof_alloc(sizeof(Set_Profile));
+    sp->num_sets = num_sets;
+    sp->accesses = setprof_alloc(num_sets * sizeof(uint64_t));
+    sp->misses = setprof_alloc(num_sets * sizeof(uint64_t));
+    sp->evictions = setprof_alloc(num_sets * sizeof(uint64_t));
+    sp->writebacks = setprof_alloc(num_sets * sizeof(uint64_t));
+    sp->window = window;
+    sp->window_capacity = 16;
+    sp->window_misses = setprof_alloc((size_t)sp->window_capacity * num_sets * sizeof(uint32_t));
+    sp->num_windows = 1;
+    return sp;
+}
+
+void setprof_destroy(Set_Profile *sp)
+{
+    if (!sp)
+        return;
+    free(sp->accesses);
+    free(sp->misses);
+    free(sp->evictions);
+    free(sp->writebacks);
+    free(sp->window_misses);
+    free(sp);
+}
+
+/**
+ * @brief Starts a new window, making room for it first: by growing the
+ * matrix, or once it has SETPROF_MAX_WINDOWS rows by merging them in pairs.
+ */
+static void setprof_next_window(Set_Profile *sp)
+{
+    size_t row = sp->num_sets;
+
+    if (sp->num_windows == sp->window_capacity) {
+        if (sp->window_capacity < SETPROF_MAX_WINDOWS) {
+            size_t old = (size_t)sp->window_capacity * row;
+            sp->window_capacity *= 2;
+            sp->window_misses = realloc(sp->window_misses, (size_t)sp->window_capacity * row * sizeof(uint32_t));
+            if (!sp->window_misses) {
+                fprintf(stderr, "Error: Failed to allocate set profile\n");
+                exit(1);
+            }
+            memset(sp->window_misses + old, 0, old * sizeof(uint32_t));
+        } else {
+            for (int w = 0; w < sp->num_windows / 2; w++) {
+                uint32_t *dst = sp->window_misses + w * row;
+                const uint32_t *a = sp->window_misses + 2 * w * row, *b = a + row;
+                for (size_t s = 0; s < row; s++)
+                    dst[s] = a[s] + b[s];
+            }
+            sp->num_windows /= 2;
+            memset(sp->window_misses + sp->num_windows * row, 0, sp->num_windows * row * sizeof(uint32_t));
+            sp->window *= 2;
+        }
+    }
+    sp->num_windows++;
+    sp->in_window = 0;
+}
+
+/**
+ * @brief Counts one demand access to set 'index'.
+ */
+void setprof_access(Set_Profile *sp, uint32_t index, int miss)
+{
+    if (sp->in_window == sp->window)
+        setprof_next_window(sp);
+    sp->in_window++;
+    sp->accesses[index]++;
+    if (miss) {
+        sp->misses[index]++;
+        sp->window_misses[(size_t)(sp->num_windows - 1) * sp->num_sets + index]++;
+    }
+}
+
+/*==============================================================================
+ * Reports
+ *============================================================================*/
+
+/**
+ * @brief Prints how evenly misses spread over the sets, and the sets that
+ * take the most.
+ */
+void setprof_print(const Set_Profile *sp)
+{
+    uint64_t total = 0, min = UINT64_MAX, max = 0;
+    int hot[SETPROF_HOT_SETS], num_hot = 0;
+
+    for (int s = 0; s < sp->num_sets; s++) {
+        uint64_t m = sp->misses[s];
+        total += m;
+        if (m < min)
+            min = m;
+        if (m > max)
+            max = m;
+        /* insertion into the short list of hottest sets */
+        if (!m || (num_hot == SETPROF_HOT_SETS && m <= sp->misses[hot[num_hot - 1]]))
+            continue;
+        int i = num_hot < SETPROF_HOT_SETS ? num_hot++ : num_hot - 1;
+        for (; i > 0 && sp->misses[hot[i - 1]] < m; i--)
+            hot[i] = hot[i - 1];
+        hot[i] = s;
+    }
+
+    double mean = (double)total / sp->num_sets;
+    printf("  Misses per set: min %" PRIu64 ", mean %.1f, max %" PRIu64, min, mean, max);
+    if (mean > 0)
+        printf(" (%.1fx mean)", max / mean);
+    printf("\n");
+    if (num_hot > 0) {
+        printf("  Hottest sets:");
+        for (int i = 0; i < num_hot; i++)
+            printf(" %d (%" PRIu64 ")", hot[i], sp->misses[hot[i]]);
+        printf("\n");
+    }
+}
+
+static void setprof_write_row(FILE *f, const char *label, const uint64_t *values, int n)
+{
+    fprintf(f, "%s", label);
+    for (int s = 0; s < n; s++)
+        fprintf(f, ",%" PRIu64, values[s]);
+    fprintf(f, "\n");
+}
+
+/**
+ * @brief Writes the profile as a CSV matrix: a header of set numbers, the
+ * per-set totals, then one row of misses per window, labelled with the
+ * demand access it starts at.
+ */
+void setprof_write(const Set_Profile *sp, FILE *f)
+{
+    fprintf(f, "row");
+    for (int s = 0; s < sp->num_sets; s++)
+        fprintf(f, ",%d", s);
+    fprintf(f, "\n");
+    setprof_write_row(f, "accesses", sp->accesses, sp->num_sets);
+    setprof_write_row(f, "misses", sp->misses, sp->num_sets);
+    setprof_write_row(f, "evictions", sp->evictions, sp->num_sets);
+    setprof_write_row(f, "writebacks", sp->writebacks, sp->num_sets);
+    for (int w = 0; w < sp->num_windows; w++) {
+        const uint32_t *row = sp->window_misses + (size_t)w * sp->num_sets;
+        fprintf(f, "@%" PRIu64, (uint64_t)w * sp->window);
+        for (int s = 0; s < sp->num_sets; s++)
+            fprintf(f, ",%u", row[s]);
+        fprintf(f, "\n");
+    }
+}
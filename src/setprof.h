@@ -0,0 +1,51 @@
+#ifndef _SETPROF_H_
+#define _SETPROF_H_
+
+#include "cache.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/* Per-set statistics
+ *
+ * A Set_Profile attached to a cache counts, for every set, the demand
+ * accesses and misses it receives, the valid blocks replaced in it
+ * (evictions) and the dirty blocks of it written to the next level
+ * (writebacks, whether evicted, back-invalidated or flushed, directly or
+ * later from the victim cache; not those handed to an exclusive level), so
+ * that they add up to the cache's writebacks. It also keeps the misses of every
+ * set over time, in windows of 'window' demand accesses to the cache, so
+ * that hot spots that come and go with program phases are visible.
+ *
+ * At most SETPROF_MAX_WINDOWS windows are kept: when they are used up,
+ * neighbouring windows are merged pairwise and the window length doubles,
+ * so memory stays bounded on any run length.
+ *
+ * setprof_write() exports the profile as a CSV matrix with one column per
+ * set: a row per total counter, then a row of misses per window. The
+ * simulator (with the other statistics) and tools/cachesim.c write every
+ * level's profile to <prefix>.<section>.csv when SIM_SET_PROFILE gives the
+ * prefix. */
+
+#define SETPROF_MAX_WINDOWS 1024    /* even */
+
+typedef struct Set_Profile {
+    int num_sets;
+    uint64_t *accesses;     /* [num_sets] demand accesses */
+    uint64_t *misses;       /* [num_sets] ... that missed */
+    uint64_t *evictions;    /* [num_sets] valid blocks replaced */
+    uint64_t *writebacks;   /* [num_sets] dirty blocks written to the next level */
+    /* misses over time */
+    uint32_t window;        /* demand accesses per window */
+    uint32_t in_window;     /* ... seen in the last window so far */
+    uint32_t *window_misses; /* [window_capacity][num_sets] */
+    int num_windows;        /* windows started (the last is in progress) */
+    int window_capacity;    /* rows allocated, up to SETPROF_MAX_WINDOWS */
+} Set_Profile;
+
+Set_Profile *setprof_create(int num_sets, int window);
+void setprof_destroy(Set_Profile *sp);
+void setprof_access(Set_Profile *sp, uint32_t index, int miss);
+void setprof_print(const Set_Profile *sp);
+void setprof_write(const Set_Profile *sp, FILE *f);
+
+#endif
@@ -13,16 +13,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 
 #include "shell.h"
 #include "pipe.h"
+#include "config.h"
+#include "pcprof.h"
+#include "interval.h"
 
 /***************************************************************/
 /* Statistics.                                                 */
 /***************************************************************/
 
-uint32_t stat_cycles = 0, stat_inst_retire = 0, stat_inst_fetch = 0;
-uint32_t stat_squash = 0;
+uint64_t stat_cycles = 0, stat_inst_retire = 0, stat_inst_fetch = 0;
+uint64_t stat_squash = 0;
 
 /***************************************************************/
 /* Main memory.                                                */
@@ -57,6 +61,9 @@ mem_region_t MEM_REGIONS[] = {
 
 int RUN_BIT = TRUE;
 
+/* instructions in the text segment (each program file is loaded at its start) */
+static int text_words = 0;
+
 /***************************************************************/
 /*                                                             */
 /* Procedure: mem_read_32                                      */
@@ -118,6 +125,7 @@ void help() {
   printf("----------------MIPS ISIM Help-----------------------\n");
   printf("go                     -  run program to completion         \n");
   printf("run n                  -  execute program for n instructions\n");
+  printf("ff n                   -  fast-forward n instructions functionally\n");
   printf("rdump                  -  dump architectural registers      \n");
   printf("mdump low high         -  dump memory from low to high      \n");
   printf("input reg_no reg_value - set GPR reg_no to reg_value  \n");
@@ -136,6 +144,7 @@ void cycle() {
   pipe_cycle();
 
   stat_cycles++;
+  INTERVAL_TICK();
 }
 
 /***************************************************************/
@@ -182,6 +191,34 @@ void go() {
   printf("Simulator halted\n\n");
 }
 
+/***************************************************************/
+/*                                                             */
+/* Procedure : fast_forward                                    */
+/*                                                             */
+/* Purpose   : Drain the pipeline, execute n instructions      */
+/*             functionally and resume detailed simulation     */
+/*                                                             */
+/***************************************************************/
+void fast_forward(uint64_t num_insts) {
+  if (RUN_BIT == FALSE) {
+    printf("Can't simulate, Simulator is halted\n\n");
+    return;
+  }
+
+  /* the instructions in flight retire in the pipeline first */
+  pipe.fetch_halt = 1;
+  while (RUN_BIT && !pipe_empty())
+    cycle();
+  pipe.fetch_halt = 0;
+
+  printf("Fast-forwarding %" PRIu64 " instructions...\n\n", num_insts);
+  if (RUN_BIT)
+    num_insts = pipe_fast_forward(num_insts);
+  printf("Fast-forwarded %" PRIu64 " instructions\n\n", num_insts);
+  if (RUN_BIT == FALSE)
+    printf("Simulator halted\n\n");
+}
+
 /***************************************************************/ 
 /*                                                             */
 /* Procedure : rdump                                           */
@@ -200,11 +237,16 @@ void rdump() {
 
     printf("HI: 0x%08x\n", pipe.HI);
     printf("LO: 0x%08x\n", pipe.LO);
-    printf("Cycles: %u\n", stat_cycles);
-    printf("FetchedInstr: %u\n", stat_inst_fetch);
-    printf("RetiredInstr: %u\n", stat_inst_retire);
+    printf("Cycles: %" PRIu64 "\n", stat_cycles);
+    printf("FetchedInstr: %" PRIu64 "\n", stat_inst_fetch);
+    printf("RetiredInstr: %" PRIu64 "\n", stat_inst_retire);
     printf("IPC: %0.3f\n", ((float) stat_inst_retire) / stat_cycles);
-    printf("Flushes: %u\n", stat_squash);
+    printf("Flushes: %" PRIu64 "\n", stat_squash);
+    if (pipe.fast_forwarded > 0)
+        printf("FastForwarded: %" PRIu64 "\n", pipe.fast_forwarded);
+    bpred_print_stats(pipe.bpred);
+    printf("\n");
+    pipe_print_cache_stats();
 }
 
 /***************************************************************/ 
@@ -235,6 +277,7 @@ void mdump(int start, int stop) {
 void get_command() {
   char buffer[20];
   int start, stop, cycles;
+  uint64_t num_insts;
   int register_no, register_value;
 
   printf("MIPS-SIM> ");
@@ -250,6 +293,17 @@ void get_command() {
     go();
     break;
 
+  case 'F':
+  case 'f':
+    if (buffer[1] != 'f' && buffer[1] != 'F') {
+      printf("Invalid Command\n");
+      break;
+    }
+    if (scanf("%" SCNu64, &num_insts) != 1)
+      break;
+    fast_forward(num_insts);
+    break;
+
   case 'M':
   case 'm':
     if (scanf("%i %i", &start, &stop) != 2)
@@ -350,6 +404,8 @@ void load_program(char *program_filename) {
   }
 
   printf("Read %d words from program into memory.\n\n", ii/4);
+  if (ii/4 > text_words)
+    text_words = ii/4;
 }
 
 /************************************************************/
@@ -369,6 +425,7 @@ void initialize(char *program_filename, int num_prog_files) {
     load_program(program_filename);
     while(*program_filename++ != '\0');
   }
+  pc_profile_init(MEM_TEXT_START, text_words);
     
   RUN_BIT = TRUE;
 }
@@ -380,16 +437,19 @@ void initialize(char *program_filename, int num_prog_files) {
 /***************************************************************/
 int main(int argc, char *argv[]) {                              
 
+  /* Options come first (see config.h) */
+  int first = config_parse_args(argc, argv);
+
   /* Error Checking */
-  if (argc < 2) {
-    printf("Error: usage: %s <program_file_1> <program_file_2> ...\n",
+  if (argc - first < 1) {
+    printf("Error: usage: %s [options] <program_file_1> <program_file_2> ...\n",
            argv[0]);
     exit(1);
   }
 
   printf("MIPS Simulator\n\n");
 
-  initialize(argv[1], argc - 1);
+  initialize(argv[first], argc - first);
 
   while (1)
     get_command();
@@ -24,6 +24,6 @@ uint32_t mem_read_32(uint32_t address);
 void     mem_write_32(uint32_t address, uint32_t value);
 
 /* statistics */
-extern uint32_t stat_cycles, stat_inst_retire, stat_inst_fetch, stat_squash;
+extern uint64_t stat_cycles, stat_inst_retire, stat_inst_fetch, stat_squash;
 
 #endif
@@ -0,0 +1,301 @@
+#include "stackdist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#define STACKDIST_MIN_SLOTS 16  /* initial slots per set */
+
+static void *stackdist_alloc(size_t size)
+{
+    void *p = calloc(1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate stack distance profile\n");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * @brief Creates a profiler for LRU caches with the given block size and
+ * number of sets, profiling about 1 in 'sampling' blocks (1 = all).
+ */
+Stack_Profiler *stackdist_create(int block_size, int num_sets, int sampling)
+{
+    if (block_size < CACHE_MIN_BLOCK || block_size > CACHE_MAX_BLOCK ||
+            (block_size & (block_size - 1)) != 0 || num_sets <= 0 || sampling <= 0) {
+        fprintf(stderr, "Error: Invalid stack distance profile (%d-byte blocks, %d sets, 1 in %d)\n",
+                block_size, num_sets, sampling);
+        exit(1);
+    }
+    Stack_Profiler *sd = stackdist_alloc(sizeof(Stack_Profiler));
+    sd->block_size = block_size;
+    sd->offset_bits = (int)log2(block_size);
+    sd->num_sets = num_sets;
+    sd->sampling = sampling;
+    sd->threshold = (1u << STACKDIST_HASH_BITS) / sampling;
+    if (sd->threshold == 0)
+        sd->threshold = 1;
+    sd->scale = (double)(1u << STACKDIST_HASH_BITS) / sd->threshold;
+
+    sd->sets = stackdist_alloc(num_sets * sizeof(Sd_Set));
+    blockmap_init(&sd->map, 0);
+    return sd;
+}
+
+/**
+ * @brief Destroys a profiler (and any chained after it).
+ */
+void stackdist_destroy(Stack_Profiler *sd)
+{
+    while (sd) {
+        Stack_Profiler *next = sd->next;
+        for (int i = 0; i < sd->num_sets; i++) {
+            free(sd->sets[i].tree);
+            free(sd->sets[i].owner);
+        }
+        free(sd->sets);
+        blockmap_free(&sd->map);
+        free(sd->hist);
+        free(sd);
+        sd = next;
+    }
+}
+
+/**
+ * @brief Attaches a profiler to the cache whose demand accesses it sees. The
+ * cache owns it from then on and destroys it with itself.
+ */
+void cache_add_stack_profile(Cache *cache, Stack_Profiler *sd)
+{
+    Stack_Profiler **p = &cache->stack_profile;
+    while (*p)
+        p = &(*p)->next;
+    *p = sd;
+}
+
+/*==============================================================================
+ * Sampling
+ *============================================================================*/
+
+/* 32-bit finalizer (MurmurHash3), for sampling */
+static uint32_t stackdist_hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+/*==============================================================================
+ * Reference Times
+ *============================================================================*/
+
+static void stackdist_tree_add(Sd_Set *s, uint32_t slot, int delta)
+{
+    for (uint32_t i = slot + 1; i <= s->size; i += i & -i)
+        s->tree[i] += delta;
+}
+
+/* marks in slots [0, slot] */
+static uint32_t stackdist_tree_prefix(const Sd_Set *s, uint32_t slot)
+{
+    uint32_t sum = 0;
+    for (uint32_t i = slot + 1; i > 0; i -= i & -i)
+        sum += s->tree[i];
+    return sum;
+}
+
+/**
+ * @brief Makes room for more references in a set whose slots are used up.
+ *
+ * The marked slots are renumbered from 0 in the same order, and their blocks'
+ * map entries follow them. The set doubles in size first if more than half
+ * of its slots are marked, so that compaction frees at least half of them.
+ */
+static void stackdist_compact(Stack_Profiler *sd, Sd_Set *s)
+{
+    uint32_t size = s->size ? s->size : STACKDIST_MIN_SLOTS;
+    if (s->live > size / 2)
+        size *= 2;
+
+    uint32_t *owner = stackdist_alloc(size * sizeof(uint32_t));
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < s->now; i++) {
+        if (s->owner[i] == STACKDIST_FREE)
+            continue;
+        sd->map.value[blockmap_find(&sd->map, s->owner[i])] = live;
+        owner[live++] = s->owner[i];
+    }
+    free(s->owner);
+    free(s->tree);
+    s->owner = owner;
+    s->size = size;
+    s->now = live;
+
+    /* every marked slot is now below 'live': build the tree in O(size) */
+    s->tree = stackdist_alloc((size + 1) * sizeof(uint32_t));
+    for (uint32_t i = 1; i <= size; i++) {
+        if (i <= live)
+            s->tree[i]++;
+        uint32_t parent = i + (i & -i);
+        if (parent <= size)
+            s->tree[parent] += s->tree[i];
+    }
+}
+
+static void stackdist_record(Stack_Profiler *sd, uint32_t distance)
+{
+    if (distance >= sd->hist_size) {
+        uint32_t size = sd->hist_size ? sd->hist_size : 64;
+        while (size <= distance)
+            size *= 2;
+        sd->hist = realloc(sd->hist, size * sizeof(uint64_t));
+        if (!sd->hist) {
+            fprintf(stderr, "Error: Failed to allocate stack distance profile\n");
+            exit(1);
+        }
+        memset(sd->hist + sd->hist_size, 0, (size - sd->hist_size) * sizeof(uint64_t));
+        sd->hist_size = size;
+    }
+    sd->hist[distance]++;
+}
+
+/**
+ * @brief Profiles one reference, in the set a modulo index function maps it to.
+ */
+void stackdist_access(Stack_Profiler *sd, uint32_t addr)
+{
+    stackdist_access_set(sd, addr, (addr >> sd->offset_bits) % sd->num_sets);
+}
+
+/**
+ * @brief Profiles one reference in a given set, chosen by the index function
+ * of the cache being modeled.
+ */
+void stackdist_access_set(Stack_Profiler *sd, uint32_t addr, uint32_t set)
+{
+    uint32_t block = addr >> sd->offset_bits;
+
+    sd->accesses++;
+    if (sd->sampling > 1 && (stackdist_hash(block) >> (32 - STACKDIST_HASH_BITS)) >= sd->threshold)
+        return;
+    sd->sampled++;
+
+    Sd_Set *s = &sd->sets[set];
+    uint32_t i = blockmap_find(&sd->map, block);
+    if (sd->map.key[i]) {
+        /* blocks referenced since: the marks after the previous reference */
+        uint32_t prev = sd->map.value[i];
+        stackdist_record(sd, s->live - stackdist_tree_prefix(s, prev));
+        stackdist_tree_add(s, prev, -1);
+        s->owner[prev] = STACKDIST_FREE;
+        s->live--;
+    } else {
+        sd->cold++;
+        i = blockmap_insert(&sd->map, block);
+    }
+
+    if (s->now == s->size) {
+        stackdist_compact(sd, s);
+    }
+    uint32_t slot = s->now++;
+    s->owner[slot] = block;
+    stackdist_tree_add(s, slot, 1);
+    s->live++;
+    sd->map.value[i] = slot;
+}
+
+/*==============================================================================
+ * Miss Ratio Curves
+ *============================================================================*/
+
+/**
+ * @brief Returns the smallest associativity (blocks, with one set) at which
+ * an LRU cache hits a reference at the given sampled distance.
+ */
+uint64_t stackdist_min_ways(const Stack_Profiler *sd, uint32_t distance)
+{
+    if (sd->sampling == 1)
+        return (uint64_t)distance + 1;
+    return (uint64_t)(distance * sd->scale) + 1;
+}
+
+/**
+ * @brief Returns the miss ratio of an LRU cache with the profiler's block
+ * size and set count and 'ways' ways.
+ */
+double stackdist_miss_ratio(const Stack_Profiler *sd, uint64_t ways)
+{
+    if (!sd->sampled)
+        return 0.0;
+    uint64_t misses = sd->cold;
+    for (uint32_t d = sd->hist_size; d-- > 0 && stackdist_min_ways(sd, d) > ways; )
+        misses += sd->hist[d];
+    return (double)misses / sd->sampled;
+}
+
+/* blocks an LRU cache of this set count needs to hit every reuse */
+static uint64_t stackdist_reach(const Stack_Profiler *sd)
+{
+    uint32_t d = sd->hist_size;
+    while (d > 0 && !sd->hist[d - 1])
+        d--;
+    return (d ? stackdist_min_ways(sd, d - 1) : 1) * sd->num_sets;
+}
+
+static void stackdist_print_size(uint64_t bytes)
+{
+    if (bytes >= (1ull << 30) && bytes % (1ull << 30) == 0)
+        printf("%10" PRIu64 "GB", bytes >> 30);
+    else if (bytes >= (1u << 20) && bytes % (1u << 20) == 0)
+        printf("%10" PRIu64 "MB", bytes >> 20);
+    else if (bytes >= 1024 && bytes % 1024 == 0)
+        printf("%10" PRIu64 "KB", bytes >> 10);
+    else
+        printf("%10" PRIu64 "B ", bytes);
+}
+
+/**
+ * @brief Prints the miss ratio curves of a cache's profiles at every
+ * power-of-two capacity, up to the one that holds every reused block or the
+ * size of the cache itself, whichever is larger.
+ * Set-associative profiles show only the capacities that are a whole number
+ * of ways.
+ */
+void stackdist_print_curve(Cache *cache)
+{
+    Stack_Profiler *first = cache->stack_profile;
+    uint64_t top = cache->size / first->block_size;
+
+    printf("  LRU miss ratio curve (%d-byte blocks", first->block_size);
+    if (first->sampling > 1)
+        printf(", 1 in %d blocks sampled", first->sampling);
+    printf("):\n  %12s", "size");
+    for (Stack_Profiler *sd = first; sd; sd = sd->next) {
+        if (sd->num_sets == 1)
+            printf(" %11s", "fully-assoc");
+        else
+            printf(" %6d sets", sd->num_sets);
+        if (stackdist_reach(sd) > top)
+            top = stackdist_reach(sd);
+    }
+    printf("\n");
+
+    for (uint64_t blocks = 1; ; blocks *= 2) {
+        printf("  ");
+        stackdist_print_size(blocks * first->block_size);
+        for (Stack_Profiler *sd = first; sd; sd = sd->next) {
+            if (blocks % sd->num_sets == 0)
+                printf(" %10.2f%%", stackdist_miss_ratio(sd, blocks / sd->num_sets) * 100.0);
+            else
+                printf(" %11s", "-");
+        }
+        printf("\n");
+        if (blocks >= top)
+            break;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef _STACKDIST_H_
+#define _STACKDIST_H_
+
+#include "cache.h"
+#include "blockmap.h"
+#include <stdint.h>
+
+/* LRU stack-distance profiling
+ *
+ * A Stack_Profiler computes, in one pass over a reference stream, the LRU
+ * stack distance of every reference (Mattson et al.): the number of distinct
+ * blocks of the same set referenced since the previous reference to the
+ * block. An LRU cache with that set count and A ways hits exactly the
+ * references whose distance is below A, so the distance histogram gives the
+ * miss ratio of every associativity, and with one set, of every fully
+ * associative capacity.
+ *
+ * Distances are counted with a Fenwick tree over each set's reference times,
+ * in which only the latest reference to each block is marked: the distance
+ * is the number of marks after the block's previous reference, found in
+ * O(log N). The tree is compacted in place whenever its slots run out, so it
+ * stays within twice the number of distinct blocks.
+ *
+ * For long runs the profiler can sample the blocks (SHARDS, fixed rate): a
+ * block is profiled only if a hash of its address falls below a threshold
+ * that admits about 1 in 'sampling' blocks, and the distances measured among
+ * the sampled blocks are scaled up by the same factor.
+ *
+ * A profiler attached to a cache (cache_add_stack_profile) sees the same
+ * demand accesses that the cache counts, in the sets the cache's index
+ * function picks when their set counts match; tools/mrc.c feeds one from an
+ * address trace instead, with modulo indexing. */
+
+#define STACKDIST_HASH_BITS 24  /* sampling hash range */
+#define STACKDIST_FREE 0xFFFFFFFFu /* slot no longer the latest reference */
+
+/* one set's reference times */
+typedef struct Sd_Set {
+    uint32_t *tree;         /* [size + 1] Fenwick tree of marks, 1-based */
+    uint32_t *owner;        /* [size] block referenced in each slot, or STACKDIST_FREE */
+    uint32_t size;          /* slots */
+    uint32_t now;           /* next slot to use */
+    uint32_t live;          /* marked slots: distinct blocks seen in this set */
+} Sd_Set;
+
+typedef struct Stack_Profiler {
+    int block_size;
+    int offset_bits;
+    int num_sets;           /* any positive count */
+    int sampling;           /* profile about 1 in this many blocks */
+    uint32_t threshold;     /* ... those whose hash is below this */
+    double scale;           /* distance scale: 2^STACKDIST_HASH_BITS / threshold */
+    Sd_Set *sets;           /* [num_sets] */
+    Block_Map map;          /* block -> slot of its latest reference */
+    /* Statistics */
+    uint64_t *hist;         /* [hist_size] references by sampled distance */
+    uint32_t hist_size;
+    uint64_t accesses;      /* references seen */
+    uint64_t sampled;       /* ... that were profiled */
+    uint64_t cold;          /* ... first references to a block */
+    struct Stack_Profiler *next; /* next profile of the same cache */
+} Stack_Profiler;
+
+Stack_Profiler *stackdist_create(int block_size, int num_sets, int sampling);
+void stackdist_destroy(Stack_Profiler *sd);
+void stackdist_access(Stack_Profiler *sd, uint32_t addr);
+void stackdist_access_set(Stack_Profiler *sd, uint32_t addr, uint32_t set);
+uint64_t stackdist_min_ways(const Stack_Profiler *sd, uint32_t distance);
+double stackdist_miss_ratio(const Stack_Profiler *sd, uint64_t ways);
+void cache_add_stack_profile(Cache *cache, Stack_Profiler *sd);
+void stackdist_print_curve(Cache *cache);
+
+#endif
@@ -0,0 +1,163 @@
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static Stat *stats;
+static int stats_count, stats_capacity;
+
+/**
+ * @brief Appends an entry named "<prefix>.<name>" (just 'name' without a
+ * prefix) and returns it, zeroed.
+ */
+static Stat *stats_add(const char *prefix, const char *name, Stat_Kind kind, const char *description)
+{
+    if (stats_count == stats_capacity) {
+        stats_capacity = stats_capacity ? 2 * stats_capacity : 64;
+        stats = realloc(stats, stats_capacity * sizeof(Stat));
+        if (!stats) {
+            fprintf(stderr, "Error: Failed to allocate statistics registry\n");
+            exit(1);
+        }
+    }
+    Stat *s = &stats[stats_count++];
+    memset(s, 0, sizeof(Stat));
+    if (prefix && *prefix)
+        snprintf(s->name, sizeof(s->name), "%s.%s", prefix, name);
+    else
+        snprintf(s->name, sizeof(s->name), "%s", name);
+    s->kind = kind;
+    s->description = description;
+    return s;
+}
+
+/**
+ * @brief Registers a counter.
+ */
+void stats_counter(const char *prefix, const char *name, const uint64_t *value, const char *description)
+{
+    stats_add(prefix, name, STAT_COUNTER, description)->value = value;
+}
+
+/**
+ * @brief Registers the metric numerator / denominator * scale.
+ */
+void stats_ratio(const char *prefix, const char *name, const uint64_t *numerator,
+        const uint64_t *denominator, double scale, const char *description)
+{
+    Stat *s = stats_add(prefix, name, STAT_RATIO, description);
+    s->value = numerator;
+    s->denominator = denominator;
+    s->scale = scale;
+}
+
+/**
+ * @brief Registers a histogram of *num_buckets counters at *buckets.
+ */
+void stats_histogram(const char *prefix, const char *name, uint64_t *const *buckets,
+        const uint32_t *num_buckets, const char *description)
+{
+    Stat *s = stats_add(prefix, name, STAT_HISTOGRAM, description);
+    s->buckets = buckets;
+    s->num_buckets = num_buckets;
+}
+
+/*==============================================================================
+ * Output
+ *============================================================================*/
+
+/* the value of a ratio whose denominator is not zero */
+static double stats_ratio_value(const Stat *s)
+{
+    return (double)*s->value / *s->denominator * s->scale;
+}
+
+static void stats_dump_json(FILE *f)
+{
+    fprintf(f, "{");
+    for (int i = 0; i < stats_count; i++) {
+        const Stat *s = &stats[i];
+        fprintf(f, "%s\n  \"%s\": ", i ? "," : "", s->name);
+        if (s->kind == STAT_COUNTER) {
+            fprintf(f, "%" PRIu64, *s->value);
+        } else if (s->kind == STAT_RATIO) {
+            if (*s->denominator)
+                fprintf(f, "%.6g", stats_ratio_value(s));
+            else
+                fprintf(f, "null");
+        } else {
+            fprintf(f, "[");
+            for (uint32_t b = 0; b < *s->num_buckets; b++)
+                fprintf(f, "%s%" PRIu64, b ? "," : "", (*s->buckets)[b]);
+            fprintf(f, "]");
+        }
+    }
+    fprintf(f, "\n}\n");
+}
+
+static void stats_end_row(FILE *f, int csv, const Stat *s)
+{
+    if (csv)
+        fprintf(f, ",\"%s\"", s->description ? s->description : "");
+    fprintf(f, "\n");
+}
+
+/* one row (line) per value; histogram buckets are "<name>.<bucket>" */
+static void stats_dump_rows(FILE *f, int csv)
+{
+    const char *sep = csv ? "," : ": ";
+
+    if (csv)
+        fprintf(f, "name,value,description\n");
+    for (int i = 0; i < stats_count; i++) {
+        const Stat *s = &stats[i];
+        if (s->kind == STAT_HISTOGRAM) {
+            for (uint32_t b = 0; b < *s->num_buckets; b++) {
+                fprintf(f, "%s.%u%s%" PRIu64, s->name, b, sep, (*s->buckets)[b]);
+                stats_end_row(f, csv, s);
+            }
+            continue;
+        }
+        fprintf(f, "%s%s", s->name, sep);
+        if (s->kind == STAT_COUNTER)
+            fprintf(f, "%" PRIu64, *s->value);
+        else if (*s->denominator)
+            fprintf(f, "%.6g", stats_ratio_value(s));
+        stats_end_row(f, csv, s);
+    }
+}
+
+/**
+ * @brief Writes every registered statistic to 'f'.
+ */
+void stats_dump(FILE *f, Stats_Format format)
+{
+    if (format == STATS_JSON)
+        stats_dump_json(f);
+    else
+        stats_dump_rows(f, format == STATS_CSV);
+}
+
+/**
+ * @brief Writes the registry to 'path', as JSON if it ends in .json, CSV if
+ * it ends in .csv and text otherwise. Returns 0, or -1 if the file can't be
+ * opened.
+ */
+int stats_write(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    Stats_Format format = STATS_TEXT;
+    if (ext && strcmp(ext, ".json") == 0)
+        format = STATS_JSON;
+    else if (ext && strcmp(ext, ".csv") == 0)
+        format = STATS_CSV;
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open statistics file %s\n", path);
+        return -1;
+    }
+    stats_dump(f, format);
+    fclose(f);
+    return 0;
+}
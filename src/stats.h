@@ -0,0 +1,58 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Statistics registry
+ *
+ * Subsystems register their 64-bit counters here by name, once, when they
+ * are set up; the registry only keeps pointers, so counting stays a plain
+ * increment and the values are read when the registry is dumped. Names are
+ * "<prefix>.<name>" (e.g. "dcache.misses"), in registration order.
+ *
+ * Besides counters there are derived metrics, numerator / denominator *
+ * scale (IPC, hit rates, MPKI: null / empty while the denominator is zero),
+ * and histograms, whose buckets may be reallocated as they grow.
+ *
+ * stats_dump() writes everything as one flat JSON object, as "name,value"
+ * CSV rows (with the description) or as "name: value" text lines. The
+ * simulator dumps the registry on rdump to the file named by
+ * SIM_STATS_FILE, picking the format from its extension (.json, .csv,
+ * anything else text). */
+
+#define STATS_MAX_NAME 64
+
+typedef enum {
+    STAT_COUNTER,
+    STAT_RATIO,
+    STAT_HISTOGRAM
+} Stat_Kind;
+
+typedef enum {
+    STATS_TEXT,
+    STATS_JSON,
+    STATS_CSV
+} Stats_Format;
+
+typedef struct Stat {
+    char name[STATS_MAX_NAME];
+    Stat_Kind kind;
+    const char *description;
+    const uint64_t *value;          /* counter, or numerator of a ratio */
+    const uint64_t *denominator;    /* ratio */
+    double scale;                   /* ratio */
+    uint64_t *const *buckets;       /* histogram: [*num_buckets] */
+    const uint32_t *num_buckets;
+} Stat;
+
+void stats_counter(const char *prefix, const char *name, const uint64_t *value, const char *description);
+void stats_ratio(const char *prefix, const char *name, const uint64_t *numerator,
+        const uint64_t *denominator, double scale, const char *description);
+void stats_histogram(const char *prefix, const char *name, uint64_t *const *buckets,
+        const uint32_t *num_buckets, const char *description);
+
+void stats_dump(FILE *f, Stats_Format format);
+int stats_write(const char *path);
+
+#endif
@@ -0,0 +1,200 @@
+#ifdef SIM_TRACE
+
+#include "trace.h"
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+/*==============================================================================
+ * Trace Ring Buffer
+ *
+ * Single producer (the simulator thread) and single consumer (the writer
+ * thread). The producer owns 'head', the writer owns 'tail'; both only ever
+ * grow and are reduced modulo TRACE_RING_SIZE when indexing. The producer
+ * wakes the writer every TRACE_RING_CHUNK records and only blocks when the
+ * ring is completely full.
+ *============================================================================*/
+
+#define TRACE_RING_SIZE  (1 << 16) /* records, power of two */
+#define TRACE_RING_CHUNK (1 << 12) /* records per writer wakeup */
+
+int trace_level = TRACE_INFO;
+unsigned trace_cats = 0;
+
+static Trace_Record trace_ring[TRACE_RING_SIZE];
+static _Atomic uint64_t trace_head, trace_tail;
+static atomic_int trace_stop;
+
+static FILE *trace_file;
+static pthread_t trace_thread;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trace_data = PTHREAD_COND_INITIALIZER;  /* records available */
+static pthread_cond_t trace_space = PTHREAD_COND_INITIALIZER; /* ring drained */
+
+static const char *trace_cat_names[] = { "pipe", "cache", "mem", "branch" };
+
+/**
+ * @brief Writer thread: drains the ring to the trace file.
+ */
+static void *trace_writer(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&trace_lock);
+        while (atomic_load(&trace_head) == atomic_load(&trace_tail) && !atomic_load(&trace_stop)) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 50 * 1000 * 1000;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&trace_data, &trace_lock, &ts);
+        }
+        pthread_mutex_unlock(&trace_lock);
+
+        uint64_t head = atomic_load_explicit(&trace_head, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&trace_tail, memory_order_relaxed);
+        if (head == tail && atomic_load(&trace_stop))
+            break;
+
+        /* write out [tail, head) in at most two contiguous pieces */
+        while (tail != head) {
+            uint64_t start = tail & (TRACE_RING_SIZE - 1);
+            uint64_t count = head - tail;
+            if (start + count > TRACE_RING_SIZE)
+                count = TRACE_RING_SIZE - start;
+            fwrite(&trace_ring[start], sizeof(Trace_Record), count, trace_file);
+            tail += count;
+        }
+        atomic_store_explicit(&trace_tail, tail, memory_order_release);
+
+        pthread_mutex_lock(&trace_lock);
+        pthread_cond_signal(&trace_space);
+        pthread_mutex_unlock(&trace_lock);
+    }
+    fflush(trace_file);
+    return NULL;
+}
+
+/**
+ * @brief Parses a comma-separated category list into a mask.
+ */
+static unsigned trace_parse_cats(const char *s)
+{
+    unsigned mask = 0;
+    char buf[128];
+    strncpy(buf, s, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        if (strcmp(tok, "all") == 0) {
+            mask |= TRACE_CAT_ALL;
+            continue;
+        }
+        int found = 0;
+        for (int i = 0; i < (int)(sizeof(trace_cat_names) / sizeof(trace_cat_names[0])); i++) {
+            if (strcmp(tok, trace_cat_names[i]) == 0) {
+                mask |= 1u << i;
+                found = 1;
+            }
+        }
+        if (!found)
+            fprintf(stderr, "Warning: unknown trace category '%s'\n", tok);
+    }
+    return mask;
+}
+
+/**
+ * @brief Opens the trace file and starts the writer thread, if requested.
+ */
+void trace_init()
+{
+    const char *path = getenv("SIM_TRACE_FILE");
+    if (!path || !*path)
+        return;
+
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+        fprintf(stderr, "Error: Can't open trace file %s\n", path);
+        return;
+    }
+
+    Trace_Header header = { TRACE_MAGIC, TRACE_VERSION, sizeof(Trace_Record) };
+    fwrite(&header, sizeof(header), 1, trace_file);
+
+    const char *level = getenv("SIM_TRACE_LEVEL");
+    if (level)
+        trace_level = atoi(level);
+    const char *cats = getenv("SIM_TRACE_CATS");
+    trace_cats = cats ? trace_parse_cats(cats) : TRACE_CAT_ALL;
+
+    if (pthread_create(&trace_thread, NULL, trace_writer, NULL) != 0) {
+        fprintf(stderr, "Error: Can't start trace writer\n");
+        fclose(trace_file);
+        trace_file = NULL;
+        trace_cats = 0;
+        return;
+    }
+    atexit(trace_shutdown);
+}
+
+/**
+ * @brief Stops tracing, drains the ring and closes the trace file.
+ */
+void trace_shutdown()
+{
+    if (!trace_file)
+        return;
+
+    trace_cats = 0;
+    pthread_mutex_lock(&trace_lock);
+    atomic_store(&trace_stop, 1);
+    pthread_cond_signal(&trace_data);
+    pthread_mutex_unlock(&trace_lock);
+    pthread_join(trace_thread, NULL);
+
+    fclose(trace_file);
+    trace_file = NULL;
+}
+
+/**
+ * @brief Appends one record to the ring buffer (called through TRACE()).
+ */
+void trace_emit(int event, int level, int category, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    uint64_t head = atomic_load_explicit(&trace_head, memory_order_relaxed);
+
+    /* ring full: hand the writer a nudge and wait for space */
+    if (head - atomic_load_explicit(&trace_tail, memory_order_acquire) >= TRACE_RING_SIZE) {
+        pthread_mutex_lock(&trace_lock);
+        pthread_cond_signal(&trace_data);
+        while (head - atomic_load(&trace_tail) >= TRACE_RING_SIZE)
+            pthread_cond_wait(&trace_space, &trace_lock);
+        pthread_mutex_unlock(&trace_lock);
+    }
+
+    Trace_Record *rec = &trace_ring[head & (TRACE_RING_SIZE - 1)];
+    rec->cycle = stat_cycles;
+    rec->event = event;
+    rec->level = level;
+    rec->category = category;
+    rec->arg[0] = a0;
+    rec->arg[1] = a1;
+    rec->arg[2] = a2;
+    rec->arg[3] = a3;
+    rec->pad = 0;
+    atomic_store_explicit(&trace_head, head + 1, memory_order_release);
+
+    if (((head + 1) & (TRACE_RING_CHUNK - 1)) == 0) {
+        pthread_mutex_lock(&trace_lock);
+        pthread_cond_signal(&trace_data);
+        pthread_mutex_unlock(&trace_lock);
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+/* Event tracing
+ *
+ * Hot-path diagnostics go through TRACE() instead of printf. Without
+ * SIM_TRACE (the default, release build) the macro expands to nothing and its
+ * arguments are never evaluated. With SIM_TRACE each enabled event appends a
+ * fixed-size binary record to an in-memory ring buffer that a background
+ * thread drains to a file; tools/tracedump.c renders the file as text.
+ *
+ * Runtime filtering (SIM_TRACE builds only), read at trace_init():
+ *   SIM_TRACE_FILE   output file (tracing is off when unset)
+ *   SIM_TRACE_LEVEL  highest level recorded (1-5, default TRACE_INFO)
+ *   SIM_TRACE_CATS   comma-separated category names, or "all" (default)
+ * SIM_TRACE_MAX_LEVEL removes events above a level at compile time. */
+
+/* levels */
+#define TRACE_ERROR   1
+#define TRACE_WARN    2
+#define TRACE_INFO    3
+#define TRACE_DEBUG   4
+#define TRACE_VERBOSE 5
+
+/* categories (bit mask) */
+#define TRACE_CAT_PIPE   0x01
+#define TRACE_CAT_CACHE  0x02
+#define TRACE_CAT_MEM    0x04
+#define TRACE_CAT_BRANCH 0x08
+#define TRACE_CAT_ALL    0xFF
+
+/* X(name, category, level, format): the format takes the four record
+ * arguments in order and is used by the decoder only. */
+#define TRACE_EVENTS(X) \
+    X(FETCH,          TRACE_CAT_PIPE,   TRACE_VERBOSE, "fetch pc=%08x inst=%08x") \
+    X(ICACHE_STALL,   TRACE_CAT_PIPE,   TRACE_INFO,    "icache miss pc=%08x stall=%u") \
+    X(DCACHE_STALL,   TRACE_CAT_PIPE,   TRACE_INFO,    "dcache miss pc=%08x addr=%08x stall=%u") \
+    X(RECOVER,        TRACE_CAT_BRANCH, TRACE_DEBUG,   "branch recovery dest=%08x flush=%u") \
+    X(CACHE_MISS,     TRACE_CAT_CACHE,  TRACE_DEBUG,   "cache%u miss addr=%08x set=%u way=%u") \
+    X(CACHE_EVICT,    TRACE_CAT_CACHE,  TRACE_DEBUG,   "cache%u evict set=%u way=%u policy=%u") \
+    X(CACHE_INSERT,   TRACE_CAT_CACHE,  TRACE_VERBOSE, "cache%u insert set=%u way=%u state=%u") \
+    X(CACHE_WRITEBACK,TRACE_CAT_CACHE,  TRACE_DEBUG,   "cache%u writeback set=%u way=%u tag=%08x")
+
+#define TRACE_DEF_ID(name, cat, lvl, fmt) TR_##name,
+#define TRACE_DEF_CAT(name, cat, lvl, fmt) TRCAT_##name = (cat),
+#define TRACE_DEF_LVL(name, cat, lvl, fmt) TRLVL_##name = (lvl),
+enum { TRACE_EVENTS(TRACE_DEF_ID) TR_NUM_EVENTS };
+enum { TRACE_EVENTS(TRACE_DEF_CAT) };
+enum { TRACE_EVENTS(TRACE_DEF_LVL) };
+
+/* on-disk format: one Trace_Header, then Trace_Records until EOF */
+#define TRACE_MAGIC   0x4352544Du /* "MTRC" */
+#define TRACE_VERSION 1
+
+typedef struct Trace_Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+} Trace_Header;
+
+typedef struct Trace_Record {
+    uint64_t cycle;         /* stat_cycles when the event was emitted */
+    uint16_t event;         /* TR_* */
+    uint8_t level;
+    uint8_t category;
+    uint32_t arg[4];
+    uint32_t pad;
+} Trace_Record;
+
+#ifdef SIM_TRACE
+
+#ifndef SIM_TRACE_MAX_LEVEL
+#define SIM_TRACE_MAX_LEVEL TRACE_VERBOSE
+#endif
+
+extern int trace_level;      /* runtime level threshold */
+extern unsigned trace_cats;  /* runtime category mask (0 = tracing off) */
+
+void trace_init();
+void trace_shutdown();
+void trace_emit(int event, int level, int category, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+#define TRACE(ev, a0, a1, a2, a3)                                              \
+    do {                                                                       \
+        if (TRLVL_##ev <= SIM_TRACE_MAX_LEVEL && TRLVL_##ev <= trace_level &&  \
+                (TRCAT_##ev & trace_cats))                                     \
+            trace_emit(TR_##ev, TRLVL_##ev, TRCAT_##ev, (uint32_t)(a0),        \
+                    (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3));           \
+    } while (0)
+
+#else
+
+#define trace_init() ((void)0)
+#define trace_shutdown() ((void)0)
+#define TRACE(ev, a0, a1, a2, a3) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,355 @@
+/* cachesim: trace-driven simulation of the cache hierarchy alone.
+ *
+ * usage: cachesim [-f atr|din|lackey] [-c config] [--section.key=value ...]
+ *                 <trace_file>
+ *
+ * Streams a reference trace through the hierarchy the options describe (see
+ * config.h) and prints the configuration and the statistics of every level,
+ * as the simulator's rdump does, without the pipeline. Trace formats (-f;
+ * by default recognised from the file's contents):
+ *
+ *   atr     an address trace captured with SIM_ADDR_TRACE (addrtrace.h)
+ *   din     Dinero "label address" lines (hex address): label 0 is a read,
+ *           1 a write, 2 an instruction fetch, 4 writes every dirty block
+ *           back; other labels are skipped
+ *   lackey  valgrind --tool=lackey --trace-mem=yes output: "I", " L", " S"
+ *           and " M" (load then store) lines of "address,size"; the rest of
+ *           the output is skipped
+ *
+ * Text traces are mapped and parsed in place. Addresses are 32 bits wide;
+ * higher bits (64-bit lackey traces) are dropped, with a warning. A
+ * reference that spans several L1 blocks makes one access to each.
+ *
+ * Caches are modelled tag-only and blocking, on a clock that advances one
+ * cycle per reference plus the latency of every miss; the clock only paces
+ * the D-cache prefetcher (MSHRs are not used). At the end of the trace every
+ * dirty block is written back, as the simulator does when the program
+ * exits. Per-set profiles (set_profile) are written to files when
+ * SIM_SET_PROFILE gives their prefix, and the statistics registry to
+ * SIM_STATS_FILE (stats.h), as in the simulator. For a trace
+ * captured from the simulator, misses and writebacks then match its own;
+ * its access and hit counts are higher by the accesses it repeats after a
+ * miss and by the read half of sub-word stores. */
+
+#include "cache.h"
+#include "prefetch.h"
+#include "config.h"
+#include "addrtrace.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef enum {
+    FORMAT_AUTO,
+    FORMAT_ATR,
+    FORMAT_DIN,
+    FORMAT_LACKEY
+} TraceFormat;
+
+static const char *const format_names[] = { "auto", "atr", "din", "lackey", NULL };
+
+/* the cache code runs without a pipeline: a reference clock, no memory */
+uint64_t stat_cycles = 0;
+uint32_t mem_read_32(uint32_t address) { (void)address; return 0; }
+void mem_write_32(uint32_t address, uint32_t value) { (void)address; (void)value; }
+
+static Cache_Hierarchy sim;
+static uint64_t sim_refs[3];        /* by AddrType */
+static uint64_t sim_skipped;        /* trace lines that are not references */
+static uint64_t sim_truncated;      /* addresses above 32 bits */
+
+/**
+ * @brief Makes one reference, one access per L1 block it touches.
+ */
+static inline void cachesim_ref(AddrType type, uint32_t pc, uint32_t addr, uint32_t size)
+{
+    Cache *l1 = type == ADDR_IFETCH ? sim.icache : sim.dcache;
+    uint32_t mask = ~(uint32_t)(l1->block_size - 1);
+    uint32_t last = (addr + (size ? size : 1) - 1) & mask;
+    uint32_t data;
+
+    sim_refs[type]++;
+    l1->access_pc = pc;
+    for (uint32_t a = addr;; a = (a & mask) + l1->block_size) {
+        int hit = cache_access(l1, a & ~3, &data, type == ADDR_STORE, 0);
+        if (l1->prefetcher)
+            prefetch_train(l1->prefetcher, pc, a, hit);
+        stat_cycles += 1 + l1->service_latency;
+        if ((a & mask) == last)
+            break;
+    }
+}
+
+/**
+ * @brief Writes every dirty block back, upper levels first.
+ */
+static void cachesim_flush()
+{
+    cache_flush(sim.icache);
+    cache_flush(sim.dcache);
+    cache_flush(sim.l2);
+    cache_flush(sim.llc);
+}
+
+/*==============================================================================
+ * Trace Readers
+ *============================================================================*/
+
+static void cachesim_read_atr(const char *path)
+{
+    Addr_Trace_Reader *r = addr_trace_open(path);
+    Addr_Record *chunk = malloc(ADDR_CHUNK_RECORDS * sizeof(Addr_Record));
+    int n;
+
+    while ((n = addr_trace_read(r, chunk)) > 0) {
+        for (int i = 0; i < n; i++)
+            cachesim_ref(chunk[i].type, chunk[i].pc, chunk[i].addr, chunk[i].size);
+    }
+    free(chunk);
+    addr_trace_close_reader(r);
+}
+
+/* parses hex digits (with an optional 0x); drops bits above 32 */
+static const char *cachesim_hex(const char *p, const char *end, uint32_t *out)
+{
+    uint64_t v = 0;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+    for (; p < end; p++) {
+        int d;
+        if (*p >= '0' && *p <= '9')
+            d = *p - '0';
+        else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f')
+            d = (*p | 0x20) - 'a' + 10;
+        else
+            break;
+        v = v << 4 | d;
+    }
+    if (v >> 32)
+        sim_truncated++;
+    *out = (uint32_t)v;
+    return p;
+}
+
+static const char *cachesim_skip_line(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+static void cachesim_read_din(const char *p, const char *end)
+{
+    uint32_t last_fetch = 0, addr;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        int label = p < end ? *p - '0' : -1;
+        if (p + 1 >= end || (p[1] != ' ' && p[1] != '\t') || label < 0 || label > 4) {
+            sim_skipped += p < end && *p != '\n';
+            p = cachesim_skip_line(p, end);
+            continue;
+        }
+        p += 2;
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        p = cachesim_hex(p, end, &addr);
+        switch (label) {
+            case 0:
+                cachesim_ref(ADDR_LOAD, last_fetch, addr, 1);
+                break;
+            case 1:
+                cachesim_ref(ADDR_STORE, last_fetch, addr, 1);
+                break;
+            case 2:
+                cachesim_ref(ADDR_IFETCH, addr, addr, 1);
+                last_fetch = addr;
+                break;
+            case 4:
+                cachesim_flush();
+                break;
+            default:
+                sim_skipped++;
+                break;
+        }
+        p = cachesim_skip_line(p, end);
+    }
+}
+
+static void cachesim_read_lackey(const char *p, const char *end)
+{
+    uint32_t last_fetch = 0, addr;
+
+    while (p < end) {
+        const char *line = p;
+        while (p < end && *p == ' ')
+            p++;
+        char kind = p < end ? *p : 0;
+        if ((kind != 'I' && kind != 'L' && kind != 'S' && kind != 'M') || p + 1 >= end || p[1] != ' ' ||
+                (kind == 'I') != (p == line)) {
+            sim_skipped += p < end && *p != '\n';
+            p = cachesim_skip_line(p, end);
+            continue;
+        }
+        p += 2;
+        while (p < end && *p == ' ')
+            p++;
+        p = cachesim_hex(p, end, &addr);
+        uint32_t size = 0;
+        if (p < end && *p == ',') {
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+                size = size * 10 + (*p - '0');
+        }
+        switch (kind) {
+            case 'I':
+                cachesim_ref(ADDR_IFETCH, addr, addr, size);
+                last_fetch = addr;
+                break;
+            case 'L':
+                cachesim_ref(ADDR_LOAD, last_fetch, addr, size);
+                break;
+            case 'M':
+                cachesim_ref(ADDR_LOAD, last_fetch, addr, size);
+                cachesim_ref(ADDR_STORE, last_fetch, addr, size);
+                break;
+            case 'S':
+                cachesim_ref(ADDR_STORE, last_fetch, addr, size);
+                break;
+        }
+        p = cachesim_skip_line(p, end);
+    }
+}
+
+/**
+ * @brief Maps a text trace and hands it to its parser.
+ */
+static void cachesim_read_text(const char *path, TraceFormat format)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Can't open trace file %s\n", path);
+        exit(1);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Can't map trace file %s\n", path);
+        exit(1);
+    }
+    madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+
+    if (format == FORMAT_DIN)
+        cachesim_read_din(map, map + st.st_size);
+    else
+        cachesim_read_lackey(map, map + st.st_size);
+    munmap((void *)map, st.st_size);
+}
+
+/**
+ * @brief Recognises a trace format from the start of the file: the address
+ * trace magic, a lackey line ("I  ", " L ", "==pid==") or else din.
+ */
+static TraceFormat cachesim_detect(const char *path)
+{
+    char buf[64] = { 0 };
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open trace file %s\n", path);
+        exit(1);
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+
+    uint32_t magic = ADDR_TRACE_MAGIC;
+    if (n >= 4 && memcmp(buf, &magic, 4) == 0)
+        return FORMAT_ATR;
+    if (strncmp(buf, "==", 2) == 0 || strncmp(buf, "I  ", 3) == 0 ||
+            (buf[0] == ' ' && strchr("LSM", buf[1]) && buf[1] && buf[2] == ' '))
+        return FORMAT_LACKEY;
+    return FORMAT_DIN;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-f atr|din|lackey] [-c config] [--section.key=value ...] <trace_file>\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    TraceFormat format = FORMAT_AUTO;
+    int i = 1;
+
+    /* -f first, then the configuration options */
+    for (; i + 1 < argc && strcmp(argv[i], "-f") == 0; i += 2) {
+        for (format = 0; format_names[format] && strcmp(format_names[format], argv[i + 1]) != 0; format++)
+            ;
+        if (!format_names[format])
+            usage(argv[0]);
+    }
+    argv[i - 1] = argv[0];
+    i += config_parse_args(argc - (i - 1), argv + (i - 1)) - 1;
+    if (argc - i != 1)
+        usage(argv[0]);
+    const char *path = argv[i];
+    if (format == FORMAT_AUTO)
+        format = cachesim_detect(path);
+
+    cache_tag_only = 1;
+    cache_mem_latency = sim_config.mem_latency;
+    config_create_caches(&sim_config, &sim);
+    cache_register_stats(sim.icache, "icache");
+    cache_register_stats(sim.dcache, "dcache");
+    cache_register_stats(sim.l2, "l2");
+    if (sim.llc)
+        cache_register_stats(sim.llc, "llc");
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (format == FORMAT_ATR)
+        cachesim_read_atr(path);
+    else
+        cachesim_read_text(path, format);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    cachesim_flush();
+
+    uint64_t refs = sim_refs[ADDR_IFETCH] + sim_refs[ADDR_LOAD] + sim_refs[ADDR_STORE];
+    printf("Trace: %s (%s), %llu references: %llu fetches, %llu loads, %llu stores\n\n", path,
+            format_names[format], (unsigned long long)refs, (unsigned long long)sim_refs[ADDR_IFETCH],
+            (unsigned long long)sim_refs[ADDR_LOAD], (unsigned long long)sim_refs[ADDR_STORE]);
+    config_print();
+    cache_print_stats(sim.icache, "L1 I-Cache");
+    cache_print_stats(sim.dcache, "L1 D-Cache");
+    cache_print_stats(sim.l2, "L2 Cache");
+    if (sim.llc)
+        cache_print_stats(sim.llc, "LLC");
+    const char *prefix = getenv("SIM_SET_PROFILE");
+    if (prefix && *prefix)
+        config_write_set_profiles(&sim, prefix);
+    const char *stats_path = getenv("SIM_STATS_FILE");
+    if (stats_path && *stats_path)
+        stats_write(stats_path);
+
+    if (sim_skipped)
+        fprintf(stderr, "Warning: %llu trace lines were not references and were skipped\n",
+                (unsigned long long)sim_skipped);
+    if (sim_truncated)
+        fprintf(stderr, "Warning: %llu addresses were wider than 32 bits and were truncated\n",
+                (unsigned long long)sim_truncated);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%llu references in %.2fs (%.1fM references/s)\n", (unsigned long long)refs, secs,
+            secs > 0 ? refs / secs / 1e6 : 0.0);
+    config_destroy_caches(&sim);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/* mrc: LRU miss ratio curves of a recorded address trace, in one pass.
+ *
+ * usage: mrc [-b block_sizes] [-s set_counts] [-r sampling] [-t i|d|all]
+ *            <trace_file>
+ *
+ * The trace is an address trace captured with SIM_ADDR_TRACE (addrtrace.h).
+ * One stack distance profiler (stackdist.h) runs for every combination of
+ * the comma-separated block sizes (-b, default 64) and set counts (-s,
+ * default 1, i.e. fully associative), all in the same pass over the
+ * references selected by -t: instruction fetches, loads and stores (the
+ * default, d), or both streams as if through one unified cache. -r N
+ * profiles about 1 in N blocks (SHARDS sampling).
+ *
+ * The output is the complete curve of each profile as CSV: one row per
+ * associativity at which the miss ratio changes, giving the capacity in
+ * bytes (block_size * sets * ways) and the miss ratio of an LRU cache of that
+ * geometry, which holds until the next row. */
+
+#include "stackdist.h"
+#include "addrtrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MRC_MAX_LIST 16
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-b block_sizes] [-s set_counts] [-r sampling] [-t i|d|all] "
+            "<trace_file>\n", prog);
+    exit(1);
+}
+
+/**
+ * @brief Parses a comma-separated list of positive integers.
+ * @return the number of values, or -1 if the list is not valid.
+ */
+static int mrc_parse_list(const char *text, int *values)
+{
+    int n = 0;
+    char *end;
+
+    do {
+        long v = strtol(text, &end, 0);
+        if (end == text || v <= 0 || n == MRC_MAX_LIST)
+            return -1;
+        values[n++] = (int)v;
+        text = end + 1;
+    } while (*end == ',');
+    return *end ? -1 : n;
+}
+
+static void mrc_print_row(const Stack_Profiler *sd, uint64_t ways, uint64_t hits)
+{
+    printf("%d,%d,%llu,%llu,%.6f\n", sd->block_size, sd->num_sets, (unsigned long long)ways,
+            (unsigned long long)(ways * sd->num_sets * sd->block_size),
+            (double)(sd->sampled - hits) / sd->sampled);
+}
+
+/**
+ * @brief Prints one profile's curve: a row at one way, then one at each
+ * associativity that turns more references into hits.
+ */
+static void mrc_print_curve(const Stack_Profiler *sd)
+{
+    uint64_t hits = 0, ways = 1;
+
+    if (!sd->sampled)
+        return;
+    for (uint32_t d = 0; d < sd->hist_size; d++) {
+        if (!sd->hist[d])
+            continue;
+        uint64_t w = stackdist_min_ways(sd, d);
+        if (w != ways)
+            mrc_print_row(sd, ways, hits);
+        ways = w;
+        hits += sd->hist[d];
+    }
+    mrc_print_row(sd, ways, hits);
+}
+
+int main(int argc, char *argv[])
+{
+    int block_sizes[MRC_MAX_LIST] = { 64 }, set_counts[MRC_MAX_LIST] = { 1 };
+    int num_block_sizes = 1, num_set_counts = 1, sampling = 1;
+    int want_fetch = 0, want_data = 1;
+    int i = 1;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-b") == 0)
+            num_block_sizes = mrc_parse_list(argv[i + 1], block_sizes);
+        else if (strcmp(argv[i], "-s") == 0)
+            num_set_counts = mrc_parse_list(argv[i + 1], set_counts);
+        else if (strcmp(argv[i], "-r") == 0)
+            sampling = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0) {
+            if (strcmp(argv[i + 1], "all") != 0 && strcmp(argv[i + 1], "i") != 0 &&
+                    strcmp(argv[i + 1], "d") != 0)
+                usage(argv[0]);
+            want_fetch = argv[i + 1][0] != 'd';
+            want_data = argv[i + 1][0] != 'i';
+        } else
+            usage(argv[0]);
+        if (num_block_sizes < 0 || num_set_counts < 0 || sampling <= 0)
+            usage(argv[0]);
+    }
+    if (argc - i != 1)
+        usage(argv[0]);
+
+    Addr_Trace_Reader *reader = addr_trace_open(argv[i]);
+    Addr_Record *chunk = malloc(ADDR_CHUNK_RECORDS * sizeof(Addr_Record));
+
+    int num_profiles = num_block_sizes * num_set_counts;
+    Stack_Profiler **profiles = malloc(num_profiles * sizeof(Stack_Profiler *));
+    for (int b = 0; b < num_block_sizes; b++) {
+        for (int s = 0; s < num_set_counts; s++)
+            profiles[b * num_set_counts + s] = stackdist_create(block_sizes[b], set_counts[s], sampling);
+    }
+
+    /* one pass, a chunk at a time */
+    struct timespec start, end;
+    uint64_t count = 0;
+    int n;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((n = addr_trace_read(reader, chunk)) > 0) {
+        for (int r = 0; r < n; r++) {
+            if (chunk[r].type == ADDR_IFETCH ? !want_fetch : !want_data)
+                continue;
+            for (int p = 0; p < num_profiles; p++)
+                stackdist_access(profiles[p], chunk[r].addr);
+        }
+        count += n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("block_size,sets,ways,capacity,miss_ratio\n");
+    for (int p = 0; p < num_profiles; p++) {
+        mrc_print_curve(profiles[p]);
+        stackdist_destroy(profiles[p]);
+    }
+    free(profiles);
+    free(chunk);
+    addr_trace_close_reader(reader);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%d profiles x %llu references in %.2fs (%.1fM references/s)\n",
+            num_profiles, (unsigned long long)count, secs,
+            secs > 0 ? num_profiles * (double)count / secs / 1e6 : 0.0);
+    return 0;
+}
@@ -0,0 +1,298 @@
+/* sweep: evaluate many cache configurations against one recorded address
+ * trace, in parallel.
+ *
+ * usage: sweep [-j threads] [-c base_config] [--section.key=value ...]
+ *              <trace_file> <config_list>
+ *
+ * The trace is an address trace captured with SIM_ADDR_TRACE (addrtrace.h).
+ * Each non-blank line of config_list (text after '#' is ignored) is one
+ * design point: whitespace-separated section.key=value overrides, applied on
+ * top of the base configuration given by the options (see config.h), or a
+ * lone '-' for the base configuration itself. A thread pool takes design
+ * points in turn; each worker builds and owns the caches of its design point
+ * and replays the whole trace. The trace file is mapped once and shared,
+ * read-only, by all workers, each of which decodes it a chunk at a time into
+ * a buffer of its own, so memory use does not grow with the trace. The
+ * results table has one row per design point, in list order.
+ *
+ * Caches are modelled tag-only and without timing: the hit, miss and
+ * writeback counts are those of blocking caches, so MSHRs, write buffers and
+ * latencies do not affect them, and prefetchers (which depend on timing) are
+ * not supported. */
+
+#include "cache.h"
+#include "prefetch.h"
+#include "config.h"
+#include "addrtrace.h"
+#include "missclass.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#define SWEEP_MAX_LINE 1024
+
+/* the cache code runs without a pipeline: no clock and no backing memory */
+uint64_t stat_cycles = 0;
+uint32_t mem_read_32(uint32_t address) { (void)address; return 0; }
+void mem_write_32(uint32_t address, uint32_t value) { (void)address; (void)value; }
+
+typedef struct Level_Result {
+    uint64_t accesses, misses, writebacks;
+    int classified;         /* 3C split below is valid */
+    uint64_t compulsory, capacity, conflict;
+} Level_Result;
+
+typedef struct Sweep_Point {
+    Sim_Config config;
+    char *text;             /* the overrides, as listed */
+    Level_Result icache, dcache, l2, llc;
+} Sweep_Point;
+
+static Addr_Trace_Map *sweep_trace;
+static Sweep_Point *sweep_points;
+static int sweep_num_points;
+static atomic_int sweep_next;
+static pthread_mutex_t sweep_create_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Reads the design points: each line's overrides on top of the base
+ * configuration in sim_config. Exits if any of them is invalid.
+ */
+static void sweep_read_points(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open configuration list %s\n", path);
+        exit(1);
+    }
+
+    Sim_Config base = sim_config;
+    char line[SWEEP_MAX_LINE];
+    int line_no = 0, capacity = 0, errors = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strspn(line, " \t") == strlen(line))
+            continue;
+
+        char text[SWEEP_MAX_LINE];
+        snprintf(text, sizeof(text), "%s", line);
+        sim_config = base;
+        int bad = 0;
+        for (char *tok = strtok(line, " \t"); tok; tok = strtok(NULL, " \t")) {
+            if (strcmp(tok, "-") != 0)
+                bad |= config_apply(tok) != 0;
+        }
+        bad = bad || config_check(&sim_config) != 0;
+        if (!bad && sim_config.dcache.prefetcher != PREFETCH_NONE) {
+            fprintf(stderr, "Error: prefetchers depend on timing and are not supported\n");
+            bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "  in %s:%d\n", path, line_no);
+            errors++;
+            continue;
+        }
+
+        if (sweep_num_points == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            sweep_points = realloc(sweep_points, capacity * sizeof(Sweep_Point));
+            if (!sweep_points) {
+                fprintf(stderr, "Error: Failed to allocate design points\n");
+                exit(1);
+            }
+        }
+        Sweep_Point *p = &sweep_points[sweep_num_points++];
+        memset(p, 0, sizeof(*p));
+        p->config = sim_config;
+        p->text = strdup(text + strspn(text, " \t"));
+    }
+    fclose(f);
+    sim_config = base;
+    if (errors)
+        exit(1);
+}
+
+static void sweep_collect(Level_Result *r, const Cache *cache)
+{
+    if (!cache)
+        return;
+    r->accesses = cache->stats.accesses;
+    r->misses = cache->stats.misses;
+    r->writebacks = cache->stats.writebacks;
+    if (cache->miss_class) {
+        r->classified = 1;
+        r->compulsory = cache->miss_class->compulsory;
+        r->capacity = cache->miss_class->capacity_misses;
+        r->conflict = cache->miss_class->conflict;
+    }
+}
+
+/**
+ * @brief Replays the whole trace through one design point, decoding it into
+ * the worker's 'chunk' buffer with 'scratch' for decompression, then flushes
+ * the hierarchy so that the writebacks include the dirty data left at the end.
+ */
+static void sweep_run_point(Sweep_Point *p, int index, Addr_Record *chunk, uint8_t *scratch)
+{
+    Cache_Hierarchy h;
+
+    /* cache creation touches shared counters and the global generator */
+    pthread_mutex_lock(&sweep_create_lock);
+    config_create_caches(&p->config, &h);
+    pthread_mutex_unlock(&sweep_create_lock);
+
+    /* random replacement must not depend on which thread ran first */
+    Cache *levels[] = { h.icache, h.dcache, h.l2, h.llc };
+    for (int i = 0; i < 4; i++) {
+        if (levels[i])
+            levels[i]->rand_state = ((uint32_t)(index + 1) * 0x9E3779B1u + (uint32_t)i * 0x85EBCA77u) | 1;
+    }
+
+    uint32_t data;
+    for (uint32_t c = 0; c < sweep_trace->num_chunks; c++) {
+        int n = addr_trace_map_read(sweep_trace, c, scratch, chunk);
+        for (int i = 0; i < n; i++) {
+            const Addr_Record *r = &chunk[i];
+            switch (r->type) {
+                case ADDR_IFETCH:
+                    h.icache->access_pc = r->pc;
+                    cache_access(h.icache, r->addr, &data, 0, 0);
+                    break;
+                case ADDR_LOAD:
+                    h.dcache->access_pc = r->pc;
+                    cache_access(h.dcache, r->addr & ~3, &data, 0, 0);
+                    break;
+                case ADDR_STORE:
+                    h.dcache->access_pc = r->pc;
+                    cache_access(h.dcache, r->addr & ~3, &data, 1, 0);
+                    break;
+            }
+        }
+    }
+    cache_flush(h.icache);
+    cache_flush(h.dcache);
+    cache_flush(h.l2);
+    cache_flush(h.llc);
+
+    sweep_collect(&p->icache, h.icache);
+    sweep_collect(&p->dcache, h.dcache);
+    sweep_collect(&p->l2, h.l2);
+    sweep_collect(&p->llc, h.llc);
+    config_destroy_caches(&h);
+}
+
+static void *sweep_worker(void *arg)
+{
+    (void)arg;
+    Addr_Record *chunk = malloc(ADDR_CHUNK_RECORDS * sizeof(Addr_Record));
+    uint8_t *scratch = malloc(ADDR_CHUNK_SCRATCH);
+    if (!chunk || !scratch) {
+        fprintf(stderr, "Error: Failed to allocate trace buffers\n");
+        exit(1);
+    }
+    for (;;) {
+        int i = atomic_fetch_add(&sweep_next, 1);
+        if (i >= sweep_num_points)
+            break;
+        sweep_run_point(&sweep_points[i], i, chunk, scratch);
+    }
+    free(chunk);
+    free(scratch);
+    return NULL;
+}
+
+static double sweep_rate(const Level_Result *r)
+{
+    return r->accesses ? (double)r->misses / r->accesses * 100.0 : 0.0;
+}
+
+/**
+ * @brief Prints the results table: miss rates per level, then the traffic
+ * that reaches memory and, where the last level classifies its misses
+ * ("classify"), their 3C split, then the design point.
+ */
+static void sweep_print_results()
+{
+    printf("%5s %8s %8s %8s %8s %12s %12s %12s %12s %12s  %s\n",
+            "point", "l1i_mr%", "l1d_mr%", "l2_mr%", "llc_mr%", "mem_reads", "mem_writes",
+            "compulsory", "capacity", "conflict", "config");
+    for (int i = 0; i < sweep_num_points; i++) {
+        Sweep_Point *p = &sweep_points[i];
+        const Level_Result *last = p->config.llc.size > 0 ? &p->llc : &p->l2;
+        printf("%5d %8.3f %8.3f %8.3f ", i, sweep_rate(&p->icache), sweep_rate(&p->dcache), sweep_rate(&p->l2));
+        if (p->config.llc.size > 0)
+            printf("%8.3f ", sweep_rate(&p->llc));
+        else
+            printf("%8s ", "-");
+        printf("%12llu %12llu ", (unsigned long long)last->misses, (unsigned long long)last->writebacks);
+        if (last->classified)
+            printf("%12llu %12llu %12llu ", (unsigned long long)last->compulsory,
+                    (unsigned long long)last->capacity, (unsigned long long)last->conflict);
+        else
+            printf("%12s %12s %12s ", "-", "-", "-");
+        printf(" %s\n", strcmp(p->text, "-") ? p->text : "(base)");
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-j threads] [-c base_config] [--section.key=value ...] "
+            "<trace_file> <config_list>\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+
+    /* -j first, then the base configuration options */
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2])
+            threads = atoi(argv[i] + 2);
+        else
+            break;
+    }
+    argv[i - 1] = argv[0];
+    i += config_parse_args(argc - (i - 1), argv + (i - 1)) - 1;
+    if (argc - i != 2 || threads <= 0)
+        usage(argv[0]);
+
+    cache_tag_only = 1;
+    sweep_trace = addr_trace_map(argv[i]);
+    sweep_read_points(argv[i + 1]);
+    if (threads > sweep_num_points)
+        threads = sweep_num_points > 0 ? sweep_num_points : 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t *pool = malloc(threads * sizeof(pthread_t));
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&pool[t], NULL, sweep_worker, NULL) != 0) {
+            fprintf(stderr, "Error: Can't start worker thread\n");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < threads; t++)
+        pthread_join(pool[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(pool);
+
+    sweep_print_results();
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%d design points x %llu references in %.2fs on %d threads (%.1fM references/s)\n",
+            sweep_num_points, (unsigned long long)sweep_trace->count, secs, threads,
+            secs > 0 ? sweep_num_points * (double)sweep_trace->count / secs / 1e6 : 0.0);
+    addr_trace_unmap(sweep_trace);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/* tracedump: render a binary trace written by a SIM_TRACE build as text.
+ *
+ * usage: tracedump [-l max_level] [-c cat[,cat...]] <trace_file>
+ */
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_DEF_NAME(name, cat, lvl, fmt) #name,
+#define TRACE_DEF_FMT(name, cat, lvl, fmt) fmt,
+static const char *event_names[] = { TRACE_EVENTS(TRACE_DEF_NAME) };
+static const char *event_formats[] = { TRACE_EVENTS(TRACE_DEF_FMT) };
+
+static const char *level_names[] = { "-", "ERROR", "WARN", "INFO", "DEBUG", "VERBOSE" };
+static const char *cat_names[] = { "pipe", "cache", "mem", "branch" };
+#define NUM_CATS (int)(sizeof(cat_names) / sizeof(cat_names[0]))
+
+static const char *cat_name(unsigned cat)
+{
+    for (int i = 0; i < NUM_CATS; i++)
+        if (cat & (1u << i))
+            return cat_names[i];
+    return "?";
+}
+
+static unsigned parse_cats(char *s)
+{
+    unsigned mask = 0;
+    for (char *tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        if (strcmp(tok, "all") == 0)
+            mask |= TRACE_CAT_ALL;
+        for (int i = 0; i < NUM_CATS; i++)
+            if (strcmp(tok, cat_names[i]) == 0)
+                mask |= 1u << i;
+    }
+    return mask;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_level = TRACE_VERBOSE;
+    unsigned cats = TRACE_CAT_ALL;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            max_level = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            cats = parse_cats(argv[++i]);
+        else
+            path = argv[i];
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [-l max_level] [-c cat[,cat...]] <trace_file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Can't open trace file %s\n", path);
+        return 1;
+    }
+
+    Trace_Header header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != TRACE_MAGIC) {
+        fprintf(stderr, "Error: %s is not a trace file\n", path);
+        return 1;
+    }
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(Trace_Record)) {
+        fprintf(stderr, "Error: unsupported trace version %u (record size %u)\n",
+                header.version, header.record_size);
+        return 1;
+    }
+
+    Trace_Record rec;
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        if (rec.level > max_level || !(rec.category & cats))
+            continue;
+        if (rec.event >= TR_NUM_EVENTS) {
+            printf("%12llu  ?       ?        unknown event %u\n", (unsigned long long)rec.cycle, rec.event);
+            continue;
+        }
+        printf("%12llu  %-7s %-7s %-15s ", (unsigned long long)rec.cycle,
+                rec.level <= TRACE_VERBOSE ? level_names[rec.level] : "?",
+                cat_name(rec.category), event_names[rec.event]);
+        printf(event_formats[rec.event], rec.arg[0], rec.arg[1], rec.arg[2], rec.arg[3]);
+        printf("\n");
+    }
+
+    fclose(f);
+    return 0;
+}